@@ -16,12 +16,41 @@
 b2Vec2 _tb(const   vec2& v);
 vec2   _fb(const b2Vec2& v);
 
+//	A contact which began during a step. These are buffered while box2d steps and
+//	sent to the collision functions after, so user code doesn't run inside the solver
+//
+struct PhysicsContact
+{
+	Entity A;
+	Entity B;
+	b2Contact* contact; // only valid until either body is removed or loses a collider
+	b2Body* bodyA;
+	b2Body* bodyB;
+
+	vec2 normal;        // world space, from A to B
+	vec2 points[b2_maxManifoldPoints];
+	int pointCount;
+
+	float impulse;      // the largest normal impulse the solver applied in the step, 0 for sensors
+
+	bool enabledA;      // if the bodies respond to collision
+	bool enabledB;
+};
+
+struct PhysicsContactBuffer
+{
+	std::vector<PhysicsContact> contacts;
+	std::unordered_map<b2Contact*, int> index; // for adding the impulse after the solver
+};
+
 struct CollisionInfo
 {
 	Entity me;
 	Entity other;
 	b2Contact* contact;
 	bool isA;
+
+	const PhysicsContact* manifold = nullptr; // only valid in the function
 };
 
 struct WorldCollisionInfo
@@ -29,6 +58,8 @@ struct WorldCollisionInfo
 	Entity A;
 	Entity B;
 	b2Contact* contact;
+
+	const PhysicsContact* manifold = nullptr; // only valid in the function
 };
 
 using OnWorldCollisionFunc = std::function<void(WorldCollisionInfo)>;
@@ -37,6 +68,7 @@ using OnCollisionFunc = std::function<void(CollisionInfo)>;
 // fwd
 struct Rigidbody2D;
 struct PhysicsWorld;
+struct thread_pool;
 
 ///// colliders
 
@@ -235,6 +267,56 @@ private:
 //	void InitPoints(const ArrayView<vec2>& points);
 //};
 
+//	The poses of the bodies in a world, stored as arrays indexed by each body's proxy
+//	
+//	PhysicsWorld copies them out of box2d after each step, so reading them doesn't touch the b2Body.
+//	Writes go here too and are applied to the bodies in one go before the next step
+//
+//	The pose before the last step is kept as well, so rendering between steps can interpolate.
+//	alpha is how far the frame is between the last step and the next, 0 is the last pose
+//
+struct PhysicsPoses
+{
+	enum Dirty : u8
+	{
+		dTransform       = 1,
+		dVelocity        = 2,
+		dAngularVelocity = 4
+	};
+
+	std::vector<vec2>    position;
+	std::vector<vec2>    velocity;
+	std::vector<float>   angle;
+	std::vector<float>   angularVelocity;
+	std::vector<b2Body*> body;    // null if the slot is free
+	std::vector<int>     entity;  // id of the entity owning the body, -1 if it isn't known
+	std::vector<u8>      awake;   // awake at the last sync, bodies which fell asleep during a step still need to be copied
+
+	std::vector<vec2>    lastPosition;
+	std::vector<float>   lastAngle;
+	float alpha = 1.f;
+
+	std::vector<int>     lodInterval; // steps between solves, the last value given to box2d
+
+	std::vector<u8>      dirty;
+	std::vector<int>     dirtyList;
+	std::vector<int>     free;
+
+	// while contacts are sent out, the bodies which are destroyed or lose a collider, so their
+	// other contacts, which point into freed box2d memory, are skipped
+	std::vector<b2Body*> removed;
+	bool dispatching = false;
+
+	int  Alloc(b2Body* body, int entity);
+	void Free(int proxy);
+	void Mark(int proxy, Dirty flag);
+	void MarkRemoved(b2Body* body);
+	bool WasRemoved(b2Body* body) const;
+
+	// number of slots, including free ones
+	int  Count() const;
+};
+
 struct LastPositionState2D
 {
 	vec2 position = vec2(0.f);
@@ -259,6 +341,10 @@ private:
 	b2Body* m_instance;
 	b2World* m_world;
 
+	// where reads of the pose come from, a shared zeroed slot when not in a world
+	r<PhysicsPoses> m_poses;
+	int m_proxy;
+
 	// this is for serialization loading
 	b2BodyDef m_preinit;
     
@@ -332,6 +418,17 @@ public:
 	Rigidbody2D& SetEntity         (int id);
 	Rigidbody2D& SetIsBullet       (bool isBullet);
 
+	// index into the PhysicsPoses of the world this body is in
+	int GetProxy() const;
+
+	// the pose between the last two steps, at the world's interpolation alpha
+	// for rendering at a higher rate than physics steps
+	vec2  GetInterpolatedPosition() const;
+	float GetInterpolatedAngle()    const;
+
+	// write the interpolated pose into a transform, leaving its scale and z
+	void InterpolateTransform(Transform2D& transform) const;
+
 	// colliders
 
 	r<Collider> AddCollider(const Collider& collider);
@@ -357,6 +454,9 @@ public:
 private:
 	b2Fixture* GetCol(int index) const;
 	b2Fixture* GetColList() const;
+
+	void AttachPoses(const r<PhysicsPoses>& poses, int entity);
+	void DetachPoses();
 };
 
 struct PointQueryResult
@@ -400,11 +500,142 @@ struct RayQueryResult
 	vec2          FirstNormal()   const;
 };
 
+//	Level of detail
+//
+//	Bodies further than distance from every focus point are solved every interval steps, with a step
+//	that many times longer. A group of touching bodies is solved as often as its closest body
+//
+struct PhysicsLodLevel
+{
+	float distance;
+	int interval;
+};
+
+struct PhysicsStats
+{
+	int bodies;
+	int awakeBodies;
+	int contacts;
+	int islands;        // groups of touching bodies solved in the last step
+	int skippedIslands; // not solved in the last step because of lod
+
+	// milliseconds in the last Tick
+	float flush;
+	float lod;
+	float collide;
+	float solve;
+	float solveTOI;
+	float broadphase;   // part of solve
+	float sync;
+	float dispatch;
+	float total;
+};
+
+//	The state of a world's bodies and contacts at one step, for rollback and replays
+//
+//	Restoring then stepping gives the same results as when it was taken, bit for bit. The world needs
+//	the same bodies, added in the same order and with the same colliders
+//
+struct PhysicsSnapshot
+{
+	std::vector<u8> bytes;
+};
+
+//	Batched queries
+//
+//	These write one hit per query into a buffer from the caller, so nothing is allocated or sorted.
+//	Entities aren't wrapped, entity is the id the body was added with, see PhysicsPoses::entity
+
+enum PhysicsQueryMode
+{
+	QUERY_CLOSEST, // the closest hit to the start of the ray or the point
+	QUERY_ANY      // the first hit box2d finds, for when only knowing if something is there matters
+};
+
+struct PhysicsRay
+{
+	vec2 point;
+	vec2 target;
+};
+
+struct PhysicsRayHit
+{
+	bool hit;
+	int entity;
+	b2Fixture* fixture;
+	float distance;
+	vec2 point;
+	vec2 normal;
+};
+
+struct PhysicsPointQuery
+{
+	vec2 point;
+	float radius;
+};
+
+struct PhysicsPointHit
+{
+	bool hit;
+	int entity;
+	b2Fixture* fixture;
+	float distance; // to the body's position
+};
+
+struct PhysicsClosestQuery
+{
+	vec2 point;
+	float maxDistance;
+	int ignoreEntity; // -1 to check every body, or the entity asking so it doesn't find itself
+};
+
+struct PhysicsClosestHit
+{
+	bool hit;
+	int entity;
+	b2Fixture* fixture;
+	float distance; // to the surface of the fixture, 0 if the point is inside
+	vec2 point;     // on the surface of the fixture
+};
+
 struct PhysicsWorld
 {
 private:
+	// the functions for one pair of component types
+	struct CollisionPair
+	{
+		int a; // index of each type in m_collisionTypes
+		int b;
+		func<void(WorldCollisionInfo)> functions;
+	};
+
+	// a component type which is in any pair, has checks an entity for it
+	struct CollisionType
+	{
+		meta::id_type id;
+		bool(*has)(const Entity&);
+		std::vector<CollisionPair*> pairs; // into m_onCollision, its nodes don't move
+	};
+
 	b2World* m_world;
-	func<void(WorldCollisionInfo)> m_onCollision;
+	std::unordered_map<u64, CollisionPair> m_onCollision;
+	std::vector<CollisionType> m_collisionTypes;
+	std::vector<u8> m_collisionHas;                // which types the entities of a contact have, kept between contacts
+	std::vector<CollisionPair*> m_collisionFired; // the pairs a contact matched, kept between contacts
+	r<PhysicsContactBuffer> m_contacts;
+
+	r<PhysicsPoses> m_poses;
+	thread_pool* m_threads;
+	bool m_solveIslands;
+
+	int m_velocityIterations;
+	int m_positionIterations;
+
+	std::vector<PhysicsLodLevel> m_lodLevels;
+	std::vector<vec2> m_lodFocus;
+	bool m_lodApplied; // if any body might have an interval other than 1
+
+	PhysicsStats m_stats;
 
 public:
 	PhysicsWorld();
@@ -418,12 +649,72 @@ public:
 	Rigidbody2D CreateBody();
 	void RegisterBody(Rigidbody2D* body);
 
+	// applies writes, steps, then copies the poses of awake bodies
 	void Tick(float dt);
 
+	// apply writes made through Rigidbody2D to box2d now instead of before the next step
+	void Flush();
+
+	// the poses of all bodies, for systems which want to loop over them directly
+	const PhysicsPoses& GetPoses() const;
+
+	// solver iterations for each step, more is more accurate and slower. the default is 6 and 2
+	void SetIterations(int velocityIterations, int positionIterations);
+
+	// levels sorted by distance, an empty list turns lod off
+	void SetLodLevels(const std::vector<PhysicsLodLevel>& levels);
+
+	// the points bodies are kept detailed near, like the camera and the listener. set each frame
+	// without any points every body is solved each step
+	void SetLodFocus(const std::vector<vec2>& points);
+
+	// counts and times from the last Tick
+	const PhysicsStats& GetStats() const;
+
+	// write the state of the world into snapshot, reusing its memory. applies writes first
+	void Snapshot(PhysicsSnapshot& snapshot);
+
+	// returns false and changes nothing if the bodies are different from when the snapshot was taken
+	// writes which haven't been flushed are dropped, and no collision functions are called
+	bool Restore(const PhysicsSnapshot& snapshot);
+
+	// how far between the last step and the next the current frame is, set by SceneNode after stepping
+	void  SetInterpolationAlpha(float alpha);
+	float GetInterpolationAlpha() const;
+
+	// split copying the poses after each step and batched queries across a pool,
+	// null to do them on the calling thread. this waits on all work in the pool
+	// solveIslands also solves unconnected groups of bodies at the same time in the step,
+	// each group is solved on its own so the result is the same for any number of threads
+	void SetThreadPool(thread_pool* pool, bool solveIslands = false);
+
+private:
+	void SyncPoses();
+	void DispatchContacts();
+	void UpdateLod();
+	void UpdateStats();
+
+	// the same key for either order
+	static u64 PairKey(meta::id_type a, meta::id_type b);
+
+	// the index of a type in m_collisionTypes, added if it isn't there
+	int CollisionTypeIndex(meta::id_type id, bool(*has)(const Entity&));
+
+public:
 	  RayQueryResult QueryRay  (vec2 point, vec2 direction, float distance) const;
 	  RayQueryResult QueryRay  (vec2 point, vec2 target) const;
 	PointQueryResult QueryPoint(vec2 point, float radius) const;
 
+	// hits must be the same size as the queries. the tree isn't changed by queries, so they run
+	// in parallel if there is a thread pool. writes to bodies aren't seen until they are flushed
+	void QueryRays  (const ArrayView<PhysicsRay>&        rays,    ArrayView<PhysicsRayHit>   hits, PhysicsQueryMode mode = QUERY_CLOSEST) const;
+	void QueryPoints(const ArrayView<PhysicsPointQuery>& queries, ArrayView<PhysicsPointHit> hits, PhysicsQueryMode mode = QUERY_CLOSEST) const;
+
+	// the fixture with the closest surface to a point, sensors are skipped. the tree is searched nearest
+	// first, and branches further than the closest fixture found so far aren't looked at
+	PhysicsClosestHit QueryClosest(vec2 point, float maxDistance = FLT_MAX, int ignoreEntity = -1) const;
+	void QueryClosest(const ArrayView<PhysicsClosestQuery>& queries, ArrayView<PhysicsClosestHit> hits) const;
+
 	// yes moves
 	PhysicsWorld(PhysicsWorld&& move) noexcept;
 	PhysicsWorld& operator=(PhysicsWorld&& move) noexcept;
@@ -432,40 +723,34 @@ public:
 	PhysicsWorld(const PhysicsWorld& move) = delete;
 	PhysicsWorld& operator=(const PhysicsWorld& move) = delete;
 
+	// call func after a step for contacts between an entity with _c1 and one with _c2
+	// functions are grouped by their pair of types, and each type knows its pairs, so a contact
+	// checks each type once per entity and only tests the pairs of the types it has
+	// only called if both bodies respond to collision
 	template<typename _c1, typename _c2>
 	OnWorldCollisionFunc OnCollision(const OnWorldCollisionFunc& func)
 	{
-		OnWorldCollisionFunc f = [func](WorldCollisionInfo info)
+		auto [itr, added] = m_onCollision.try_emplace(PairKey(meta::id<_c1>(), meta::id<_c2>()));
+		CollisionPair& pair = itr->second;
+
+		if (added)
 		{
-			// this is wasteful because this causes a loop in m_onCollision for each pair
-			// better solve would be a pair hash that doesn't care about order, then a map of pair hash -> func
-			// but this is ez
-
-			if (   !info.A.Get<Rigidbody2D>().IsCollisionEnabled()
-				|| !info.B.Get<Rigidbody2D>().IsCollisionEnabled()) // exit if collision isn't enabled, need to make a sensor bool so those can work still
-			{
-				return;
-			}
-
-			if (   (info.A.Has<_c1>() && info.B.Has<_c2>())
-				|| (info.A.Has<_c2>() && info.B.Has<_c1>()))
-			{
-				func(info);
-			}
-		};
-
-		m_onCollision += f;
-
-		return f;
-	}
+			pair.a = CollisionTypeIndex(meta::id<_c1>(), [](const Entity& e) { return e.Has<_c1>(); });
+			pair.b = CollisionTypeIndex(meta::id<_c2>(), [](const Entity& e) { return e.Has<_c2>(); });
 
-	void RemoveOnCollision(const OnWorldCollisionFunc& func)
-	{
-		m_onCollision -= func;
-	}
+			m_collisionTypes[pair.a].pairs.push_back(&pair);
 
-	void FireOnCollision(const WorldCollisionInfo& info)
-	{
-		m_onCollision(info);
+			if (pair.b != pair.a)
+				m_collisionTypes[pair.b].pairs.push_back(&pair);
+		}
+
+		pair.functions += func;
+
+		return func;
 	}
+
+	void RemoveOnCollision(const OnWorldCollisionFunc& func);
+
+	// call the functions whose pair of types matches the entities
+	void FireOnCollision(const WorldCollisionInfo& info);
 };
@@ -14,6 +14,8 @@ typedef unsigned int GLenum;
 typedef unsigned int GLuint;
 typedef int GLint;
 
+class CookedTexture;
+
 // I want to create the simplest graphics API that hides as much as possible away
 // I only need simple Texture/Mesh/Shader, I don't even need materials
 // user should be able to understand where the memory is without needing to know the specifics of each type
@@ -50,6 +52,25 @@ typedef int GLint;
 
 #define TEXTURE_DEFAULT_FILTER Texture::fPixelated
 
+// Parts of an object changed on the host since it was last sent to the device
+// max is exclusive, buffers only use x for their byte range
+struct DirtyRegion
+{
+	int minX, minY, maxX, maxY;
+};
+
+// edits that overlap or touch are merged, past DIRTY_MAX_REGIONS they collapse into their bounds
+#define DIRTY_MAX_REGIONS 8
+
+struct DirtyRegions
+{
+	std::vector<DirtyRegion> regions;
+
+	void Add(int begin, int end);
+	void Add(int minX, int minY, int maxX, int maxY);
+	void Clear();
+};
+
 enum DeviceObjectType
 {
 	OBJECT_TEXTURE,
@@ -72,6 +93,7 @@ struct IDeviceObject
 	bool IsStatic() const;
 	bool Outdated() const;
 
+	// the whole object is sent on the next SendToDevice
 	void MarkForUpdate();
 
 	DeviceObjectType Type() const;
@@ -98,6 +120,13 @@ public:
 	void assert_is_static()  const;
 	void assert_not_static() const;
 
+protected:
+	// only the regions the object tracks itself are sent, unless MarkForUpdate was called
+	void MarkForPartialUpdate();
+
+	// true if _UpdateOnDevice can send just the dirty regions
+	bool PartialUpdate() const;
+
 // move & copy
 
 protected:
@@ -106,6 +135,7 @@ protected:
 private:
 	bool m_static;
 	bool m_outdated;
+	bool m_partial;
 	DeviceObjectType m_type;
 };
 
@@ -158,6 +188,11 @@ private:
 
 	Filter       m_filter          = TEXTURE_DEFAULT_FILTER;  // things you can change after creation
 
+	DirtyRegions m_dirty;                     // pixel rects written through At/Set
+
+	r<CookedTexture> m_cooked;                // if set, m_host points into this mapping instead of being malloc'd
+	int          m_deviceMips      = 1;       // levels on the device, cooked textures bring their own mips
+
 // public texture specific functions
 
 public:
@@ -184,7 +219,8 @@ public:
 	// only rgb -> Channels() = 3
 	// full rgba -> Channels() = 4
 
-	// assumed non const At will be written to so marks the texture as outdated
+	// assumed non const At will be written to so marks the pixel as outdated
+	// only the outdated rects are sent on the next SendToDevice
 
 	// !! need to add assert for invalid index !!!
 	
@@ -209,6 +245,9 @@ public:
 	void ClearHost(Color color = Color(0, 0, 0, 0));
 	void Resize(int width, int height);
 
+	// mark a rect of pixels as changed, for writes through Pixels()
+	void MarkRegionForUpdate(int x, int y, int width, int height);
+
 	// copy a sub region of a texture
 	// supports copying to a different usage
 	Texture CopySubRegion(int minX, int minY, int maxX, int maxY, Usage usage, int isStatic = INHERIT_HOST) const;
@@ -233,6 +272,7 @@ private:
 
 public:
 	// by default is static
+	// a path to an image loads its cooked file instead if there is an up to date one, see io/CookedTexture.h
 	Texture();
 	Texture(const std::string& path, bool isStatic = true);
 	Texture(int width, int height, Usage usage, bool isStatic = true);
@@ -254,6 +294,7 @@ private:
 
 private:
 	void init_texture_host_memory(void* pixels, int w, int h, Usage usage);
+	void init_texture_cooked(const r<CookedTexture>& cooked);
 
 public:
 	bool IsIndexValid(int index32) const;
@@ -370,6 +411,7 @@ private:
 
 	_data        m_host;
 	GLuint       m_device   = 0u;
+	int          m_capacity = 0;  // bytes allocated on the device, dynamic buffers grow past Bytes()
 
 	int          m_length   = 0; // need length after host is freed
 	int          m_repeat   = 0;
@@ -377,6 +419,8 @@ private:
 
 	bool         m_onHost   = true; // this is needed for 0 sized device buffers
 
+	DirtyRegions m_dirty;           // byte ranges changed by Push/Erase
+
 // public buffer specific functions
 
 public:
@@ -418,6 +462,9 @@ public:
 	
 	template<typename _t> void Push(const _t& element) { Push(1, &element); }
 
+	// mark a range of bytes as changed, for writes through Data() or Get
+	void MarkRangeForUpdate(int byteIndex, int byteCount);
+
 // interface
 
 public:
@@ -712,6 +759,15 @@ struct IHasMaterialProperties
 	virtual void SetArray(const std::string& name, const f32* x, int count) = 0;
 };
 
+// A uniform looked up ahead of time with ShaderProgram::Uniform
+// only valid for the program it came from, relinking the program invalidates it
+//
+struct UniformHandle
+{
+	GLint location = -1; // -1 if the program doesn't have this uniform, setting it does nothing
+	int   slot     = -1; // texture slot if this is a sampler
+};
+
 struct ShaderProgram : IDeviceObject, IHasMaterialProperties
 {
 public:
@@ -730,7 +786,11 @@ private:
 
 	int          m_slot     = 0;       // number of active texture slots
 
-	std::unordered_map<std::string, int> m_handleToSlot;
+	// reflected after linking so setting by name doesn't query the driver
+	std::unordered_map<std::string, UniformHandle> m_uniforms;
+
+	bool         m_linking  = false;   // link was started on the driver's threads and hasn't been checked yet
+	u64          m_hash     = 0;       // key in the binary cache, 0 if it was loaded from it
 
 public:
 	int NumberOfShaders()       const;
@@ -743,6 +803,10 @@ public:
 
 	ShaderProgram& Use();
 
+	// true once the program is linked and can be used without waiting on the driver
+	// with parallel compiling this polls, so call each frame until programs are ready
+	bool IsReady();
+
 	void Set(const std::string& name, const   int& x) override;
 	void Set(const std::string& name, const   u32& x) override;
 	void Set(const std::string& name, const   f32& x) override;
@@ -769,6 +833,40 @@ public:
 	void SetArray(const std::string& name, const u32* x, int count) override;
 	void SetArray(const std::string& name, const f32* x, int count) override;
 
+	// resolve a uniform once and set it through the handle each frame
+	// sends the program to the device if it isn't already
+	UniformHandle Uniform(const std::string& name);
+
+	// the same lookup without touching the device, so it can be called from any thread
+	// once the program is linked, before that the handle is empty
+	UniformHandle FindUniform(const std::string& name) const;
+
+	void Set(UniformHandle uniform, const   int& x);
+	void Set(UniformHandle uniform, const   u32& x);
+	void Set(UniformHandle uniform, const   f32& x);
+	void Set(UniformHandle uniform, const fvec2& x);
+	void Set(UniformHandle uniform, const fvec3& x);
+	void Set(UniformHandle uniform, const fvec4& x);
+	void Set(UniformHandle uniform, const ivec2& x);
+	void Set(UniformHandle uniform, const ivec3& x);
+	void Set(UniformHandle uniform, const ivec4& x);
+	void Set(UniformHandle uniform, const fmat2& x);
+	void Set(UniformHandle uniform, const fmat3& x);
+	void Set(UniformHandle uniform, const fmat4& x);
+	void Set(UniformHandle uniform, const Color& color);
+	void Set(UniformHandle uniform, r<Texture> texture);
+	void Set(UniformHandle uniform, Texture& texture);
+
+	void SetTexture(UniformHandle uniform, int handle);
+
+	void SetArray(UniformHandle uniform, const int* x, int count);
+	void SetArray(UniformHandle uniform, const u32* x, int count);
+	void SetArray(UniformHandle uniform, const f32* x, int count);
+
+	// bind a uniform block in this program to a binding point
+	// blocks named Camera are bound to the camera block when linked, see Render::SetCameraBlock
+	void SetBlock(const std::string& name, int binding);
+
 // interface
 
 public:
@@ -803,6 +901,9 @@ private:
 
 private:
 	GLint gl_location(const std::string& name) const;
+	void  gl_reflect();
+	void  gl_finish_link();
+	void  gl_wait();
 };
 
 //
@@ -822,6 +923,7 @@ GLenum gl_format              (Buffer::ElementType type);
 GLenum gl_drawtype            (Mesh::Topology drawType);
 GLenum gl_shader_type         (ShaderProgram::ShaderName type);
 GLint  gl_program_texture_slot(int slot);
+bool   gl_is_sampler          (GLenum uniformType);
 
 // set the glClearColor to the color
 void gl_SetClearColor(const Color& color);
@@ -838,6 +940,9 @@ namespace Render
 		int window_width = 0;
 		int window_height = 0;
 		Color clear_color = Color(20, 38, 66);
+		GLuint camera_block = 0; // uniform buffer for SetCameraBlock
+
+		std::string shader_cache_directory; // empty if programs aren't cached
 
 		float WindowAspect() const;
 		float TargetAspect() const;
@@ -863,6 +968,25 @@ namespace Render
 
 	void SetAlphaBlend(bool blend);
 
+	// Per frame camera data shared by every program through a uniform block
+	// upload once per frame instead of setting proj/view on each program. Declare in glsl as
+	//
+	//	layout(std140) uniform Camera { mat4 proj; mat4 view; mat4 viewProj; };
+	//
+
+	// the binding point programs attach their Camera block to
+	constexpr int CameraBlockBinding = 0;
+
+	void SetCameraBlock(const mat4& proj, const mat4& view);
+
+	// Cache linked programs in this directory, keyed by their source and the driver
+	// an empty string turns the cache off
+	void SetShaderCacheDirectory(const std::string& directory);
+
+	// Start compiling all programs at once. Where the driver can compile in parallel this
+	// doesn't wait for them, poll ShaderProgram::IsReady. Otherwise each is compiled in turn
+	void CompileShaders(const std::vector<r<ShaderProgram>>& programs);
+
 	ivec2 GetWindowSizeInPixels();
 	float GetWindowAspect();
 	float GetTargetAspect();
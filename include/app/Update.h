@@ -84,9 +84,21 @@ protected:
 
 // physics
 
-	RayQueryResult   QueryRay  (vec2 pos, vec2 end);
-	RayQueryResult   QueryRay  (vec2 pos, vec2 direction, float distance);
-	PointQueryResult QueryPoint(vec2 pos, float radius);
+	RayQueryResult    QueryRay    (vec2 pos, vec2 end);
+	RayQueryResult    QueryRay    (vec2 pos, vec2 direction, float distance);
+	PointQueryResult  QueryPoint  (vec2 pos, float radius);
+	PhysicsClosestHit QueryClosest(vec2 pos, float maxDistance = FLT_MAX, int ignoreEntity = -1);
+
+	void QueryRays   (const ArrayView<PhysicsRay>&          rays,    ArrayView<PhysicsRayHit>     hits, PhysicsQueryMode mode = QUERY_CLOSEST);
+	void QueryPoints (const ArrayView<PhysicsPointQuery>&   queries, ArrayView<PhysicsPointHit>   hits, PhysicsQueryMode mode = QUERY_CLOSEST);
+	void QueryClosest(const ArrayView<PhysicsClosestQuery>& queries, ArrayView<PhysicsClosestHit> hits);
+
+	// how far between fixed updates this frame is, for drawing bodies with Rigidbody2D::InterpolateTransform
+	float GetPhysicsAlpha();
+
+	// the points physics keeps detailed near, see PhysicsWorld::SetLodFocus
+	void SetPhysicsFocus(const std::vector<vec2>& points);
+	const PhysicsStats& GetPhysicsStats();
 
 // input
 
@@ -2,6 +2,7 @@
 
 #include "Rendering.h"
 #include "ext/rendering/Camera.h"
+#include "ext/rendering/UploadAllocator.h"
 #include "util/Transform.h"
 #include "util/Transform3D.h"
 #include <unordered_map>
@@ -13,11 +14,25 @@
 struct BatchLineRenderer
 {
 private:
+	struct Vertex
+	{
+		vec3 position;
+		vec4 color;
+		mat4 model; // need to copy for each point
+	};
+
 	ShaderProgram m_program;
-	Mesh m_mesh;
+
+	// vertices are written straight into the staging memory of the frame
+	UploadAllocator m_upload;
+	GLuint m_vao = 0;
 
 public:
 	BatchLineRenderer();
+	~BatchLineRenderer();
+
+	BatchLineRenderer(const BatchLineRenderer& copy) = delete;
+	BatchLineRenderer& operator=(const BatchLineRenderer& copy) = delete;
 
 	void Begin();
 
@@ -32,4 +47,5 @@ public:
 
 private:
 	void InitProgram();
+	void PushLine(const vec3& a, const vec3& b, const vec4& colorA, const vec4& colorB, const mat4& world);
 };
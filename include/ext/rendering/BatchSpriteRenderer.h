@@ -5,42 +5,154 @@
 #include "ext/rendering/Camera.h"
 #include "ext/rendering/Sprite.h"
 #include "ext/rendering/Particle.h"
+#include "ext/rendering/SpriteAtlas.h"
+#include "util/AABB.h"
 #include <unordered_map>
+#include <memory>
+#include <mutex>
 
 // could use major improvements !!!
-// 
-// 1.       don't realloc memory every frame
+//
+// 1. DONE: don't realloc memory every frame
 // 2.       clump draws by multiple textures (bind more than one at a time and add tex index to vertex info)
-// 3. ABLE: write directly to buffer memory (maybe make a buffer a vector?)
+// 3. DONE: write directly to buffer memory (maybe make a buffer a vector?)
 // 4.       create all batches and upload at once, while draws are happening
 
+// Sprites are drawn in the order of a 64 bit key
+//
+//	bits 56-63 layer,   lower layers are drawn first
+//	bits 54-55 blend,   normal before additive
+//	bits 32-53 texture, device handle of the texture, 0 is the default white texture
+//	bits  0-31 depth,   the z of the sprite's transform, lower z is drawn first
+//
+// each unique layer/blend/texture is a single instanced draw
+
+// packed per instance data, the vertex shader rebuilds the model matrix
+struct BatchSpriteInstance
+{
+	vec4 uv;         // offset xy, scale zw
+	vec3 position;   // z includes the per draw offset
+	float rotation;
+	vec2 scale;
+	u32 tint;        // rgba8
+};
+
+static_assert(sizeof(BatchSpriteInstance) == 44, "BatchSpriteInstance should be tightly packed");
+
+struct BatchSpriteCommand
+{
+	u64 key;
+	u32 instance;
+};
+
+// A list of sprites that can be filled on any thread
+// Doesn't call into the graphics api, textures that are not on the device yet
+// get sent by the renderer on Draw
+//
+struct BatchSpriteList
+{
+public:
+	// set the layer and blend mode of the following submissions
+	// Clear resets these to 0 and BLEND_NORMAL
+	void SetLayer(u8 layer);
+	void SetBlend(BlendMode blend);
+
+	// if set, sprites whose bounds are outside of the rect are dropped on submission
+	// use CullCameraRect for the rect a camera sees. Stays set across Draw like the
+	// layer and blend, ClearCullRect or Clear turns it off
+	void SetCullRect(const aabb2D& rect);
+	void ClearCullRect();
+
+	void SubmitColor(const Transform2D& transform, Color tint);
+	void SubmitSprite(const Transform2D& transform, Sprite& sprite);
+	void SubmitStaticSprite(const Transform2D& transform, SpriteStaticHandle& sprite);
+	void SubmitParticle(const Transform2D& transform, Particle& particle);
+	void SubmitTexture(const Transform2D& transform, r<Texture> texture, vec2 uvOffset = vec2(0.f), vec2 uvScale = vec2(1.f), Color tint = Color());
+	void SubmitHandle(const Transform2D& transform, int handle, vec2 uvOffset = vec2(0.f), vec2 uvScale = vec2(1.f), Color tint = Color());
+
+	int Count() const;
+	void Clear();
+
+private:
+	friend struct BatchSpriteRenderer;
+
+	std::vector<BatchSpriteInstance> m_instances;
+	std::vector<BatchSpriteCommand> m_commands;
+
+	// index of the command and the texture it needs on the device
+	std::vector<std::pair<u32, r<Texture>>> m_pending;
+
+	u8 m_layer = 0;
+	BlendMode m_blend = BLEND_NORMAL;
+
+	bool m_cull = false;
+	aabb2D m_cullRect;
+
+	bool IsCulled(const Transform2D& transform) const;
+};
+
 struct BatchSpriteRenderer
 {
 public:
 	BatchSpriteRenderer();
+	~BatchSpriteRenderer();
 	//BatchSpriteRenderer(const char* vertexShader, const char* fragmentShader);
 
+	BatchSpriteRenderer(const BatchSpriteRenderer& copy) = delete;
+	BatchSpriteRenderer& operator=(const BatchSpriteRenderer& copy) = delete;
+
 	void Begin();
+
+	// merge the lists, sort, and draw
+	// must be called on the render thread after all jobs filling lists have finished
 	void Draw(const Camera& camera, bool mixTint = false);
 
+	// after sorting, each sprite is offset by a small amount in z
+	// to stop z fighting between sprites with the same depth
 	void SetZOffsetPerDraw(float zOffsetPerDraw);
 
+	// if set, textures which can be put into the atlas are remapped to its pages
+	// so sprites using different small textures are drawn together. nullptr to disable
+	void SetAtlas(r<SpriteAtlas> atlas);
+
+	// Get a submission list that can be filled from a job thread
+	// each thread should use its own index, lists are merged in order of index on Draw
+	// so the draw order doesn't depend on which job finished first. Safe to call from any thread
+	BatchSpriteList& GetList(int index);
+
+	// these submit to a list owned by the render thread, which is merged before the others
+
+	void SetLayer(u8 layer);
+	void SetBlend(BlendMode blend);
+	void SetCullRect(const aabb2D& rect);
+	void ClearCullRect();
+
 	void SubmitColor(const Transform2D& transform, Color tint);
 	void SubmitSprite(const Transform2D& transform, Sprite& sprite);
     void SubmitStaticSprite(const Transform2D& transform, SpriteStaticHandle& sprite);
 	void SubmitParticle(const Transform2D& transform, Particle& particle);
 	void SubmitTexture(const Transform2D& transform, r<Texture> texture, vec2 uvOffset = vec2(0.f), vec2 uvScale = vec2(1.f), Color tint = Color());
     void SubmitHandle(const Transform2D& transform, int handle, vec2 uvOffset = vec2(0.f), vec2 uvScale = vec2(1.f), Color tint = Color());
-    
+
 private:
 	ShaderProgram m_program;
 
+	// resolved once in InitProgram
+	UniformHandle m_uniformProj;
+	UniformHandle m_uniformView;
+	UniformHandle m_uniformMixTint;
+	UniformHandle m_uniformSprite;
+
 	// for custom shaders
 	const char* m_vertexSource;
 	const char* m_fragmentSource;
 
-	Mesh m_quad;
+	// shared by all batches
+	GLuint m_quadVertices = 0;
+	GLuint m_quadIndices = 0;
+
 	r<Texture> m_default;
+	r<SpriteAtlas> m_atlas;
 	float z = 0;
 
 	// Set to offset each draw by a small amount
@@ -48,26 +160,47 @@ private:
 
 	void InitProgram();
 
+	// batches live between frames so their buffers keep their memory
+	// and are only removed after being unused for a while
 	struct BatchData
 	{
-		Mesh quad;
-		Buffer* uvs;
-		Buffer* tints;
-		Buffer* models;
+		GLuint vao = 0;
+		GLuint instances = 0;
+
+		int capacity = 0;
+		int count = 0;
+		int framesUnused = 0;
 
-		int count;
+		BatchData(GLuint quadVertices, GLuint quadIndices);
+		~BatchData();
 
-		BatchData();
+		BatchData(const BatchData& copy) = delete;
+		BatchData& operator=(const BatchData& copy) = delete;
 
-		void add(const mat4& model, const vec4& uv, const vec4& tint);
+		// map the instance buffer for writing 'count' instances, grows the buffer if needed
+		// returns nullptr if the buffer could not be mapped
+		BatchSpriteInstance* begin(int count);
+
+		// unmap and draw
 		void finalize();
 	};
 
-	std::unordered_map<int, BatchData> m_batches;
+	BatchSpriteList m_list;
+
+	std::vector<std::unique_ptr<BatchSpriteList>> m_lists;
+	std::mutex m_listsMutex;
+
+	std::vector<BatchSpriteInstance> m_instances;
+	std::vector<BatchSpriteCommand> m_commands;
+	std::vector<BatchSpriteCommand> m_commandsScratch;
+
+	std::unordered_map<u32, BatchData> m_batches;
 
 	void SetProgram(const mat4& proj, const mat4& view, bool mixTint);
 	void DrawBatch(int handle, BatchData& batch);
-    
+	void MergeList(BatchSpriteList& list);
+	void SortCommands();
+
 
 public:
     r<Texture> GetDefaultTexture() const;
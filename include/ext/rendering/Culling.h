@@ -0,0 +1,177 @@
+#pragma once
+
+#include "util/math.h"
+#include "util/AABB.h"
+#include "ext/rendering/Camera.h"
+#include <vector>
+#include <unordered_map>
+
+// Visibility for draw submission
+//
+// The indexes hold a bounds and a user value for each object. Moving objects are updated
+// in place, so the index is kept in sync with transforms by calling Update when they change.
+// Queries write the user values of what's visible, so submission only loops over those.
+//
+// Boxes in leaves are tested four at a time with sse when it's available
+
+// A box in 3D
+//
+struct CullBounds
+{
+	vec3 min;
+	vec3 max;
+
+	CullBounds();
+	CullBounds(vec3 min, vec3 max);
+
+	CullBounds combine(const CullBounds& other) const;
+	bool contains(const CullBounds& other) const;
+	float surface_area() const;
+};
+
+enum CullResult
+{
+	CULL_OUTSIDE,
+	CULL_INTERSECTS,
+	CULL_INSIDE
+};
+
+// Six planes pointing inwards, xyz is the normal and w the distance
+//
+struct Frustum
+{
+	vec4 planes[6];
+
+	CullResult Test(const CullBounds& bounds) const;
+
+	static Frustum FromMatrix(const mat4& projectionView);
+	static Frustum FromCamera(const Camera& camera);
+};
+
+// The world space rect a 2D camera sees
+aabb2D CullCameraRect(const Camera& camera);
+
+// Test boxes stored as separate arrays, writes the indices of the boxes that aren't outside
+// returns the number written
+int CullRects(const aabb2D& view, const float* minX, const float* minY, const float* maxX, const float* maxY, int count, int* visible);
+int CullBoxes(const Frustum& frustum, const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ, int count, int* visible);
+
+// A loose quadtree for 2D
+//
+// Each node's bounds are twice the size of its cell, so an object only needs its size to
+// pick its depth and its center to pick its cell. This makes Update O(1), an object that
+// stays in its cell doesn't touch the tree at all.
+// Objects outside of the world bounds are kept in the root
+//
+class CullQuadtree
+{
+public:
+	CullQuadtree(const aabb2D& world = aabb2D(vec2(-1024.f), vec2(1024.f)), int maxDepth = 8);
+
+	int  Insert(const aabb2D& bounds, u32 user);
+	void Update(int proxy, const aabb2D& bounds);
+	void Remove(int proxy);
+
+	// append the user value of each object overlapping view
+	void Query(const aabb2D& view, std::vector<u32>& visible) const;
+
+	int Count() const;
+	void Clear();
+
+private:
+	struct Node
+	{
+		// bounds of the objects directly in this node, split for testing 4 at a time
+		std::vector<float> minX, minY, maxX, maxY;
+		std::vector<int> proxies;
+
+		int subtreeCount = 0; // objects in this node and below
+	};
+
+	struct Proxy
+	{
+		aabb2D bounds;
+		u32 user;
+		u64 node;
+		int index; // in the node's arrays
+		bool alive;
+	};
+
+	u64 PickNode(const aabb2D& bounds) const;
+	void AddToNode(int proxy, u64 key);
+	void RemoveFromNode(int proxy);
+	void QueryNode(u64 key, const aabb2D& view, std::vector<u32>& visible) const;
+	void AddSubtree(u64 key, std::vector<u32>& visible) const;
+	aabb2D LooseBounds(u64 key) const;
+
+private:
+	aabb2D m_world;
+	float m_size;
+	int m_maxDepth;
+
+	std::unordered_map<u64, Node> m_nodes;
+	std::vector<Proxy> m_proxies;
+	std::vector<int> m_free;
+	int m_count = 0;
+
+	mutable std::vector<int> m_scratch;
+};
+
+// A dynamic bounding volume hierarchy for 3D
+//
+// Leaves store bounds grown by a margin, Update only reinserts an object once it moves out of them.
+// Inserts pick the sibling which grows the surface area the least and rotations keep the tree balanced
+//
+class CullBVH
+{
+public:
+	CullBVH(float margin = 0.1f);
+
+	int  Insert(const CullBounds& bounds, u32 user);
+
+	// returns true if the object had to be reinserted
+	bool Update(int proxy, const CullBounds& bounds);
+	void Remove(int proxy);
+
+	// append the user value of each object in the frustum
+	void Query(const Frustum& frustum, std::vector<u32>& visible) const;
+
+	int Count() const;
+	int Height() const;
+	void Clear();
+
+private:
+	struct Node
+	{
+		CullBounds bounds; // grown by the margin for leaves
+		CullBounds tight;  // leaves only
+		u32 user = 0;
+
+		int parent = -1; // next free node when unused
+		int child1 = -1;
+		int child2 = -1;
+		int height = 0;  // 0 for leaves, -1 when unused
+
+		bool IsLeaf() const { return child1 == -1; }
+	};
+
+	int  AllocateNode();
+	void FreeNode(int node);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	int  Balance(int node);
+	void Refit(int node);
+
+private:
+	std::vector<Node> m_nodes;
+	int m_root = -1;
+	int m_free = -1;
+	int m_count = 0;
+	float m_margin;
+
+	// leaves gathered by Query, tested together
+	mutable std::vector<float> m_minX, m_minY, m_minZ, m_maxX, m_maxY, m_maxZ;
+	mutable std::vector<u32> m_users;
+	mutable std::vector<int> m_stack;
+	mutable std::vector<int> m_scratch;
+};
@@ -8,6 +8,7 @@
 #include "ext/rendering/Particle.h"
 #include "ext/rendering/Model.h"
 #include "ext/rendering/Sprite.h"
+#include "ext/rendering/SpriteCullIndex.h"
 
 enum ShowEntityIdMode
 {
@@ -37,6 +38,11 @@ void RenderLines  (BatchLineRenderer&   render, const Camera& camera, EntityWorl
 void RenderSprites(const Camera& camera, EntityWorld& world);
 void RenderLines  (const Camera& camera, EntityWorld& world);
 
+// syncs the index with the sprites' transforms, then only submits the sprites the camera sees
+// keep one index per world, particles aren't in the index and are all submitted
+void RenderSprites(BatchSpriteRenderer& render, const Camera& camera, EntityWorld& world, SpriteCullIndex& index);
+void RenderSprites(const Camera& camera, EntityWorld& world, SpriteCullIndex& index);
+
 r<Mesh> GetQuadMesh2D();
 Mesh& InitQuadMesh2D(Mesh& mesh);
 
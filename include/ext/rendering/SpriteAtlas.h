@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Rendering.h"
+#include "v2/Render/TextureCache.h"
+#include <unordered_map>
+
+struct SpriteAtlasEntry
+{
+	int page = 0;
+	vec2 uvOffset = vec2(0.f);
+	vec2 uvScale  = vec2(1.f);
+};
+
+// Packs small textures into shared pages at runtime, so sprites using
+// different textures can be drawn with a single bind per page
+//
+// Only static rgba textures that are still on the host can be added, because
+// static textures free their host memory once they are sent to the device
+// Must be used on the render thread
+//
+class SpriteAtlas
+{
+public:
+	SpriteAtlas(int pageSize = 2048, int maxTextureSize = 256, TextureCachePacker packer = TextureCachePackerTree);
+
+	// find where a texture is in the atlas, adds it to a page if it hasn't been seen before
+	// returns false if the texture cannot be put in the atlas
+	bool Get(const r<Texture>& texture, SpriteAtlasEntry* entry);
+
+	// send pages that have changed since the last call
+	void SendToDevice();
+
+	int NumberOfPages() const;
+	int PageHandle(int page) const;
+	r<Texture> PageTexture(int page) const;
+
+private:
+	struct Entry
+	{
+		wr<Texture> texture; // to tell if the pointer was reused by a new texture
+		SpriteAtlasEntry entry;
+	};
+
+	std::vector<TextureCache> m_pages;
+	std::unordered_map<const Texture*, Entry> m_entries;
+
+	int m_pageSize;
+	int m_maxTextureSize;
+	TextureCachePacker m_packer;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Entity.h"
+#include "ext/rendering/Culling.h"
+#include <unordered_map>
+
+// Keeps the entities with a Transform2D and Sprite in a quadtree, so drawing them only
+// loops over the ones a camera can see
+//
+// Sync brings the tree up to date with the transforms. It compares each sprite's bounds with
+// the ones in the tree and only moves those that changed, which is a few compares per sprite
+// instead of packing, sorting and uploading it. Entities that lost their sprite or were
+// destroyed are removed
+//
+class SpriteCullIndex
+{
+public:
+	SpriteCullIndex(const aabb2D& world = aabb2D(vec2(-1024.f), vec2(1024.f)), int maxDepth = 8);
+
+	void Sync(EntityWorld& world);
+
+	// append the ids of the entities whose sprite overlaps view, see EntityWorld::Wrap
+	void Query(const aabb2D& view, std::vector<u32>& visible) const;
+
+	int Count() const;
+	void Clear();
+
+	// covers the sprite's quad at any rotation, the same bounds BatchSpriteList culls with
+	static aabb2D SpriteBounds(const Transform2D& transform);
+
+private:
+	struct Entry
+	{
+		int proxy;
+		aabb2D bounds;
+		u32 stamp; // the last Sync that saw this entity
+	};
+
+	CullQuadtree m_tree;
+	std::unordered_map<u32, Entry> m_entries;
+	u32 m_stamp = 0;
+};
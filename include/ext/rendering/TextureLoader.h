@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Rendering.h"
+#include "ext/AssetStore.h"
+#include "util/thread_pool.h"
+
+#include <functional>
+#include <vector>
+#include <string>
+#include <mutex>
+
+// Loads textures from disk without stalling the main thread
+//
+// Load returns the asset right away with a 1x1 transparent placeholder in it, the image is decoded on
+// a worker thread and swapped into the same Texture by Update. Anything holding the asset
+// sees the real image once it's done, without having to reacquire it.
+//
+// Update must be called on the thread that owns the gl context, once a frame. It uploads
+// at most uploadBudget bytes each call, so loading a level spreads the uploads over a few frames
+// instead of hitching on one.
+//
+class TextureLoader
+{
+public:
+	using Callback = std::function<void(a<Texture>)>;
+
+	TextureLoader(int threadCount = 2);
+	~TextureLoader();
+
+	TextureLoader(const TextureLoader& copy) = delete;
+	TextureLoader& operator=(const TextureLoader& copy) = delete;
+
+	// Start loading a texture, or get it if it's already been loaded
+	// onLoaded is called from Update after the texture has been swapped in, or right away if the asset was already loaded
+	// if sendToDevice is false the texture stays on the host, for textures that get packed into atlases
+	a<Texture> Load(const std::string& filename, const Callback& onLoaded = {}, bool sendToDevice = true, bool isStatic = true);
+
+	// swap in decoded textures, upload them and call their callbacks
+	// always finishes at least one texture so a large image can't stall the queue
+	void Update(int uploadBudget = 4 * 1024 * 1024);
+
+	// block until every load has finished decoding, then finish them all
+	void Flush();
+
+	bool IsLoading(const a<Texture>& texture) const;
+	int NumberLoading() const;
+
+private:
+	struct Pending
+	{
+		std::string name;
+		r<Texture> target; // the placeholder the decoded texture gets moved into
+		r<Texture> decoded;
+		std::vector<Callback> callbacks;
+		bool sendToDevice;
+	};
+
+	void Finish(Pending& pending);
+
+	thread_pool m_pool;
+
+	std::vector<r<Pending>> m_pending; // in the order of Load, only touched by the main thread
+
+	// loads the workers have finished, in the order they finished
+	std::vector<r<Pending>> m_decoded;
+	mutable std::mutex m_decodedMutex;
+};
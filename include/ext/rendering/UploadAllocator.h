@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Rendering.h"
+#include <vector>
+
+// A range of transient data handed out by an UploadAllocator
+//
+struct UploadAllocation
+{
+	void* data = nullptr; // staging memory to write into, valid until the next Allocate or Flush
+	int offset = 0;       // bytes into DeviceHandle()
+	int bytes = 0;
+
+	template<typename _t>
+	_t* As() { return (_t*)data; }
+};
+
+// Linear allocator for transient vertex, index and instance data
+//
+// Allocations are ranges of a host staging buffer which Flush uploads in a single call.
+// Each frame writes into the next device buffer of a small ring, so a buffer
+// the gpu may still be reading from last frame isn't written into.
+// Both the staging memory and the device buffers keep their size between frames and only grow,
+// uploads and reallocations are counted in gl_state_frame_counters
+//
+class UploadAllocator
+{
+public:
+	UploadAllocator(int framesInFlight = 3);
+	~UploadAllocator();
+
+	UploadAllocator(const UploadAllocator& copy) = delete;
+	UploadAllocator& operator=(const UploadAllocator& copy) = delete;
+
+	// alignment of 1 keeps allocations of the same size contiguous
+	UploadAllocation Allocate(int bytes, int alignment = 16);
+
+	// upload everything allocated since the last Flush to DeviceHandle()
+	// call before drawing from the allocations
+	void Flush();
+
+	// start writing into the next buffer of the ring, drops all allocations
+	void NextFrame();
+
+	// the device buffer of this frame
+	GLuint DeviceHandle() const;
+
+	// bytes allocated this frame
+	int Used() const;
+
+private:
+	struct Frame
+	{
+		GLuint buffer = 0;
+		int capacity = 0;
+	};
+
+	std::vector<Frame> m_frames;
+	std::vector<char> m_staging;
+
+	int m_current = 0;
+	int m_used = 0;    // bytes allocated this frame
+	int m_flushed = 0; // bytes of this frame already on the device
+};
@@ -145,6 +145,13 @@ namespace meta
 		bool m_is_integral        = false;
         
 		bool m_is_complex         = false;
+
+		// trivially copyable and not an enum, enums are written as size_t
+		bool m_is_trivial         = false;
+
+		// cache for type::is_packed, recomputed when types_generation changes
+		int m_packed_generation   = -1;
+		bool m_is_packed          = false;
 	};
 
 	template<typename _t>
@@ -157,6 +164,7 @@ namespace meta
 		info->m_is_floating  = std::is_floating_point<_t>::value;
 		info->m_is_integral  = std::is_integral<_t>::value;
 		info->m_is_complex = std::is_class<_t>::value;
+		info->m_is_trivial = std::is_trivially_copyable<_t>::value && !std::is_enum<_t>::value;
 
 		return info;
 	}
@@ -171,6 +179,7 @@ namespace meta
 		info->m_is_floating = false;
 		info->m_is_integral = false;
 		info->m_is_complex = false;
+		info->m_is_trivial = false;
 
 		return info;
 	}
@@ -217,6 +226,9 @@ namespace meta
 		// asserts m_is_member = true
 		virtual const char* member_name() const = 0;
 
+		// if the type is a member, bytes from the start of its class
+		virtual size_t member_offset() const = 0;
+
 		// walks a pointer forward to a member of the type
 		// instance should be of the same type as the type
 		virtual void* walk_ptr(const void* instance) const = 0;
@@ -260,6 +272,11 @@ namespace meta
 			return get_members().size() > 0;
 		}
 
+		// if the binary form of the type is the same as its bytes in memory, so arrays of it can be
+		// copied in one go. true for primitives, and classes with no custom read/write whose members
+		// are packed and cover the class in order without padding
+		bool is_packed() const;
+
 		//template<typename _t>
 		//void set_prop(const std::string& name, const _t& value)
 		//{
@@ -615,6 +632,9 @@ namespace meta
 
 		std::unordered_map<id_type, registered_type> known_info;
 
+		// changes each time a type is registered or changed, for caches of type info
+		int generation = 0;
+
 		void Realloc(int location) override;
 	};
 
@@ -624,6 +644,10 @@ namespace meta
 
 	void register_type(id_type type_id, type* type);
 
+	// call when a type's members or properties change
+	void types_changed();
+	int types_generation();
+
 	bool has_registered_type(id_type type_id);
 	type* get_registered_type(id_type type_id);
 
@@ -667,6 +691,10 @@ namespace meta
 		void write_array (type* type, const void* instance, size_t length);
 		void write_string(const char* string, size_t length);
 
+		// write count instances of a packed type as one block of bytes, returns false if
+		// the format doesn't support this and each instance needs to be written on its own
+		virtual bool write_packed(type* type, const void* instance, size_t count);
+
 		virtual void class_begin(type* type) = 0;
 		virtual void class_delim() = 0;
 		virtual void class_end() = 0;
@@ -731,6 +759,9 @@ namespace meta
 		void read_array (type* type, void* instance, size_t length);
 		void read_string(char* string, size_t length);
 
+		// see serial_writer::write_packed
+		virtual bool read_packed(type* type, void* instance, size_t count);
+
 		virtual void class_begin(type* type) = 0;
 		virtual void class_delim() = 0;
 		virtual void class_end() = 0;
@@ -957,13 +988,15 @@ namespace meta
 	private:
 		_class_type<_mtype>* m_class;
 		std::string m_name;
+		size_t m_offset;
 		std::unordered_map<std::string, any> m_props;
 
 	public:
 		_class_member(_class_type<_mtype>* member_class_type, const char* member_name)
-			: type    (member_class_type->info())
-			, m_class (member_class_type)
-			, m_name  (member_name)
+			: type     (member_class_type->info())
+			, m_class  (member_class_type)
+			, m_name   (member_name)
+			, m_offset ((size_t)&(((const _t*)nullptr)->*_m)) // offsetof for a member pointer, nothing is read
 		{}
         
         virtual ~_class_member() {}
@@ -994,6 +1027,11 @@ namespace meta
 			return m_name.c_str();
 		}
 
+		size_t member_offset() const override
+		{
+			return m_offset;
+		}
+
 		void* walk_ptr(const void* instance) const override
 		{
 			return (void*) & (((const _t*)instance)->*_m);
@@ -1032,6 +1070,7 @@ namespace meta
 		void set_prop(const std::string& name, const any& value) override
 		{
 			m_props[name].copy_own(value);
+			types_changed();
 		}
 
 		void ping(void* userdata = nullptr, int message = 0) const override
@@ -1087,6 +1126,8 @@ namespace meta
 			m_members.push_back(
 				new _class_member<_t, _m>(_get_class<ptrtype<_m>>(), name)
 			);
+
+			types_changed();
 		}
 
 		void set_custom_writer(const std::function<void(serial_writer*, const _t&)>& func)
@@ -1161,6 +1202,11 @@ namespace meta
 			throw nullptr;
 		}
 
+		size_t member_offset() const override
+		{
+			return 0;
+		}
+
 		void* walk_ptr(const void* instance) const override
 		{
 			return (void*)instance;
@@ -1221,6 +1267,7 @@ namespace meta
 		void set_prop(const std::string& name, const any& value) override
 		{
 			m_props[name].copy_own(value);
+			types_changed();
 		}
 
 		void ping(void* userdata = nullptr, int message = 0) const override
@@ -1260,6 +1307,7 @@ namespace meta
 		bool                      is_member()                                                const override { return false; }
 		const std::vector<type*>& get_members()                                              const override { assert(false && "type was void"); throw nullptr; }
 		const char*               member_name()                                              const override { assert(false && "type was not a member"); throw nullptr; }
+		size_t                    member_offset()                                            const override { assert(false && "type was not a member"); throw nullptr; }
 		void*                     walk_ptr(const void* instance)                             const override { assert(false && "type was void"); throw nullptr; }
 		void                      _serial_write(serial_writer* serial, const void* instance) const override { assert(false && "type was void"); throw nullptr; }
 		void                      _serial_read(serial_reader* serial, void* instance)        const override { assert(false && "type was void"); throw nullptr; }
@@ -1564,16 +1612,39 @@ namespace meta
 		serial->array_end();
 	}
 
+	// vectors are contiguous, so they are written as arrays which can be copied in one go
+
 	template<typename _t>
 	void serial_write(serial_writer* serial, const std::vector<_t>& instance)
 	{
-		write_lienar(serial, instance);
+		if constexpr (std::is_same<_t, bool>::value)
+		{
+			write_lienar(serial, instance);
+		}
+
+		else
+		{
+			serial->write_array(meta::get_class<_t>(), instance.data(), instance.size());
+		}
 	}
 
 	template<typename _t>
 	void serial_read(serial_reader* serial, std::vector<_t>& instance)
 	{
-		read_linear(serial, instance);
+		if constexpr (std::is_same<_t, bool>::value)
+		{
+			read_linear(serial, instance);
+		}
+
+		else
+		{
+			size_t length = serial->read_length();
+
+			instance.clear();
+			instance.resize(length);
+
+			serial->read_array(meta::get_class<_t>(), instance.data(), length);
+		}
 	}
 
 	template<typename _t>
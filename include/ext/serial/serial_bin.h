@@ -21,6 +21,9 @@ struct bin_writer : meta::serial_writer
 	void string_end() override;
 
     void write_bytes(const char* bytes, size_t length) override;
+
+	// packed types are written as their bytes in memory
+	bool write_packed(meta::type* type, const void* instance, size_t count) override;
 };
 
 struct bin_reader : meta::serial_reader
@@ -43,6 +46,8 @@ struct bin_reader : meta::serial_reader
     
     size_t read_length() override;
     void read_bytes(char* bytes, size_t length) override;
+
+    bool read_packed(meta::type* type, void* instance, size_t count) override;
 };
 
 
@@ -24,11 +24,10 @@ struct json_writer : meta::serial_writer
 	void write_bytes(const char* bytes, size_t length) override;
 };
 
-// fwd json.h
-struct json_value_s;
-struct json_array_element_s;
-struct json_object_element_s;
-
+// Reads the values in order as serial_reader asks for them, without building a tree of the document.
+// The stream is read once into a buffer, which is the only copy kept.
+// Members are matched by their order, values the reader doesn't ask for are skipped
+//
 struct json_reader : meta::serial_reader
 {
 public:
@@ -52,24 +51,36 @@ public:
 	void read_bytes(char* bytes, size_t length) override;
     
 private:
-    struct json_frame
-    {
-        meta::type* type;
-        int what;
-
-        json_frame(meta::type* type, json_value_s*          value)  : type(type), value (value),  what(0) {}
-        json_frame(meta::type* type, json_array_element_s*  item)   : type(type), item  (item),   what(1) {}
-        json_frame(meta::type* type, json_object_element_s* member) : type(type), member(member), what(2) {}
-
-        union
-        {
-            json_value_s* value;
-            json_array_element_s*  item;
-            json_object_element_s* member;
-        };
-
-        json_value_s* get_value();
-    };
-
-    std::stack<json_frame> m_frames;
+	enum frame_kind
+	{
+		fValue,  // a member's value, which may not have been read
+		fObject,
+		fArray
+	};
+
+	struct json_frame
+	{
+		meta::type* type;
+		frame_kind kind;
+		bool consumed;
+	};
+
+	void skip_space();
+	bool expect(char c);
+
+	// mark the value being read as done, so member_end doesn't skip it
+	void consumed();
+
+	// return the end of the value or string at p, without reading it
+	const char* skip_value(const char* p) const;
+	const char* skip_string(const char* p) const;
+
+	// write the unescaped chars of the string at p into out if it isn't null, returns the length
+	size_t read_string(const char* p, char* out, size_t capacity) const;
+
+private:
+	std::string m_json;
+	const char* m_at;
+
+	std::stack<json_frame> m_frames;
 };
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "util/ref.h"
+#include <string>
+#include <stdint.h>
+
+// A texture baked offline into the layout the device wants, so loading doesn't decode anything
+//
+// The file is a header followed by the mip chain, largest first. Rows are already flipped
+// for gl and tightly packed, so levels are uploaded with an unpack alignment of 1. Each
+// level starts on a 16 byte boundary. Mapping a file is a single mmap, Pixels
+// point straight into the mapping. The mapping is copy on write, so the pixels can be written to
+// without touching the file.
+
+#define COOKED_TEXTURE_MAGIC "WTEX"
+#define COOKED_TEXTURE_VERSION 1
+#define COOKED_TEXTURE_EXTENSION ".wtex"
+#define COOKED_TEXTURE_MAX_MIPS 16
+#define COOKED_TEXTURE_MAX_SIZE 16384 // largest width or height a file can claim
+
+enum CookedTextureFormat : uint32_t
+{
+	CookedTextureRaw // 8 bits per channel, channels from the source image
+	// block compressed formats would go here, levels are stored the same way
+};
+
+struct CookedTextureHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t channels;
+	uint32_t bytesPerChannel;
+	uint32_t mipCount;
+	uint64_t mipOffsets[COOKED_TEXTURE_MAX_MIPS]; // bytes from the start of the file
+	uint64_t mipBytes  [COOKED_TEXTURE_MAX_MIPS];
+};
+
+struct CookedTextureMip
+{
+	char* pixels;
+	int width;
+	int height;
+	int bytes;
+};
+
+// A mapped cooked texture file, unmapped on destruction
+//
+class CookedTexture
+{
+public:
+	CookedTexture(char* mapping, uint64_t size, void* platform);
+	~CookedTexture();
+
+	CookedTexture(const CookedTexture& copy) = delete;
+	CookedTexture& operator=(const CookedTexture& copy) = delete;
+
+	const CookedTextureHeader& Header() const;
+	int MipCount() const;
+	CookedTextureMip Mip(int level) const;
+
+private:
+	char* m_mapping;
+	uint64_t m_size;
+	void* m_platform; // the file mapping handle on windows
+};
+
+// Decode an image with stb and write it as a cooked texture
+// mips builds the full chain down to 1x1 with a box filter
+bool io_CookTexture(const char* imagePath, const char* cookedPath, bool mips = true);
+
+// Cook every png/jpg/tga/bmp under a folder next to its image, skips images whose cooked file is up to date
+// returns the number of textures cooked
+int io_CookTexturesInFolder(const char* folder, bool mips = true);
+
+// Map a cooked texture, returns null if the file can't be opened or isn't valid
+r<CookedTexture> io_MapCookedTexture(const char* cookedPath);
+
+// The cooked file to use in place of an image, or an empty string if there isn't one
+// A path that is already a cooked file is returned as is, otherwise the image path with COOKED_TEXTURE_EXTENSION
+// added is used if it exists and isn't older than the image
+std::string io_FindCookedTexture(const std::string& imagePath);
@@ -0,0 +1,53 @@
+#pragma once
+
+// fwd
+typedef unsigned int GLenum;
+typedef unsigned int GLuint;
+
+// Shadows the gl state that gets bound every draw, so binding something that
+// is already bound doesn't make it to the driver
+//
+// Only use on the thread that owns the gl context. Code that changes this state
+// without going through here (imgui, other libraries) should call gl_state_invalidate after
+
+struct GlStateCounters
+{
+	int issued = 0;  // calls that made it to gl
+	int skipped = 0; // calls that were already the current state
+
+	int bytesUploaded = 0;
+	int reallocations = 0; // device or staging storage that had to be allocated again
+};
+
+void gl_state_use_program(GLuint program);
+void gl_state_bind_vertex_array(GLuint vao);
+void gl_state_bind_framebuffer(GLuint framebuffer);
+
+// bind to the active texture unit
+void gl_state_bind_texture(GLenum target, GLuint texture);
+void gl_state_bind_texture_unit(int unit, GLenum target, GLuint texture);
+void gl_state_active_texture(int unit);
+
+void gl_state_blend(bool enabled, GLenum src, GLenum dst);
+
+// the current blend state, asks gl if it isn't known, so it can be put back after changing it
+void gl_state_get_blend(bool& enabled, GLenum& src, GLenum& dst);
+
+// call before deleting an object, gl can give its name to a new object
+// which would then look like it was already bound
+void gl_state_forget_program(GLuint program);
+void gl_state_forget_vertex_array(GLuint vao);
+void gl_state_forget_framebuffer(GLuint framebuffer);
+void gl_state_forget_texture(GLuint texture);
+
+// count data sent to the device, these are rolled over with the bind counters
+void gl_state_count_upload(int bytes, bool reallocated);
+
+// forget everything, the next call of each kind is always issued
+void gl_state_invalidate();
+
+// roll the counters over, call once per frame
+void gl_state_end_frame();
+
+// counters of the last finished frame
+GlStateCounters gl_state_frame_counters();
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "util/math.h" // gives u64
+#include <string>
+#include <vector>
+
+// On disk cache of linked program binaries, so a program only has to be compiled from glsl once per driver
+//
+// The key hashes the source of every stage with the driver, so editing a shader,
+// changing the defines written into it, or updating the driver all miss the cache.
+// Nothing here calls into gl, ShaderProgram gets and sets the binaries
+
+struct ShaderCacheStage
+{
+	int stage; // ShaderProgram::ShaderName
+	std::string source;
+};
+
+// stages are hashed in order of stage, so the order they were added doesn't matter
+u64 shader_cache_hash(std::vector<ShaderCacheStage> stages, const std::string& driver);
+
+std::string shader_cache_file(const std::string& directory, u64 hash);
+
+// false if the file doesn't exist or was written for a different hash
+bool shader_cache_load(const std::string& file, u64 hash, u32* format, std::vector<char>& binary);
+bool shader_cache_save(const std::string& file, u64 hash, u32 format, const std::vector<char>& binary);
@@ -17,7 +17,7 @@ private:
 
 	std::vector<std::thread> m_threads;
 	tsque<work_item> m_work; // if the thread should stop, work to be done
-    int m_workCount;
+    int m_workCount = 0;
     
     std::condition_variable var;
     std::mutex waitMutex;
@@ -82,6 +82,11 @@ public:
 		m_work.push_back(work_item{ false, work });
 	}
     
+    int size() const
+    {
+        return (int)m_threads.size();
+    }
+
     void wait()
     {
         std::unique_lock lock(waitMutex);
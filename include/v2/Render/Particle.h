@@ -8,9 +8,11 @@
 #include "Rendering.h"
 
 #include <array>
+#include <cfloat>
 
 #include "v2/Render/CameraLens.h"
 #include "v2/Render/TextureCache.h"
+#include "ext/rendering/TextureLoader.h"
 
 struct ParticleData
 {
@@ -100,6 +102,26 @@ void particle_RegisterMetaTypes();
 void particle_SaveSpawn(const ParticleSpawn& spawn, const std::string& filepath);
 ParticleSpawn particle_LoadSpawn(const std::string& filepath);
 
+// Controls how often particles outside of the screen are simulated
+//
+struct ParticleOffscreenRate
+{
+	// simulate off-screen particles once every n updates, 1 is every update
+	int interval = 1;
+
+	// max number of off-screen particles to simulate per update, -1 for no limit
+	int budget = -1;
+};
+
+// Set by the culling stage when a particle is outside of the screen, kept next to
+// the particles so it isn't uploaded with them
+//
+struct ParticleCulling
+{
+	bool culled = false;
+	float culledTime = 0.f; // time that has not been simulated yet because of a reduced update rate
+};
+
 class ParticleMesh
 {
 private:
@@ -107,11 +129,18 @@ private:
 	GLuint m_particleInstVBO = 0;
 
 	ParticleData* m_particles = nullptr;
+	ParticleCulling* m_culling = nullptr;
 	int m_fixedCount = 0;
 
+	int m_visibleCount = 0;
+	int m_updateFrame = 0;
+	bool m_hasCulled = false; // if Cull or ClearCulling was called since the last Draw
+
 public:
 	int count = 0;
 
+	ParticleOffscreenRate offscreen;
+
 	ParticleMesh() = default;
 	ParticleMesh(int fixedCount);
 
@@ -125,6 +154,12 @@ public:
 	void Update(float dt);
 	void Draw();
 
+	// mark particles outside of the bounds as culled, they are not uploaded in the next Draw
+	// if neither Cull or ClearCulling is called before a Draw, every particle is drawn
+	// return the number of visible particles
+	int Cull(vec2 min, vec2 max);
+	void ClearCulling();
+
 	void SortZOrder(float zBase);
 };
 
@@ -156,6 +191,12 @@ public:
 	void Update(float dt);
 	void Draw(const CameraLens& lens);
 
+	// if enabled, particles outside of the screen are not drawn
+	void SetCulling(bool enable);
+
+	// set the update rate of culled particles for either blend mode
+	void SetOffscreenRate(bool additive, const ParticleOffscreenRate& rate);
+
 	TextureCacheImg RegTexture(r<Texture> texture);
 
 private:
@@ -168,6 +209,13 @@ private:
 	TextureCache m_textureCache;
 	std::unordered_map<int, TextureCacheImg> m_textureCacheImgs;
 
-	vec2 m_min;
-	vec2 m_max;
+	TextureLoader m_loader;
+	std::vector<a<Texture>> m_loading; // textures from Init which haven't been registered yet
+
+	void RegLoadedTextures();
+
+	vec2 m_min = vec2(-FLT_MAX);
+	vec2 m_max = vec2( FLT_MAX);
+
+	bool m_enableCulling = true;
 };
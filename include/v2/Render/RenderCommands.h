@@ -0,0 +1,200 @@
+#pragma once
+
+#include "Rendering.h"
+#include "util/math.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+
+// Draws recorded into a buffer on any thread and replayed on the render thread
+//
+// Each Draw ends a packet, which holds the target, pipeline and mesh bound at the time and
+// the uniforms and textures set since the last Draw. Packets are sorted by their key
+// and replayed through a backend, so recording doesn't touch the graphics api.
+//
+// Uniforms are stored in the program, so a value set in one packet is still set in the
+// following packets using the same program. Set every value a draw depends on if its
+// packet can be sorted away from the packet that set it.
+//
+// Uniforms set by name are looked up in the program of the bound pipeline when they are
+// recorded, so the program has to be linked before recording starts. Resolve a handle once
+// with ShaderProgram::Uniform and record that to skip the lookup.
+
+enum RenderUniformType : u8
+{
+	RenderUniformInt,
+	RenderUniformU32,
+	RenderUniformF32,
+	RenderUniformVec2,
+	RenderUniformVec3,
+	RenderUniformVec4,
+	RenderUniformMat4
+};
+
+struct RenderUniform
+{
+	UniformHandle handle;
+	RenderUniformType type;
+	float value[16]; // bytes of the value, ints are stored bitwise
+};
+
+struct RenderPipeline
+{
+	r<ShaderProgram> program;
+	bool alphaBlend = true;
+};
+
+// Executes replayed commands
+//
+struct RenderCommandBackend
+{
+	virtual ~RenderCommandBackend() = default;
+
+	// binds the target and sets the viewport to its size, nullptr for the default target
+	virtual void SetTarget(const r<Target>& target) = 0;
+	virtual void BindPipeline(const RenderPipeline& pipeline) = 0;
+	virtual void SetUniform(ShaderProgram& program, const RenderUniform& uniform) = 0;
+	virtual void SetTexture(ShaderProgram& program, UniformHandle uniform, const r<Texture>& texture) = 0;
+
+	// instances is 0 for a draw without instancing
+	virtual void Draw(Mesh& mesh, int instances) = 0;
+};
+
+// Calls into the device, only replay on the render thread
+//
+struct RenderCommandBackendGl : RenderCommandBackend
+{
+	void SetTarget(const r<Target>& target) override;
+	void BindPipeline(const RenderPipeline& pipeline) override;
+	void SetUniform(ShaderProgram& program, const RenderUniform& uniform) override;
+	void SetTexture(ShaderProgram& program, UniformHandle uniform, const r<Texture>& texture) override;
+	void Draw(Mesh& mesh, int instances) override;
+};
+
+// Writes a line for each command, doesn't need a device
+//
+struct RenderCommandBackendLog : RenderCommandBackend
+{
+	std::vector<std::string> lines;
+
+	void SetTarget(const r<Target>& target) override;
+	void BindPipeline(const RenderPipeline& pipeline) override;
+	void SetUniform(ShaderProgram& program, const RenderUniform& uniform) override;
+	void SetTexture(ShaderProgram& program, UniformHandle uniform, const r<Texture>& texture) override;
+	void Draw(Mesh& mesh, int instances) override;
+};
+
+// A list of commands filled by a single thread
+//
+class RenderCommandBuffer
+{
+public:
+	// the sort key of the next Draw, lower keys are replayed first
+	// draws with the same key keep the order they were recorded in
+	void SetKey(u64 key);
+
+	// draw into a target other than the one given to Replay
+	// nullptr goes back to the target given to Replay
+	void SetTarget(r<Target> target);
+
+	void BindPipeline(const RenderPipeline& pipeline);
+	void BindPipeline(r<ShaderProgram> program, bool alphaBlend = true);
+	void BindMesh(r<Mesh> mesh);
+
+	void SetUniform(UniformHandle uniform, const   int& x);
+	void SetUniform(UniformHandle uniform, const   u32& x);
+	void SetUniform(UniformHandle uniform, const   f32& x);
+	void SetUniform(UniformHandle uniform, const fvec2& x);
+	void SetUniform(UniformHandle uniform, const fvec3& x);
+	void SetUniform(UniformHandle uniform, const fvec4& x);
+	void SetUniform(UniformHandle uniform, const fmat4& x);
+	void SetUniform(UniformHandle uniform, const Color& color);
+
+	void SetTexture(UniformHandle uniform, r<Texture> texture);
+
+	// looked up in the program of the bound pipeline
+	template<typename _t>
+	void SetUniform(const std::string& name, const _t& x) { SetUniform(Find(name), x); }
+	void SetTexture(const std::string& name, r<Texture> texture);
+
+	// end the packet, needs a pipeline and mesh to be bound
+	void Draw();
+	void DrawInstanced(int instances);
+
+	int Count() const;
+	void Clear();
+
+private:
+	friend class RenderCommandQueue;
+
+	enum CommandType : u8
+	{
+		CommandUniform,
+		CommandTexture
+	};
+
+	struct Command
+	{
+		CommandType type;
+		u32 index;
+	};
+
+	struct Packet
+	{
+		u64 key;
+		u32 begin; // range in m_commands
+		u32 end;
+		int target; // -1 for the target given to Replay
+		u32 pipeline;
+		u32 mesh;
+		int instances;
+	};
+
+	std::vector<Command> m_commands;
+	std::vector<Packet> m_packets;
+
+	std::vector<RenderUniform> m_uniforms;
+	std::vector<std::pair<UniformHandle, r<Texture>>> m_textures;
+	std::vector<r<Target>> m_targets;
+	std::vector<RenderPipeline> m_pipelines;
+	std::vector<r<Mesh>> m_meshes;
+
+	u64 m_key = 0;
+	u32 m_begin = 0;
+	int m_target = -1;
+
+	UniformHandle Find(const std::string& name) const;
+	void SetUniform(UniformHandle uniform, RenderUniformType type, const void* value, int bytes);
+	void EndPacket(int instances);
+};
+
+// The buffers of each recording thread, sorted together and replayed on the render thread
+//
+class RenderCommandQueue
+{
+public:
+	// Get a buffer to record into, each thread should use its own index
+	// safe to call from any thread
+	RenderCommandBuffer& GetBuffer(int index);
+
+	// sort all packets by key and run them through the backend
+	// packets draw into target unless their buffer set another, nullptr for the default target
+	// must be called after all jobs recording into buffers have finished
+	void Replay(RenderCommandBackend& backend, r<Target> target = nullptr);
+
+	int Count() const;
+	void Clear();
+
+private:
+	struct SortedPacket
+	{
+		u64 key;
+		u32 buffer;
+		u32 packet;
+	};
+
+	std::vector<std::unique_ptr<RenderCommandBuffer>> m_buffers;
+	std::vector<SortedPacket> m_sorted;
+	std::mutex m_buffersMutex;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "v2/Render/RenderPass.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+// The name of the target a RenderGraph is run with. Passes that write it are given that target
+// in _Run, so they can't write other attachments as well
+#define RENDER_GRAPH_TARGET "target"
+
+// An attachment created and owned by the graph
+// width/height of 0 sizes it to the target the graph is run with, times scale
+//
+struct RenderGraphAttachment
+{
+	Texture::Usage usage = Texture::uRGBA;
+	float scale = 1.f;
+	int width = 0;
+	int height = 0;
+};
+
+// Schedules passes from the attachments they read and write
+//
+// Compile keeps only the passes that lead to the target or an imported attachment, orders them
+// so each attachment is written before it's read, and gives attachments which are never alive at
+// the same time the same texture. Passes are kept in the order they were added where nothing
+// forces otherwise. Compile doesn't touch the device, Run allocates the textures.
+//
+// A graph is a RenderPass itself, so it can be set as the pass of a camera
+//
+class RenderGraph : public RenderPass
+{
+public:
+	// attachments written by more than one pass are written in the order the passes were added
+	RenderGraph& AddPass(r<RenderPass> pass);
+
+	RenderGraph& CreateAttachment(const std::string& name, const RenderGraphAttachment& desc);
+
+	// an attachment owned outside of the graph, it's never shared
+	// passes writing to it are always kept
+	RenderGraph& ImportAttachment(const std::string& name, r<Texture> texture);
+
+	// order, cull and alias the passes. false if an attachment is read but never written,
+	// isn't known, or the passes depend on each other in a cycle
+	bool Compile();
+
+	// the passes which run, in order. only valid after Compile
+	const std::vector<r<RenderPass>>& Order() const;
+
+	// the index of the shared texture an attachment uses, -1 if it was culled or imported
+	int AttachmentSlot(const std::string& name) const;
+	int NumberOfSlots() const;
+
+	// bytes of the transient textures for an output size, with and without sharing
+	int SlotBytes(int width, int height) const;
+	int UnaliasedBytes(int width, int height) const;
+
+protected:
+	void _Run(const CameraLens& lens, r<Target> target) override;
+
+private:
+	struct Slot
+	{
+		RenderGraphAttachment desc;
+		int lastUse;   // index in m_order
+		r<Texture> texture;
+	};
+
+	void ResizeSlots(int width, int height);
+	bool SameSize(const RenderGraphAttachment& a, const RenderGraphAttachment& b) const;
+	int AttachmentBytes(const RenderGraphAttachment& desc, int width, int height) const;
+
+private:
+	std::vector<r<RenderPass>> m_passes;
+	std::unordered_map<std::string, RenderGraphAttachment> m_transient;
+	std::unordered_map<std::string, r<Texture>> m_imported;
+
+	bool m_compiled = false;
+	std::vector<r<RenderPass>> m_order;
+	std::vector<Slot> m_slots;
+	std::unordered_map<std::string, int> m_attachmentSlots;
+
+	std::vector<r<Target>> m_targets; // a target for each pass in m_order, made from its writes
+	int m_width = 0;
+	int m_height = 0;
+};
@@ -2,6 +2,7 @@
 
 #include "Rendering.h"
 #include "v2/Render/CameraLens.h"
+#include "v2/Render/RenderCommands.h"
 
 //	Defines the sequence of steps to render a scene
 //
@@ -11,6 +12,15 @@ public:
 	void Run(const CameraLens& lens, r<Target> target);
 	void Init();
 
+	// Set where recorded commands are replayed, nullptr for the device
+	// a RenderCommandBackendLog lets a pass run without a device
+	void SetCommandBackend(r<RenderCommandBackend> backend);
+
+	// Declare the attachments this pass uses, a RenderGraph orders and culls passes by these
+	// written attachments are put into the target given to _Run at the slot
+	RenderPass& Reads(const std::string& attachment);
+	RenderPass& Writes(const std::string& attachment, Target::AttachmentName slot = Target::aColor);
+
 protected:
 	//	Run the render pass (must be called on render thread)
 	//
@@ -20,9 +30,25 @@ protected:
 	//
 	virtual void _Init() {}
 
+	//	Draws recorded in _Run, can be filled from jobs with a buffer per job.
+	//	They are sorted and replayed after _Run returns
+	//
+	RenderCommandQueue commands;
+
+	//	An attachment this pass reads or writes, set by the RenderGraph before _Run
+	//
+	r<Texture> Attachment(const std::string& name) const;
+
 public:
 	std::unordered_map<std::string, float> inputs;
 	std::string name;
+
+	std::vector<std::string> reads;
+	std::vector<std::pair<std::string, Target::AttachmentName>> writes;
 private:
 	bool hasInit = false;
+	r<RenderCommandBackend> backend;
+
+	std::unordered_map<std::string, r<Texture>> attachments;
+	friend class RenderGraph;
 };
\ No newline at end of file
@@ -4,12 +4,18 @@
 #include "TextureView.h"
 #include "Rendering.h"
 #include "util/math.h"
+#include "rectpack2D/finders_interface.h"
 #include <vector>
 
 struct TextureCacheImg {
 	vec2 scale;
 	vec2 offset;
-	int handle;
+	int handle; // 0 if the image didn't fit
+};
+
+enum TextureCachePacker {
+	TextureCachePackerTree,       // binary tree, splits on the larger leftover side
+	TextureCachePackerRectpack2D  // rectpack2D empty spaces, usually packs tighter
 };
 
 class TextureCache
@@ -22,7 +28,7 @@ private:
 		int height() { return maxY - minY + 1; }
 
 		bool no_fit(int w, int h) {
-			return width() < w && height() < h;
+			return width() < w || height() < h;
 		}
 
 		bool exactly_fits(int w, int h) {
@@ -39,18 +45,32 @@ private:
 		void PrintGraphviz();
 	};
 
+	using Spaces = rectpack2D::empty_spaces<false>;
+
 public:
 	TextureCache() = default;
-	TextureCache(int maxWidth, int maxHeight, int channels);
+	TextureCache(int maxWidth, int maxHeight, int channels, TextureCachePacker packer = TextureCachePackerTree, int padding = 0);
 
+	// throws if the image doesn't fit
 	TextureCacheImg Add(char* pixels, int width, int height, int channels);
     TextureCacheImg AddView(const TextureView& view);
-    
+
+	// load an image, or its cooked file, and add it. throws if the image doesn't fit
+	TextureCacheImg Add(const std::string& path);
+
+	// returns an img with a handle of 0 if the image doesn't fit
+	TextureCacheImg TryAdd(char* pixels, int width, int height, int channels);
+
 	void SendToDevice();
 	r<Texture> GetTexture() const;
 
+private:
+	bool Reserve(int width, int height, int* minX, int* minY);
+
 private:
 	r<Texture> cache;
 	Node* root = nullptr;
+	r<Spaces> spaces;
 	int nextHandle = 1;
+	int padding = 0;
 };
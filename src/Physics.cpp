@@ -1,4 +1,7 @@
 #include "Physics.h"
+#include "util/thread_pool.h"
+#include <atomic>
+#include <climits>
 
 b2Vec2 _tb(const vec2& v)   { return b2Vec2(v.x, v.y); }
 vec2   _fb(const b2Vec2& v) { return vec2(v.x, v.y); }
@@ -47,31 +50,229 @@ struct RayQueryCallback : b2RayCastCallback
 	}
 };
 
+static int BodyToEntityId(b2Body* body)
+{
+	b2BodyUserData& data = body->GetUserData();
+	return data.entityId == 0 || data.entityId == (unsigned int)-1 ? data.v2EntityId : (int)data.entityId;
+}
+
+// box2d clips the ray to the fraction returned, so the last report is always the closest
+struct BatchRayCallback : b2RayCastCallback
+{
+	PhysicsRayHit* hit;
+	PhysicsQueryMode mode;
+	float length;
+
+	float ReportFixture(b2Fixture* fixture, const b2Vec2& point, const b2Vec2& normal, float fraction) override
+	{
+		hit->hit      = true;
+		hit->entity   = BodyToEntityId(fixture->GetBody());
+		hit->fixture  = fixture;
+		hit->distance = fraction * length;
+		hit->point    = _fb(point);
+		hit->normal   = _fb(normal);
+
+		return mode == QUERY_ANY ? 0.f : fraction;
+	}
+};
+
+struct BatchPointCallback : b2QueryCallback
+{
+	PhysicsPointHit* hit;
+	PhysicsQueryMode mode;
+	vec2 point;
+
+	bool ReportFixture(b2Fixture* fixture) override
+	{
+		float dist = distance(_fb(fixture->GetBody()->GetPosition()), point);
+
+		if (!hit->hit || dist < hit->distance)
+		{
+			hit->hit      = true;
+			hit->entity   = BodyToEntityId(fixture->GetBody());
+			hit->fixture  = fixture;
+			hit->distance = dist;
+		}
+
+		return mode != QUERY_ANY;
+	}
+};
+
+static b2Vec2 ClosestPointOnSegment(const b2Vec2& point, const b2Vec2& a, const b2Vec2& b)
+{
+	b2Vec2 ab = b - a;
+	float length = ab.LengthSquared();
+	float t = length > 0.f ? b2Clamp(b2Dot(point - a, ab) / length, 0.f, 1.f) : 0.f;
+
+	return a + t * ab;
+}
+
+// the closest point on the surface of a shape's child to point in the shape's local space
+// returns the point itself if it's inside
+static b2Vec2 ClosestPointOnShape(const b2Shape* shape, int child, const b2Vec2& point)
+{
+	switch (shape->GetType())
+	{
+		case b2Shape::e_circle:
+		{
+			const b2CircleShape* circle = (const b2CircleShape*)shape;
+			b2Vec2 offset = point - circle->m_p;
+			float length = offset.Length();
+
+			if (length <= circle->m_radius)
+				return point;
+
+			return circle->m_p + (circle->m_radius / length) * offset;
+		}
+		case b2Shape::e_polygon:
+		{
+			const b2PolygonShape* polygon = (const b2PolygonShape*)shape;
+			bool inside = true;
+
+			for (int i = 0; i < polygon->m_count; i++)
+			{
+				if (b2Dot(polygon->m_normals[i], point - polygon->m_vertices[i]) > 0.f)
+				{
+					inside = false;
+					break;
+				}
+			}
+
+			if (inside)
+				return point;
+
+			b2Vec2 closest = polygon->m_vertices[0];
+			float closestDistance = FLT_MAX;
+
+			for (int i = 0; i < polygon->m_count; i++)
+			{
+				const b2Vec2& a = polygon->m_vertices[i];
+				const b2Vec2& b = polygon->m_vertices[(i + 1) % polygon->m_count];
+
+				b2Vec2 onEdge = ClosestPointOnSegment(point, a, b);
+				float dist = b2DistanceSquared(point, onEdge);
+
+				if (dist < closestDistance)
+				{
+					closestDistance = dist;
+					closest = onEdge;
+				}
+			}
+
+			return closest;
+		}
+		case b2Shape::e_edge:
+		{
+			const b2EdgeShape* edge = (const b2EdgeShape*)shape;
+			return ClosestPointOnSegment(point, edge->m_vertex1, edge->m_vertex2);
+		}
+		case b2Shape::e_chain:
+		{
+			b2EdgeShape edge;
+			((const b2ChainShape*)shape)->GetChildEdge(&edge, child);
+			return ClosestPointOnSegment(point, edge.m_vertex1, edge.m_vertex2);
+		}
+		default:
+			return point;
+	}
+}
+
+// called by the tree for each fixture it can't rule out, the distance to the fixture's aabb is never more
+// than to its surface, so returning the exact distance lets the tree skip what's further
+struct ClosestCallback
+{
+	const b2BroadPhase* broadPhase;
+	PhysicsClosestHit* hit;
+	b2Vec2 point;
+	int ignoreEntity;
+
+	float QueryClosestCallback(int proxyId, float maxDistance)
+	{
+		const b2FixtureProxy* proxy = (const b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		b2Fixture* fixture = proxy->fixture;
+		b2Body* body = fixture->GetBody();
+
+		if (fixture->IsSensor())
+			return maxDistance;
+
+		int entity = BodyToEntityId(body);
+
+		if (ignoreEntity != -1 && entity == ignoreEntity)
+			return maxDistance;
+
+		const b2Transform& transform = body->GetTransform();
+		b2Vec2 closest = b2Mul(transform, ClosestPointOnShape(fixture->GetShape(), proxy->childIndex, b2MulT(transform, point)));
+		float dist = b2Distance(point, closest);
+
+		if (dist >= maxDistance)
+			return maxDistance;
+
+		hit->hit      = true;
+		hit->entity   = entity;
+		hit->fixture  = fixture;
+		hit->distance = dist;
+		hit->point    = _fb(closest);
+
+		return dist;
+	}
+};
+
+// only records contacts, they are sent out by PhysicsWorld after the step
 struct ContactCallback : b2ContactListener
 {
-	PhysicsWorld* m_world;
+	r<PhysicsContactBuffer> m_buffer;
 
-	ContactCallback(PhysicsWorld* world) 
-		: m_world (world)
+	ContactCallback(r<PhysicsContactBuffer> buffer) 
+		: m_buffer (buffer)
 	{}
 
 	void BeginContact(b2Contact* contact) override 
 	{
-		Entity entityA = FixtureToEntity(contact->GetFixtureA());
-		Entity entityB = FixtureToEntity(contact->GetFixtureB());
+		b2Fixture* fixtureA = contact->GetFixtureA();
+		b2Fixture* fixtureB = contact->GetFixtureB();
+
+		b2WorldManifold manifold;
+		contact->GetWorldManifold(&manifold);
+
+		PhysicsContact info;
+		info.A          = FixtureToEntity(fixtureA);
+		info.B          = FixtureToEntity(fixtureB);
+		info.contact    = contact;
+		info.bodyA      = fixtureA->GetBody();
+		info.bodyB      = fixtureB->GetBody();
+		info.normal     = _fb(manifold.normal);
+		info.pointCount = contact->GetManifold()->pointCount;
+		info.impulse    = 0.f;
+
+		// sensors are how bodies with collision turned off are made
+		info.enabledA   = !fixtureA->IsSensor();
+		info.enabledB   = !fixtureB->IsSensor();
+
+		for (int i = 0; i < info.pointCount; i++)
+		{
+			info.points[i] = _fb(manifold.points[i]);
+		}
+
+		m_buffer->index[contact] = (int)m_buffer->contacts.size();
+		m_buffer->contacts.push_back(info);
+	}
+
+	void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse) override
+	{
+		if (m_buffer->contacts.size() == 0)
+			return;
 
-		if (!entityA.IsAlive() || !entityB.IsAlive()) return; // when an entity is deleted in collision / mid frame
+		auto itr = m_buffer->index.find(contact);
 
-		Rigidbody2D& bodyA = entityA.Get<Rigidbody2D>();
-		Rigidbody2D& bodyB = entityB.Get<Rigidbody2D>();
+		if (itr == m_buffer->index.end())
+			return;
 
-		if (bodyA.IsCollisionEnabled()) bodyA.OnCollision(CollisionInfo { entityA, entityB, contact, true });
-		if (bodyB.IsCollisionEnabled()) bodyB.OnCollision(CollisionInfo { entityB, entityA, contact, false });
+		PhysicsContact& info = m_buffer->contacts[itr->second];
 
-		m_world->FireOnCollision(WorldCollisionInfo
+		for (int i = 0; i < impulse->count; i++)
 		{
-			entityA, entityB, contact
-		});
+			info.impulse = std::max(info.impulse, impulse->normalImpulses[i]);
+		}
 	}
 };
 
@@ -130,6 +331,9 @@ void ColliderAttachment::DnitFixture(Rigidbody2D& body)
 		return;
 	}
 
+	// destroys the fixture's contacts
+	body.m_poses->MarkRemoved(body.m_instance);
+
 	body.m_instance->DestroyFixture(m_fixture);
 	m_fixture = nullptr;
 }
@@ -432,6 +636,127 @@ b2PolygonShape& HullCollider::GetShape() const
 //	}
 //}
 
+//
+//	Poses
+//
+
+int PhysicsPoses::Alloc(b2Body* instance, int entityId)
+{
+	int proxy;
+
+	if (free.size() > 0)
+	{
+		proxy = free.back();
+		free.pop_back();
+	}
+
+	else
+	{
+		proxy = Count();
+
+		position       .emplace_back();
+		velocity       .emplace_back();
+		angle          .emplace_back();
+		angularVelocity.emplace_back();
+		body           .emplace_back();
+		entity         .emplace_back();
+		awake          .emplace_back();
+		dirty          .emplace_back();
+		lastPosition   .emplace_back();
+		lastAngle      .emplace_back();
+		lodInterval    .emplace_back();
+	}
+
+	position[proxy]        = _fb(instance->GetPosition());
+	velocity[proxy]        = _fb(instance->GetLinearVelocity());
+	angle[proxy]           = instance->GetAngle();
+	angularVelocity[proxy] = instance->GetAngularVelocity();
+	body[proxy]            = instance;
+	entity[proxy]          = entityId;
+	awake[proxy]           = instance->IsAwake();
+	dirty[proxy]           = 0;
+	lastPosition[proxy]    = position[proxy];
+	lastAngle[proxy]       = angle[proxy];
+	lodInterval[proxy]     = instance->GetSolveInterval();
+
+	return proxy;
+}
+
+void PhysicsPoses::Free(int proxy)
+{
+	if (dirty[proxy] != 0)
+	{
+		dirtyList.erase(std::find(dirtyList.begin(), dirtyList.end(), proxy));
+	}
+
+	MarkRemoved(body[proxy]);
+
+	position[proxy]        = vec2(0.f);
+	velocity[proxy]        = vec2(0.f);
+	angle[proxy]           = 0.f;
+	angularVelocity[proxy] = 0.f;
+	body[proxy]            = nullptr;
+	entity[proxy]          = -1;
+	awake[proxy]           = false;
+	dirty[proxy]           = 0;
+	lastPosition[proxy]    = vec2(0.f);
+	lastAngle[proxy]       = 0.f;
+	lodInterval[proxy]     = 1;
+
+	free.push_back(proxy);
+}
+
+void PhysicsPoses::MarkRemoved(b2Body* instance)
+{
+	if (dispatching && instance)
+		removed.push_back(instance);
+}
+
+bool PhysicsPoses::WasRemoved(b2Body* instance) const
+{
+	// almost always empty
+	return std::find(removed.begin(), removed.end(), instance) != removed.end();
+}
+
+void PhysicsPoses::Mark(int proxy, Dirty flag)
+{
+	if (dirty[proxy] == 0)
+	{
+		dirtyList.push_back(proxy);
+	}
+
+	dirty[proxy] |= flag;
+}
+
+int PhysicsPoses::Count() const
+{
+	return (int)body.size();
+}
+
+// bodies outside of a world read from here, so reads don't need to check
+static const r<PhysicsPoses>& physics_empty_poses()
+{
+	static r<PhysicsPoses> empty = []()
+	{
+		r<PhysicsPoses> poses = mkr<PhysicsPoses>();
+		poses->position       .push_back(vec2(0.f));
+		poses->velocity       .push_back(vec2(0.f));
+		poses->angle          .push_back(0.f);
+		poses->angularVelocity.push_back(0.f);
+		poses->body           .push_back(nullptr);
+		poses->entity         .push_back(-1);
+		poses->awake          .push_back(false);
+		poses->dirty          .push_back(0);
+		poses->lastPosition   .push_back(vec2(0.f));
+		poses->lastAngle      .push_back(0.f);
+		poses->lodInterval    .push_back(1);
+
+		return poses;
+	}();
+
+	return empty;
+}
+
 //
 //  Rigidbody2D
 //
@@ -441,6 +766,8 @@ Rigidbody2D::Rigidbody2D()
 	, m_density          (1.f)
 	, m_collisionEnabled (true)
 	, m_world            (nullptr)
+	, m_poses            (physics_empty_poses())
+	, m_proxy            (0)
 {}
 
 Rigidbody2D::~Rigidbody2D() {
@@ -448,6 +775,10 @@ Rigidbody2D::~Rigidbody2D() {
 }
 
 Rigidbody2D::Rigidbody2D(const Rigidbody2D& other)
+	: m_instance         (nullptr)
+	, m_world            (nullptr)
+	, m_poses            (physics_empty_poses())
+	, m_proxy            (0)
 {
 	copy_into(other);
 }
@@ -459,6 +790,10 @@ Rigidbody2D& Rigidbody2D::operator=(const Rigidbody2D& other)
 }
 
 Rigidbody2D::Rigidbody2D(Rigidbody2D&& move) noexcept 
+	: m_instance         (nullptr)
+	, m_world            (nullptr)
+	, m_poses            (physics_empty_poses())
+	, m_proxy            (0)
 {
 	move_into(std::forward<Rigidbody2D>(move));
 }
@@ -480,20 +815,30 @@ void Rigidbody2D::move_into(Rigidbody2D&& other)
 {
 	m_instance = std::move(other.m_instance);
 	m_world = std::move(other.m_world);
+	m_poses = std::move(other.m_poses);
+	m_proxy = std::move(other.m_proxy);
 	m_preinit = std::move(other.m_preinit);
 	m_density = std::move(other.m_density);
 	m_collisionEnabled = std::move(other.m_collisionEnabled);
 	m_last = std::move(other.m_last);
 	m_colliders = std::move(other.m_colliders);
 	m_aabb = std::move(other.m_aabb);
+	OnCollision = std::move(other.OnCollision);
+
+	// contacts find the component through the body
+	if (m_instance)
+		m_instance->GetUserData().rigidbody = this;
 
 	other.m_instance = nullptr;
 	other.m_world = nullptr;
+	other.m_poses = physics_empty_poses();
+	other.m_proxy = 0;
 }
 
 void Rigidbody2D::RemoveFromWorld()
 {
 	ClearColliders();
+	DetachPoses();
 
 	if (m_world && m_instance)
 		m_world->DestroyBody(m_instance);
@@ -529,10 +874,10 @@ void Rigidbody2D::ApplyForce(vec2 force)                        { if (m_instance
 void Rigidbody2D::ApplyForce(vec2 force, vec2 offsetFromCenter) { if (m_instance) m_instance->ApplyForce(_tb(force), _tb(GetPosition() + offsetFromCenter), true); }
 void Rigidbody2D::ApplyTorque(float force)                      { if (m_instance) m_instance->ApplyTorque(force, true); }
 	
-vec2  Rigidbody2D::GetPosition()        const { return !m_instance ? vec2(0.f) : _fb(m_instance->GetPosition()); }
-vec2  Rigidbody2D::GetVelocity()        const { return !m_instance ? vec2(0.f) : _fb(m_instance->GetLinearVelocity()); }
-float Rigidbody2D::GetAngle()           const { return !m_instance ? 0.f : m_instance->GetAngle(); }
-float Rigidbody2D::GetAngularVelocity() const { return !m_instance ? 0.f : m_instance->GetAngularVelocity(); }
+vec2  Rigidbody2D::GetPosition()        const { return m_poses->position       [m_proxy]; }
+vec2  Rigidbody2D::GetVelocity()        const { return m_poses->velocity       [m_proxy]; }
+float Rigidbody2D::GetAngle()           const { return m_poses->angle          [m_proxy]; }
+float Rigidbody2D::GetAngularVelocity() const { return m_poses->angularVelocity[m_proxy]; }
 float Rigidbody2D::GetDamping()         const { return !m_instance ? 0.f : m_instance->GetLinearDamping(); }
 float Rigidbody2D::GetAngularDamping()  const { return !m_instance ? 0.f : m_instance->GetAngularDamping(); }
 bool  Rigidbody2D::IsRotationFixed()    const { return !m_instance ? false : m_instance->IsFixedRotation(); }
@@ -547,10 +892,12 @@ Rigidbody2D::Type Rigidbody2D::GetType() const
 	return !m_instance ? Type::Static : (Rigidbody2D::Type)m_instance->GetType();
 }
 
-Rigidbody2D& Rigidbody2D::SetPosition       (vec2  pos)      { if (m_instance) m_instance->SetTransform      (_tb(pos), m_instance->GetAngle()); return *this; }
-Rigidbody2D& Rigidbody2D::SetVelocity       (vec2  vel)      { if (m_instance) m_instance->SetLinearVelocity (_tb(vel));                         return *this; }
-Rigidbody2D& Rigidbody2D::SetAngle          (float angle)    { if (m_instance) m_instance->SetTransform      (m_instance->GetPosition(), angle); return *this; }
-Rigidbody2D& Rigidbody2D::SetAngularVelocity(float avel)     { if (m_instance) m_instance->SetAngularVelocity(avel);                             return *this; }
+// pose writes are applied to the body by PhysicsWorld before the next step
+
+Rigidbody2D& Rigidbody2D::SetPosition       (vec2  pos)      { if (m_instance) { m_poses->position       [m_proxy] = pos;   m_poses->Mark(m_proxy, PhysicsPoses::dTransform); }       return *this; }
+Rigidbody2D& Rigidbody2D::SetVelocity       (vec2  vel)      { if (m_instance) { m_poses->velocity       [m_proxy] = vel;   m_poses->Mark(m_proxy, PhysicsPoses::dVelocity); }        return *this; }
+Rigidbody2D& Rigidbody2D::SetAngle          (float angle)    { if (m_instance) { m_poses->angle          [m_proxy] = angle; m_poses->Mark(m_proxy, PhysicsPoses::dTransform); }       return *this; }
+Rigidbody2D& Rigidbody2D::SetAngularVelocity(float avel)     { if (m_instance) { m_poses->angularVelocity[m_proxy] = avel;  m_poses->Mark(m_proxy, PhysicsPoses::dAngularVelocity); } return *this; }
 Rigidbody2D& Rigidbody2D::SetDamping        (float damping)  { if (m_instance) m_instance->SetLinearDamping  (damping);                          return *this; }
 Rigidbody2D& Rigidbody2D::SetAngularDamping (float adamping) { if (m_instance) m_instance->SetAngularDamping (adamping);                         return *this; }
 Rigidbody2D& Rigidbody2D::SetRotationFixed  (bool  isFixed)  { if (m_instance) m_instance->SetFixedRotation  (isFixed);                          return *this; }
@@ -578,6 +925,7 @@ Rigidbody2D& Rigidbody2D::SetType(Type type)
 Rigidbody2D& Rigidbody2D::SetEntity(int id)
 {
 	m_instance->GetUserData().v2EntityId = id;
+	m_poses->entity[m_proxy] = id;
 	return *this;
 }
 
@@ -679,10 +1027,10 @@ b2BodyDef Rigidbody2D::GetBodyDef() const
 	}
 
 	def.type            = m_instance->GetType();
-	def.position        = m_instance->GetPosition();
-	def.angle           = m_instance->GetAngle();
-	def.linearVelocity  = m_instance->GetLinearVelocity();
-	def.angularVelocity = m_instance->GetAngularVelocity();
+	def.position        = _tb(GetPosition());
+	def.angle           = GetAngle();
+	def.linearVelocity  = _tb(GetVelocity());
+	def.angularVelocity = GetAngularVelocity();
 	def.linearDamping   = m_instance->GetLinearDamping();
 	def.angularDamping  = m_instance->GetAngularDamping();
 	def.allowSleep      = m_instance->IsSleepingAllowed();
@@ -711,6 +1059,47 @@ b2Fixture* Rigidbody2D::GetColList() const
 	return m_instance ? m_instance->GetFixtureList() : nullptr;
 }
 
+int Rigidbody2D::GetProxy() const
+{
+	return m_proxy;
+}
+
+vec2 Rigidbody2D::GetInterpolatedPosition() const
+{
+	return lerp(m_poses->lastPosition[m_proxy], m_poses->position[m_proxy], m_poses->alpha);
+}
+
+float Rigidbody2D::GetInterpolatedAngle() const
+{
+	// box2d doesn't wrap angles, so this doesn't need to take the short way around
+	return lerpf(m_poses->lastAngle[m_proxy], m_poses->angle[m_proxy], m_poses->alpha);
+}
+
+void Rigidbody2D::InterpolateTransform(Transform2D& transform) const
+{
+	transform.position = GetInterpolatedPosition();
+	transform.rotation = GetInterpolatedAngle();
+}
+
+void Rigidbody2D::AttachPoses(const r<PhysicsPoses>& poses, int entity)
+{
+	DetachPoses();
+
+	m_poses = poses;
+	m_proxy = poses->Alloc(m_instance, entity);
+}
+
+void Rigidbody2D::DetachPoses()
+{
+	if (m_poses != physics_empty_poses())
+	{
+		m_poses->Free(m_proxy);
+	}
+
+	m_poses = physics_empty_poses();
+	m_proxy = 0;
+}
+
 bool   PointQueryResult::HasResult()     const { return results.size() > 0; }
 Entity PointQueryResult::FirstEntity()   const { return FirstResult().entity; }
 float  PointQueryResult::FirstDistance() const { return FirstResult().distance; }
@@ -725,7 +1114,13 @@ const PointQueryResult::Result& PointQueryResult::FirstResult() const { return r
 const   RayQueryResult::Result&   RayQueryResult::FirstResult() const { return results.at(0); }
 
 PhysicsWorld::PhysicsWorld()
-	: m_world (nullptr)
+	: m_world              (nullptr)
+	, m_threads            (nullptr)
+	, m_solveIslands       (false)
+	, m_velocityIterations (6)
+	, m_positionIterations (2)
+	, m_lodApplied         (false)
+	, m_stats              ()
 {
 	ReallocWorld();
 }
@@ -738,8 +1133,15 @@ PhysicsWorld::~PhysicsWorld()
 void PhysicsWorld::ReallocWorld()
 {
 	delete m_world;
+	m_contacts = mkr<PhysicsContactBuffer>();
+
 	m_world = new b2World(b2Vec2(0, 0));
-	m_world->SetContactListener(new ContactCallback(this));
+	m_world->SetContactListener(new ContactCallback(m_contacts));
+
+	SetThreadPool(m_threads, m_solveIslands);
+
+	// bodies of the old world keep the old poses
+	m_poses = mkr<PhysicsPoses>();
 }
 
 void PhysicsWorld::Add(EntityWith<Rigidbody2D> e)
@@ -763,6 +1165,9 @@ void PhysicsWorld::Add(EntityWith<Rigidbody2D> e)
 	b2BodyUserData& data = body.m_instance->GetUserData();
 	data.entityId     = e.Id();
 	data.entityOwning = e.Owning();
+	data.rigidbody    = &body;
+
+	body.AttachPoses(m_poses, e.Id());
 
 	// Set position to where transform is if entity has one
 
@@ -773,6 +1178,7 @@ void PhysicsWorld::Add(EntityWith<Rigidbody2D> e)
 void PhysicsWorld::Remove(Entity& e)
 {
 	Rigidbody2D& body = e.Get<Rigidbody2D>();
+	body.DetachPoses();
 	m_world->DestroyBody(body.m_instance);
 	body.m_instance = nullptr;
 }
@@ -793,12 +1199,481 @@ void PhysicsWorld::RegisterBody(Rigidbody2D* body)
 	def.type = b2_dynamicBody;
 
 	body->m_instance = m_world->CreateBody(&def);
+	body->m_instance->GetUserData().rigidbody = body;
 	body->m_world = m_world;
+
+	body->AttachPoses(m_poses, -1);
 }
 
 void PhysicsWorld::Tick(float dt)
 {
-	m_world->Step(dt, 6, 2);
+	b2Timer total;
+	b2Timer timer;
+
+	Flush();
+	m_stats.flush = timer.GetMilliseconds();
+
+	timer.Reset();
+	UpdateLod();
+	m_stats.lod = timer.GetMilliseconds();
+
+	// after the flush, so bodies which were moved by hand don't slide from where they were
+	m_poses->lastPosition = m_poses->position;
+	m_poses->lastAngle    = m_poses->angle;
+
+	m_world->Step(dt, m_velocityIterations, m_positionIterations);
+
+	timer.Reset();
+	SyncPoses();
+	m_stats.sync = timer.GetMilliseconds();
+
+	timer.Reset();
+	DispatchContacts();
+	m_stats.dispatch = timer.GetMilliseconds();
+
+	UpdateStats();
+	m_stats.total = total.GetMilliseconds();
+}
+
+void PhysicsWorld::UpdateLod()
+{
+	PhysicsPoses& poses = *m_poses;
+
+	bool enabled = m_lodLevels.size() > 0 && m_lodFocus.size() > 0;
+
+	if (!enabled && !m_lodApplied)
+		return;
+
+	// the index of the step about to run, box2d solves a lone body when step + phase is a multiple of its interval
+	uint32 step = m_world->GetStepIndex();
+	bool waiting = false;
+
+	for (int i = 0; i < poses.Count(); i++)
+	{
+		// sleeping bodies aren't solved, they are given an interval once they wake
+		if (!poses.body[i] || (enabled && !poses.awake[i]))
+			continue;
+
+		int interval = 1;
+
+		if (enabled)
+		{
+			float closest = FLT_MAX;
+
+			for (const vec2& focus : m_lodFocus)
+			{
+				vec2 delta = poses.position[i] - focus;
+				closest = std::min(closest, delta.x * delta.x + delta.y * delta.y);
+			}
+
+			for (const PhysicsLodLevel& level : m_lodLevels)
+			{
+				if (closest >= level.distance * level.distance)
+				{
+					interval = std::max(level.interval, 1);
+				}
+			}
+		}
+
+		if (poses.lodInterval[i] != interval)
+		{
+			// a solve moves a body interval steps ahead, so switching in the middle of one would
+			// leave it ahead or behind the world for good. wait for a step both intervals land on
+
+			uint32 phase = step + (uint32)poses.body[i]->GetSolvePhase();
+			uint32 current = (uint32)poses.body[i]->GetSolveInterval();
+
+			if (phase % current != 0 || phase % (uint32)interval != 0)
+			{
+				waiting = true;
+				continue;
+			}
+
+			poses.lodInterval[i] = interval;
+			poses.body[i]->SetSolveInterval(interval);
+		}
+	}
+
+	m_lodApplied = enabled || waiting;
+}
+
+void PhysicsWorld::UpdateStats()
+{
+	const PhysicsPoses& poses = *m_poses;
+	const b2Profile& profile = m_world->GetProfile();
+
+	int awake = 0;
+
+	for (u8 isAwake : poses.awake)
+	{
+		awake += isAwake;
+	}
+
+	m_stats.bodies         = poses.Count() - (int)poses.free.size();
+	m_stats.awakeBodies    = awake;
+	m_stats.contacts       = m_world->GetContactCount();
+	m_stats.islands        = profile.islandCount;
+	m_stats.skippedIslands = profile.skippedIslandCount;
+	m_stats.collide        = profile.collide;
+	m_stats.solve          = profile.solve;
+	m_stats.solveTOI       = profile.solveTOI;
+	m_stats.broadphase     = profile.broadphase;
+}
+
+void PhysicsWorld::SetIterations(int velocityIterations, int positionIterations)
+{
+	m_velocityIterations = std::max(velocityIterations, 1);
+	m_positionIterations = std::max(positionIterations, 1);
+}
+
+void PhysicsWorld::SetLodLevels(const std::vector<PhysicsLodLevel>& levels)
+{
+	m_lodLevels = levels;
+
+	std::sort(m_lodLevels.begin(), m_lodLevels.end(), [](const PhysicsLodLevel& a, const PhysicsLodLevel& b)
+	{
+		return a.distance < b.distance;
+	});
+}
+
+void PhysicsWorld::SetLodFocus(const std::vector<vec2>& points)
+{
+	m_lodFocus = points;
+}
+
+const PhysicsStats& PhysicsWorld::GetStats() const
+{
+	return m_stats;
+}
+
+void PhysicsWorld::Flush()
+{
+	PhysicsPoses& poses = *m_poses;
+
+	// SetTransform moves the body's proxies in the broadphase, so this stays on one thread
+
+	for (int proxy : poses.dirtyList)
+	{
+		b2Body* body = poses.body[proxy];
+		u8 dirty = poses.dirty[proxy];
+
+		if (dirty & PhysicsPoses::dTransform)       body->SetTransform(_tb(poses.position[proxy]), poses.angle[proxy]);
+		if (dirty & PhysicsPoses::dVelocity)        body->SetLinearVelocity(_tb(poses.velocity[proxy]));
+		if (dirty & PhysicsPoses::dAngularVelocity) body->SetAngularVelocity(poses.angularVelocity[proxy]);
+
+		poses.awake[proxy] |= body->IsAwake();
+		poses.dirty[proxy] = 0;
+	}
+
+	poses.dirtyList.clear();
+}
+
+const PhysicsPoses& PhysicsWorld::GetPoses() const
+{
+	return *m_poses;
+}
+
+void PhysicsWorld::Snapshot(PhysicsSnapshot& snapshot)
+{
+	Flush();
+
+	int size = m_world->SaveState(snapshot.bytes.data(), (int)snapshot.bytes.size());
+
+	if (size > (int)snapshot.bytes.size())
+	{
+		snapshot.bytes.resize(size);
+		m_world->SaveState(snapshot.bytes.data(), size);
+	}
+
+	snapshot.bytes.resize(size);
+}
+
+bool PhysicsWorld::Restore(const PhysicsSnapshot& snapshot)
+{
+	// box2d sizes are ints, and anything bigger can't have come from SaveState
+	bool fits = snapshot.bytes.size() <= (size_t)INT_MAX;
+
+	if (!fits || !m_world->LoadState(snapshot.bytes.data(), (int)snapshot.bytes.size()))
+	{
+		log_physics("w~Failed to restore snapshot: The bodies in the world are different or the snapshot isn't valid");
+		return false;
+	}
+
+	PhysicsPoses& poses = *m_poses;
+
+	for (int proxy : poses.dirtyList)
+	{
+		poses.dirty[proxy] = 0;
+	}
+
+	poses.dirtyList.clear();
+
+	// every pose could have changed, not only the awake ones
+	for (int i = 0; i < poses.Count(); i++)
+	{
+		if (!poses.body[i])
+			continue;
+
+		poses.awake[i] = 1;
+		poses.lodInterval[i] = poses.body[i]->GetSolveInterval();
+	}
+
+	SyncPoses();
+
+	poses.lastPosition = poses.position;
+	poses.lastAngle    = poses.angle;
+
+	m_contacts->contacts.clear();
+	m_contacts->index.clear();
+
+	return true;
+}
+
+void PhysicsWorld::DispatchContacts()
+{
+	PhysicsPoses& poses = *m_poses;
+
+	// swap out in case a function steps the world again
+	std::vector<PhysicsContact> contacts;
+	std::swap(contacts, m_contacts->contacts);
+	m_contacts->index.clear();
+
+	bool nested = poses.dispatching;
+	poses.dispatching = true;
+
+	// a function can delete an entity, or remove a body or a collider from one which is still alive,
+	// so this is checked before anything in the contact is read from box2d
+	auto removed = [&poses](const PhysicsContact& contact)
+	{
+		return !contact.A.IsAlive() || !contact.B.IsAlive()
+			|| poses.WasRemoved(contact.bodyA) || poses.WasRemoved(contact.bodyB);
+	};
+
+	for (const PhysicsContact& contact : contacts)
+	{
+		if (removed(contact))
+			continue;
+
+		// the bodies point to their components, so the entities aren't looked up
+		// B is read after A's functions, they could move its component
+
+		Rigidbody2D* bodyA = (Rigidbody2D*)contact.bodyA->GetUserData().rigidbody;
+
+		if (contact.enabledA && bodyA) bodyA->OnCollision(CollisionInfo { contact.A, contact.B, contact.contact, true,  &contact });
+
+		if (removed(contact))
+			continue;
+
+		Rigidbody2D* bodyB = (Rigidbody2D*)contact.bodyB->GetUserData().rigidbody;
+
+		if (contact.enabledB && bodyB) bodyB->OnCollision(CollisionInfo { contact.B, contact.A, contact.contact, false, &contact });
+
+		if (removed(contact))
+			continue;
+
+		if (contact.enabledA && contact.enabledB)
+		{
+			FireOnCollision(WorldCollisionInfo { contact.A, contact.B, contact.contact, &contact });
+		}
+	}
+
+	if (!nested)
+	{
+		poses.dispatching = false;
+		poses.removed.clear();
+	}
+
+	// keep the memory for the next step
+	contacts.clear();
+
+	if (m_contacts->contacts.size() == 0)
+	{
+		std::swap(contacts, m_contacts->contacts);
+	}
+}
+
+void PhysicsWorld::RemoveOnCollision(const OnWorldCollisionFunc& func)
+{
+	for (auto& [key, pair] : m_onCollision)
+	{
+		auto& functions = pair.functions.functions;
+
+		if (std::find(functions.begin(), functions.end(), func) != functions.end())
+		{
+			pair.functions -= func;
+			break;
+		}
+	}
+}
+
+void PhysicsWorld::FireOnCollision(const WorldCollisionInfo& info)
+{
+	int count = (int)m_collisionTypes.size();
+
+	if (count == 0)
+		return;
+
+	// each type is checked once per entity, not once per pair it is in
+
+	m_collisionHas.resize(count * 2);
+	u8* hasA = m_collisionHas.data();
+	u8* hasB = m_collisionHas.data() + count;
+
+	for (int i = 0; i < count; i++)
+	{
+		hasA[i] = m_collisionTypes[i].has(info.A);
+		hasB[i] = m_collisionTypes[i].has(info.B);
+	}
+
+	// only the pairs of the types A has can match. they are collected before calling anything
+	// because the functions can add pairs, and swapped out in case a function steps the world again
+
+	std::vector<CollisionPair*> fired;
+	std::swap(fired, m_collisionFired);
+
+	for (int i = 0; i < count; i++)
+	{
+		if (!hasA[i])
+			continue;
+
+		for (CollisionPair* pair : m_collisionTypes[i].pairs)
+		{
+			// A has both types, so this pair was seen through its first
+			if (i == pair->b && pair->a != pair->b && hasA[pair->a])
+				continue;
+
+			bool match = (hasA[pair->a] && hasB[pair->b])
+					  || (hasA[pair->b] && hasB[pair->a]);
+
+			if (match && pair->functions.functions.size() > 0)
+				fired.push_back(pair);
+		}
+	}
+
+	for (CollisionPair* pair : fired)
+	{
+		pair->functions(info);
+	}
+
+	// keep the memory for the next contact
+	fired.clear();
+
+	if (m_collisionFired.size() == 0)
+	{
+		std::swap(fired, m_collisionFired);
+	}
+}
+
+int PhysicsWorld::CollisionTypeIndex(meta::id_type id, bool(*has)(const Entity&))
+{
+	for (int i = 0; i < (int)m_collisionTypes.size(); i++)
+	{
+		if (m_collisionTypes[i].id == id)
+			return i;
+	}
+
+	m_collisionTypes.push_back(CollisionType { id, has, {} });
+	return (int)m_collisionTypes.size() - 1;
+}
+
+u64 PhysicsWorld::PairKey(meta::id_type a, meta::id_type b)
+{
+	if (a > b) std::swap(a, b);
+	return ((u64)a << 32) | (u64)(u32)b;
+}
+
+void PhysicsWorld::SetInterpolationAlpha(float alpha)
+{
+	m_poses->alpha = clamp(alpha, 0.f, 1.f);
+}
+
+float PhysicsWorld::GetInterpolationAlpha() const
+{
+	return m_poses->alpha;
+}
+
+// box2d solves islands through this. Each worker takes chunks of islands until there are none left,
+// which doesn't change the result as islands don't depend on each other
+static void physics_parallel_islands(b2TaskCallback* task, int32 itemCount, int32 minRange, void* taskContext, void* userContext)
+{
+	thread_pool* pool = (thread_pool*)userContext;
+	std::atomic<int> next = 0;
+
+	int chunk = std::max(minRange, 1);
+	int workers = std::min(pool->size(), (itemCount + chunk - 1) / chunk);
+
+	for (int worker = 0; worker < workers; worker++)
+	{
+		pool->thread([&next, task, itemCount, chunk, taskContext, worker]()
+		{
+			for (int begin = next.fetch_add(chunk); begin < itemCount; begin = next.fetch_add(chunk))
+			{
+				task(begin, std::min(begin + chunk, itemCount), worker, taskContext);
+			}
+		});
+	}
+
+	pool->wait();
+}
+
+void PhysicsWorld::SetThreadPool(thread_pool* pool, bool solveIslands)
+{
+	m_threads = pool;
+	m_solveIslands = solveIslands;
+
+	if (pool && solveIslands) m_world->SetTaskSystem(physics_parallel_islands, pool->size(), pool);
+	else                      m_world->SetTaskSystem(nullptr, 0, nullptr);
+}
+
+// runs work(begin, end) over count items, split into chunks across the pool if there is one
+static void physics_parallel_for(thread_pool* pool, int count, int chunk, const std::function<void(int, int)>& work)
+{
+	if (!pool || count <= chunk)
+	{
+		work(0, count);
+		return;
+	}
+
+	for (int begin = 0; begin < count; begin += chunk)
+	{
+		int end = std::min(begin + chunk, count);
+		pool->thread([&work, begin, end]() { work(begin, end); });
+	}
+
+	pool->wait();
+}
+
+// each range only writes its own slots, so they can be copied in parallel
+static void physics_sync_poses(PhysicsPoses& poses, int begin, int end)
+{
+	for (int i = begin; i < end; i++)
+	{
+		b2Body* body = poses.body[i];
+
+		if (!body)
+			continue;
+
+		bool awake = body->IsAwake();
+
+		if (!awake && !poses.awake[i])
+			continue;
+
+		poses.position[i]        = _fb(body->GetPosition());
+		poses.velocity[i]        = _fb(body->GetLinearVelocity());
+		poses.angle[i]           = body->GetAngle();
+		poses.angularVelocity[i] = body->GetAngularVelocity();
+		poses.awake[i]           = awake;
+	}
+}
+
+void PhysicsWorld::SyncPoses()
+{
+	PhysicsPoses& poses = *m_poses;
+
+	physics_parallel_for(m_threads, poses.Count(), 2048, [&poses](int begin, int end)
+	{
+		physics_sync_poses(poses, begin, end);
+	});
 }
 
 RayQueryResult PhysicsWorld::QueryRay(vec2 point, vec2 direction, float distance) const
@@ -841,15 +1716,136 @@ PointQueryResult PhysicsWorld::QueryPoint(vec2 point, float radius) const
 	return query.result;
 }
 
+void PhysicsWorld::QueryRays(const ArrayView<PhysicsRay>& rays, ArrayView<PhysicsRayHit> hits, PhysicsQueryMode mode) const
+{
+	assert(hits.size() >= rays.size() && "Not enough room for the hits");
+
+	physics_parallel_for(m_threads, (int)rays.size(), 256, [&](int begin, int end)
+	{
+		BatchRayCallback query;
+		query.mode = mode;
+
+		for (int i = begin; i < end; i++)
+		{
+			const PhysicsRay& ray = rays[i];
+
+			hits[i] = {};
+			hits[i].entity = -1;
+
+			// box2d asserts on zero length rays
+			if (ray.point == ray.target)
+				continue;
+
+			query.hit = &hits[i];
+			query.length = distance(ray.target, ray.point);
+
+			m_world->RayCast(&query, _tb(ray.point), _tb(ray.target));
+		}
+	});
+}
+
+void PhysicsWorld::QueryPoints(const ArrayView<PhysicsPointQuery>& queries, ArrayView<PhysicsPointHit> hits, PhysicsQueryMode mode) const
+{
+	assert(hits.size() >= queries.size() && "Not enough room for the hits");
+
+	physics_parallel_for(m_threads, (int)queries.size(), 256, [&](int begin, int end)
+	{
+		BatchPointCallback query;
+		query.mode = mode;
+
+		for (int i = begin; i < end; i++)
+		{
+			const PhysicsPointQuery& point = queries[i];
+
+			hits[i] = {};
+			hits[i].entity = -1;
+
+			query.hit = &hits[i];
+			query.point = point.point;
+
+			b2AABB aabb;
+			aabb.lowerBound = b2Vec2(point.point.x - point.radius, point.point.y - point.radius);
+			aabb.upperBound = b2Vec2(point.point.x + point.radius, point.point.y + point.radius);
+
+			m_world->QueryAABB(&query, aabb);
+		}
+	});
+}
+
+PhysicsClosestHit PhysicsWorld::QueryClosest(vec2 point, float maxDistance, int ignoreEntity) const
+{
+	PhysicsClosestQuery query = { point, maxDistance, ignoreEntity };
+	PhysicsClosestHit hit;
+
+	QueryClosest(ArrayView<PhysicsClosestQuery>(&query, &query + 1), ArrayView<PhysicsClosestHit>(&hit, &hit + 1));
+
+	return hit;
+}
+
+void PhysicsWorld::QueryClosest(const ArrayView<PhysicsClosestQuery>& queries, ArrayView<PhysicsClosestHit> hits) const
+{
+	assert(hits.size() >= queries.size() && "Not enough room for the hits");
+
+	const b2BroadPhase& broadPhase = m_world->GetContactManager().m_broadPhase;
+
+	physics_parallel_for(m_threads, (int)queries.size(), 256, [&](int begin, int end)
+	{
+		ClosestCallback query;
+		query.broadPhase = &broadPhase;
+
+		for (int i = begin; i < end; i++)
+		{
+			const PhysicsClosestQuery& closest = queries[i];
+
+			hits[i] = {};
+			hits[i].entity = -1;
+
+			query.hit = &hits[i];
+			query.point = _tb(closest.point);
+			query.ignoreEntity = closest.ignoreEntity;
+
+			broadPhase.QueryClosest(&query, query.point, closest.maxDistance);
+		}
+	});
+}
+
 PhysicsWorld::PhysicsWorld(PhysicsWorld&& move) noexcept
-	: m_world (move.m_world)
+	: m_world              (move.m_world)
+	, m_onCollision        (std::move(move.m_onCollision))
+	, m_collisionTypes     (std::move(move.m_collisionTypes))
+	, m_contacts           (move.m_contacts)
+	, m_poses              (move.m_poses)
+	, m_threads            (move.m_threads)
+	, m_solveIslands       (move.m_solveIslands)
+	, m_velocityIterations (move.m_velocityIterations)
+	, m_positionIterations (move.m_positionIterations)
+	, m_lodLevels          (std::move(move.m_lodLevels))
+	, m_lodFocus           (std::move(move.m_lodFocus))
+	, m_lodApplied         (move.m_lodApplied)
+	, m_stats              (move.m_stats)
 {
 	move.m_world = nullptr;
+	move.m_contacts = nullptr;
+	move.m_poses = nullptr;
 }
 
 PhysicsWorld& PhysicsWorld::operator=(PhysicsWorld&& move) noexcept
 {
 	m_world = move.m_world;
+	m_onCollision = std::move(move.m_onCollision);
+	m_collisionTypes = std::move(move.m_collisionTypes);
+	m_contacts = move.m_contacts;
+	m_poses = move.m_poses;
+	m_threads = move.m_threads;
+	m_solveIslands = move.m_solveIslands;
+	m_velocityIterations = move.m_velocityIterations;
+	m_positionIterations = move.m_positionIterations;
+	m_lodLevels = std::move(move.m_lodLevels);
+	m_lodFocus = std::move(move.m_lodFocus);
+	m_lodApplied = move.m_lodApplied;
+	m_stats = move.m_stats;
 	move.m_world = nullptr;
+	move.m_contacts = nullptr;
+	move.m_poses = nullptr;
 	return *this;
 }
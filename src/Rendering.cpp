@@ -2,16 +2,82 @@
 #include "Log.h"
 
 #include "util/error_check.h" // gives gl
+#include "util/gl_state.h"
+#include "util/shader_cache.h"
 #include "io/ImageFromDisk.h"
+#include "io/CookedTexture.h"
+
+#include "glm/mat4x4.hpp"
 
 #include <string.h>
 
+void DirtyRegions::Add(int begin, int end)
+{
+	Add(begin, 0, end, 1);
+}
+
+void DirtyRegions::Add(int minX, int minY, int maxX, int maxY)
+{
+	if (minX >= maxX || minY >= maxY)
+		return;
+
+	DirtyRegion add = { minX, minY, maxX, maxY };
+
+	// merging can make the region touch ones it didn't before, so keep going until nothing merges
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+
+		for (int i = 0; i < (int)regions.size(); i++)
+		{
+			DirtyRegion& region = regions[i];
+
+			bool touches = region.minX <= add.maxX && add.minX <= region.maxX
+			            && region.minY <= add.maxY && add.minY <= region.maxY;
+
+			if (touches)
+			{
+				add.minX = min(add.minX, region.minX);
+				add.minY = min(add.minY, region.minY);
+				add.maxX = max(add.maxX, region.maxX);
+				add.maxY = max(add.maxY, region.maxY);
+
+				regions.erase(regions.begin() + i);
+				merged = true;
+				break;
+			}
+		}
+	}
+
+	if (regions.size() == DIRTY_MAX_REGIONS)
+	{
+		for (const DirtyRegion& region : regions)
+		{
+			add.minX = min(add.minX, region.minX);
+			add.minY = min(add.minY, region.minY);
+			add.maxX = max(add.maxX, region.maxX);
+			add.maxY = max(add.maxY, region.maxY);
+		}
+
+		regions.clear();
+	}
+
+	regions.push_back(add);
+}
+
+void DirtyRegions::Clear()
+{
+	regions.clear();
+}
+
 IDeviceObject::IDeviceObject(
 	bool isStatic,
 	DeviceObjectType type
 )
 	: m_static   (isStatic)
 	, m_outdated (true)
+	, m_partial  (false)
 	, m_type     (type)
 {}
 
@@ -45,6 +111,7 @@ void IDeviceObject::SendToDevice()
 	}
 
 	m_outdated = false;
+	m_partial = false;
 }
 
 void IDeviceObject::SendToHost()
@@ -73,6 +140,22 @@ bool IDeviceObject::Outdated() const
 void IDeviceObject::MarkForUpdate()
 {
 	m_outdated = true;
+	m_partial = false;
+}
+
+void IDeviceObject::MarkForPartialUpdate()
+{
+	// if the whole object is already outdated, stay that way
+	if (!m_outdated)
+	{
+		m_outdated = true;
+		m_partial = true;
+	}
+}
+
+bool IDeviceObject::PartialUpdate() const
+{
+	return m_outdated && m_partial;
 }
 
 DeviceObjectType IDeviceObject::Type() const
@@ -89,6 +172,7 @@ void IDeviceObject::copy_base(const IDeviceObject* copy)
 {
 	m_static   = copy->m_static;
 	m_outdated = copy->m_outdated; // this might want to always be true when copying, move should keep it the same
+	m_partial  = copy->m_partial;
 }
 
 int             Texture::Width()           const { return m_width; } 
@@ -109,7 +193,7 @@ Texture& Texture::SetFilter(Filter filter)
 
 	if (OnDevice())
 	{
-		gl(glBindTexture(GL_TEXTURE_2D, m_device));
+		gl_state_bind_texture(GL_TEXTURE_2D, m_device);
 		_SetDeviceFilter();
 	}
 
@@ -123,7 +207,7 @@ Color& Texture::At(int index32)
 {
 	assert_on_host();
 	assert_valid_index(index32);
-	MarkForUpdate();
+	MarkRegionForUpdate(index32 % m_width, index32 / m_width, 1, 1);
 	return *(Color*)(Pixels() + Index(index32));
 }
 
@@ -161,22 +245,42 @@ void Texture::ClearHost(Color color)
 	MarkForUpdate();
 }
 
+void Texture::MarkRegionForUpdate(int x, int y, int width, int height)
+{
+	m_dirty.Add(max(x, 0), max(y, 0), min(x + width, m_width), min(y + height, m_height));
+	MarkForPartialUpdate();
+}
+
 void Texture::Resize(int width, int height)
 {
 	assert_not_static();
 
 	if (m_width == width && m_height == height) return;
 
+	int oldSize = BufferSize();
+
 	m_width = width;
 	m_height = height;
 
-	if (OnHost())
+	// the mapping can't grow, so take a copy of it
+	if (m_cooked)
+	{
+		void* newMemory = malloc(BufferSize());
+		assert(newMemory && "failed to resize texture");
+		memcpy(newMemory, m_host, min(oldSize, BufferSize()));
+		m_host = (u8*)newMemory;
+		m_cooked = nullptr;
+	}
+
+	else if (OnHost())
 	{
 		void* newMemory = realloc(m_host, BufferSize());
 		assert(newMemory && "failed to resize texture");
 		m_host = (u8*)newMemory;
 	}
 
+	m_deviceMips = 1;
+
 	MarkForUpdate();
 }
 
@@ -206,7 +310,9 @@ void Texture::_FreeHost()
 {
 	//log_render("i~[Texture] (%p) Host Free - bytes: %d", this, BufferSize());
 
-	free(m_host);
+	if (m_cooked) m_cooked = nullptr; // unmaps
+	else          free(m_host);
+
 	m_host = nullptr;
 }
 
@@ -214,6 +320,7 @@ void Texture::_FreeDevice()
 {
 	//log_render("i~[Texture] (%p) Device Free - bytes: %d, handle: %d", this, BufferSize(), m_device);
 
+	gl_state_forget_texture(m_device);
 	gl(glDeleteTextures(1, &m_device));
 	m_device = 0;
 }
@@ -221,11 +328,38 @@ void Texture::_FreeDevice()
 void Texture::_InitOnDevice()
 {
 	gl(glGenTextures(1, &m_device));
-	gl(glBindTexture(GL_TEXTURE_2D, m_device));
+	gl_state_bind_texture(GL_TEXTURE_2D, m_device);
 	gl(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
 	gl(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+
+	// host rows and cooked levels are tightly packed, gl expects each row to start on 4 bytes
+	gl(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
 	gl(glTexImage2D(GL_TEXTURE_2D, 0, gl_iformat(m_usage), Width(), Height(), 0, gl_format(m_usage), gl_type(m_usage), Pixels()));
 
+	gl_state_count_upload(BufferSize(), true);
+	m_dirty.Clear();
+
+	// the rest of the chain straight from the mapping, only the top level is updated after this
+	// so the mips are dropped the first time the host is sent again
+
+	m_deviceMips = 1;
+
+	if (m_cooked && m_cooked->MipCount() > 1)
+	{
+		for (int level = 1; level < m_cooked->MipCount(); level++)
+		{
+			CookedTextureMip mip = m_cooked->Mip(level);
+			gl(glTexImage2D(GL_TEXTURE_2D, level, gl_iformat(m_usage), mip.width, mip.height, 0, gl_format(m_usage), gl_type(m_usage), mip.pixels));
+			gl_state_count_upload(mip.bytes, true);
+		}
+
+		m_deviceMips = m_cooked->MipCount();
+	}
+
+	gl(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+
+	gl(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_deviceMips - 1));
+
 	_SetDeviceFilter();
 
 	//log_render("i~[Texture] (%p) Device Alloc - bytes: %d, handle: %d", this, BufferSize(), m_device);
@@ -233,21 +367,50 @@ void Texture::_InitOnDevice()
 
 void Texture::_UpdateOnDevice()
 {
-	glBindTexture(GL_TEXTURE_2D, m_device);
+	gl_state_bind_texture(GL_TEXTURE_2D, m_device);
+
+	// host rows are tightly packed, gl expects each row to start on 4 bytes
+	gl(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+
+	// only pixels were written, so the size is the same and just the rects need to be sent
+	// the host rows are the full width, so tell gl how far apart they are
+
+	if (PartialUpdate())
+	{
+		int bytesPerPixel = m_channels * m_bytesPerChannel;
+
+		gl(glPixelStorei(GL_UNPACK_ROW_LENGTH, m_width));
 
-	//int w, h;
-	//glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH,  &w);
-	//glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+		for (const DirtyRegion& rect : m_dirty.regions)
+		{
+			int width = rect.maxX - rect.minX;
+			int height = rect.maxY - rect.minY;
+			const u8* pixels = Pixels() + (rect.minX + rect.minY * m_width) * bytesPerPixel;
+
+			gl(glTexSubImage2D(GL_TEXTURE_2D, 0, rect.minX, rect.minY, width, height, gl_format(m_usage), gl_type(m_usage), pixels));
+			gl_state_count_upload(width * height * bytesPerPixel, false);
+		}
 
-	//if (w != m_width || h != m_height)
-	//{
+		gl(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+	}
+
+	else
+	{
 		gl(glTexImage2D(GL_TEXTURE_2D, 0, gl_iformat(m_usage), Width(), Height(), 0, gl_format(m_usage), gl_type(m_usage), Pixels()));
-	//}
+		gl_state_count_upload(BufferSize(), true);
+	}
+
+	gl(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
 
-	//else
-	//{
-		//gl(glTextureSubImage2D(m_device, 0, 0, 0, Width(), Height(), gl_format(m_usage), gl_type(m_usage), Pixels()));
-	//}
+	// only the top level was sent, so the cooked mips don't match it anymore
+	if (m_deviceMips > 1)
+	{
+		m_deviceMips = 1;
+		gl(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+		_SetDeviceFilter();
+	}
+
+	m_dirty.Clear();
 
 	//log_render("i~[Texture] (%p) Device Update - bytes: %d, handle: %d", this, BufferSize(), m_device);
 }
@@ -258,7 +421,7 @@ void Texture::_UpdateFromDevice()
 	// is it the data or the point in time this function is getting called?
 
 	//gl(glGetTextureImage(m_device, 0, gl_format(m_usage), gl_type(m_usage), BufferSize(), Pixels()));
-    gl(glBindTexture(GL_TEXTURE_2D, m_device));
+    gl_state_bind_texture(GL_TEXTURE_2D, m_device);
     gl(glGetTexImage(GL_TEXTURE_2D, 0, gl_format(m_usage), gl_type(m_usage), Pixels()));
 
 	//log_render("i~[Texture] (%p) Host Update - bytes: %d, handle: %d", this, BufferSize(), m_device);
@@ -266,7 +429,14 @@ void Texture::_UpdateFromDevice()
 
 void Texture::_SetDeviceFilter()
 {
-	gl(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, gl_filter(m_filter)));
+	GLenum minFilter = gl_filter(m_filter);
+
+	if (m_deviceMips > 1 && m_filter == fSmooth)
+	{
+		minFilter = GL_LINEAR_MIPMAP_LINEAR;
+	}
+
+	gl(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter));
 	gl(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter(m_filter)));
 }
 
@@ -280,6 +450,17 @@ Texture::Texture(
 )
 	: IDeviceObject (isStatic, OBJECT_TEXTURE)
 {
+	std::string cookedPath = io_FindCookedTexture(path);
+
+	if (cookedPath.size() > 0)
+	{
+		if (r<CookedTexture> cooked = io_MapCookedTexture(cookedPath.c_str()))
+		{
+			init_texture_cooked(cooked);
+			return;
+		}
+	}
+
 	auto [pixels, width, height, channels] = io_LoadImageFromFile(path.c_str());
 	assert(channels > 0 && channels <= 4 && "Invalid RGBA channel count created by stb");
 	init_texture_host_memory(pixels, width, height, (Usage)channels);
@@ -328,6 +509,9 @@ Texture& Texture::move_into(Texture&& move) noexcept
 
 	m_host            = move.m_host;
 	m_device          = move.m_device;
+	m_dirty           = std::move(move.m_dirty);
+	m_cooked          = std::move(move.m_cooked);
+	m_deviceMips      = move.m_deviceMips;
 
 	move.m_host = nullptr;
 	move.m_device = 0;
@@ -347,6 +531,7 @@ Texture& Texture::copy_into(const Texture& copy)
 	m_filter          = copy.m_filter;
 
 	m_device          = 0;
+	m_dirty           = copy.m_dirty;
 
 	if (copy.OnHost())
 	{
@@ -383,6 +568,16 @@ void Texture::init_texture_host_memory(void* pixels, int w, int h, Usage usage)
 	//log_render("i~[Texture] (%p) Host Init - bytes: %d", this, BufferSize());
 }
 
+void Texture::init_texture_cooked(const r<CookedTexture>& cooked)
+{
+	const CookedTextureHeader& header = cooked->Header();
+	assert(header.channels > 0 && header.channels <= 4 && "Invalid RGBA channel count in cooked texture");
+
+	// no copy, the pixels are read from the mapping when sent to the device
+	m_cooked = cooked;
+	init_texture_host_memory(cooked->Mip(0).pixels, header.width, header.height, (Usage)header.channels);
+}
+
 bool Texture::IsIndexValid(int index32) const
 {
 	return index32 >= 0 && index32 < Length();
@@ -447,7 +642,7 @@ void Target::Resize(int width, int height)
 void Target::Use()
 {
 	if (!OnDevice() || Outdated()) SendToDevice();
-	gl(glBindFramebuffer(GL_FRAMEBUFFER, m_device));
+	gl_state_bind_framebuffer(m_device);
 }
 
 bool Target::OnHost()       const { return m_attachments.size() != 0; }
@@ -462,6 +657,7 @@ void Target::_FreeHost()
 void Target::_FreeDevice()
 {
 	//for (auto& [_, texture] : m_attachments) if (texture->OnDevice()) texture->FreeDevice();
+	gl_state_forget_framebuffer(m_device);
 	gl(glDeleteFramebuffers(1, &m_device));
 	m_device = 0;
 }
@@ -469,7 +665,7 @@ void Target::_FreeDevice()
 void Target::_InitOnDevice()
 {
 	gl(glGenFramebuffers(1, &m_device));
-	gl(glBindFramebuffer(GL_FRAMEBUFFER, m_device));
+	gl_state_bind_framebuffer(m_device);
 
 	std::vector<GLenum> toDraw;
 
@@ -560,7 +756,9 @@ void Buffer::Clear()
 	m_host.clear();
 	m_length = 0;
 
-	MarkForUpdate();
+	// nothing left to send, the device only needs the new length
+	m_dirty.Clear();
+	MarkForPartialUpdate();
 }
 
 void Buffer::Resize(int elementCount)
@@ -588,7 +786,7 @@ void Buffer::PushBytes(int byteCount, const void* data)
 	m_host.resize(end + byteCount);
 	memcpy((char*)m_host.data() + end, data, byteCount);
 	
-	MarkForUpdate();
+	MarkRangeForUpdate(end, byteCount);
 }
 
 void Buffer::EraseBytes(int byteIndex, int byteCount)
@@ -596,7 +794,8 @@ void Buffer::EraseBytes(int byteIndex, int byteCount)
 	m_length -= byteCount / BytesPerElement();
 	m_host.erase(m_host.begin() + byteIndex, m_host.begin() + byteIndex + byteCount);
 	
-	MarkForUpdate();
+	// everything after the erase moved down
+	MarkRangeForUpdate(byteIndex, Bytes() - byteIndex);
 }
 
 void Buffer::PopBytes(int byteCount)
@@ -604,12 +803,19 @@ void Buffer::PopBytes(int byteCount)
 	m_length -= byteCount / BytesPerElement();
 	m_host.erase(m_host.end() - byteCount, m_host.end());
 	
-	MarkForUpdate();
+	// the remaining bytes are the same, the device only needs the new length
+	MarkForPartialUpdate();
+}
+
+void Buffer::MarkRangeForUpdate(int byteIndex, int byteCount)
+{
+	m_dirty.Add(byteIndex, byteIndex + byteCount);
+	MarkForPartialUpdate();
 }
 
 void Buffer::Set  (int elementCount, const void* elements) { SetBytes  (BytesPerElement() * elementCount, elements); }
 void Buffer::Push (int elementCount, const void* elements) { PushBytes (BytesPerElement() * elementCount, elements); }
-void Buffer::Erase(int elementIndex, int elementCount)     { EraseBytes(BytesPerElement() * elementIndex, elementCount); }
+void Buffer::Erase(int elementIndex, int elementCount)     { EraseBytes(BytesPerElement() * elementIndex, BytesPerElement() * elementCount); }
 void Buffer::Pop  (int elementCount)                       { PopBytes  (BytesPerElement() * elementCount); }
 
 bool Buffer::OnHost()       const { return m_onHost; }
@@ -626,6 +832,7 @@ void Buffer::_FreeDevice()
 {
 	gl(glDeleteBuffers(1, &m_device));
 	m_device = 0;
+	m_capacity = 0;
 }
 
 void Buffer::_InitOnDevice()
@@ -633,18 +840,48 @@ void Buffer::_InitOnDevice()
 	gl(glGenBuffers(1, &m_device));
 	gl(glBindBuffer(GL_ARRAY_BUFFER, m_device)); // user can bind to what they want after using ::DeviceHandle
 	gl(glBufferData(GL_ARRAY_BUFFER, Bytes(), Data(), gl_buffer_draw(IsStatic())));
+
+	m_capacity = Bytes();
+	gl_state_count_upload(Bytes(), true);
+	m_dirty.Clear();
 }
 
 void Buffer::_UpdateOnDevice()
 {
-	// on realloc, does old buffer need to be destroyed?
-
     gl(glBindBuffer(GL_ARRAY_BUFFER, m_device));
-    
-	int size = 0;
-	gl(glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size));
-	if (Bytes() != size) { gl(glBufferData(GL_ARRAY_BUFFER, Bytes(), Data(), gl_buffer_draw(IsStatic()))); }
-	else                 { gl(glBufferSubData(GL_ARRAY_BUFFER, 0, Bytes(), Data())); }
+
+	// only realloc when the data has outgrown the device storage
+	// dynamic buffers grow by half again so pushing every frame doesn't realloc every frame
+
+	bool realloc = Bytes() > m_capacity;
+	if (realloc)
+	{
+		m_capacity = IsStatic() ? Bytes() : max(Bytes(), m_capacity + m_capacity / 2);
+		gl(glBufferData(GL_ARRAY_BUFFER, m_capacity, nullptr, gl_buffer_draw(IsStatic())));
+	}
+
+	// after a realloc the device storage is empty, so everything has to be sent
+
+	if (PartialUpdate() && !realloc)
+	{
+		for (const DirtyRegion& range : m_dirty.regions)
+		{
+			int end = min(range.maxX, Bytes());
+			if (end <= range.minX)
+				continue;
+
+			gl(glBufferSubData(GL_ARRAY_BUFFER, range.minX, end - range.minX, (char*)Data() + range.minX));
+			gl_state_count_upload(end - range.minX, false);
+		}
+	}
+
+	else
+	{
+		gl(glBufferSubData(GL_ARRAY_BUFFER, 0, Bytes(), Data()));
+		gl_state_count_upload(Bytes(), realloc);
+	}
+
+	m_dirty.Clear();
 }
 
 void Buffer::_UpdateFromDevice()
@@ -689,8 +926,11 @@ Buffer& Buffer::move_into(Buffer&& move) noexcept
 
 	m_host  		  = std::move(move.m_host);
 	m_device		  = move.m_device;
+	m_capacity        = move.m_capacity;
+	m_dirty           = std::move(move.m_dirty);
 
 	move.m_device = 0;
+	move.m_capacity = 0;
 
 	return *this;
 }
@@ -704,8 +944,10 @@ Buffer& Buffer::copy_into(const Buffer& copy)
 	m_length          = copy.m_length;
 
 	m_device          = copy.IsStatic() ? copy.m_device : 0; // if its static take device
+	m_capacity        = copy.IsStatic() ? copy.m_capacity : 0;
 	m_host            = copy.m_host;
 	m_onHost          = copy.m_onHost;
+	m_dirty           = copy.m_dirty;
 
 	return *this;
 }
@@ -831,6 +1073,7 @@ void Mesh::_FreeHost()
 void Mesh::_FreeDevice()
 {
 	//for (auto& [_, buffer] : m_buffers) if (buffer->OnDevice()) buffer->FreeDevice();
+	gl_state_forget_vertex_array(m_device);
 	gl(glDeleteVertexArrays(1, &m_device));
 	m_device = 0;
 }
@@ -838,7 +1081,7 @@ void Mesh::_FreeDevice()
 void Mesh::_InitOnDevice()
 {
 	gl(glGenVertexArrays(1, &m_device));
-	gl(glBindVertexArray(m_device));
+	gl_state_bind_vertex_array(m_device);
 
 	for (auto& [attrib, buffer] : m_buffers)
 	{
@@ -943,7 +1186,7 @@ Mesh& Mesh::copy_into(const Mesh& copy)
 bool Mesh::SendBindAndReturnHasIndex()
 {
 	if (!OnDevice() || Outdated()) SendToDevice();
-	gl(glBindVertexArray(m_device));
+	gl_state_bind_vertex_array(m_device);
 	return m_buffers.find(aIndexBuffer) != m_buffers.end();
 }
 
@@ -965,69 +1208,158 @@ ShaderProgram& ShaderProgram::Add(ShaderName name, const std::string& str)
 ShaderProgram& ShaderProgram::Use()
 {
 	if (!OnDevice()) SendToDevice();
-	gl(glUseProgram(m_device));
+	gl_wait();
+	gl_state_use_program(m_device);
 
 	//m_slot = 0; // reset for texture bindings
 	return *this;
 }
 
-void ShaderProgram::Set(const std::string& name, const   int& x) { gl(glUniform1iv       (gl_location(name), 1,            (  int*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const   u32& x) { gl(glUniform1uiv      (gl_location(name), 1,            (  u32*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const   f32& x) { gl(glUniform1fv       (gl_location(name), 1,            (float*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const fvec2& x) { gl(glUniform2fv       (gl_location(name), 1,            (float*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const fvec3& x) { gl(glUniform3fv       (gl_location(name), 1,            (float*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const fvec4& x) { gl(glUniform4fv       (gl_location(name), 1,            (float*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const ivec2& x) { gl(glUniform2iv       (gl_location(name), 1,            (  int*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const ivec3& x) { gl(glUniform3iv       (gl_location(name), 1,            (  int*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const ivec4& x) { gl(glUniform4iv       (gl_location(name), 1,            (  int*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const fmat2& x) { gl(glUniformMatrix2fv (gl_location(name), 1,  GL_FALSE, (float*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const fmat3& x) { gl(glUniformMatrix3fv (gl_location(name), 1,  GL_FALSE, (float*)  &x)); }
-void ShaderProgram::Set(const std::string& name, const fmat4& x) { gl(glUniformMatrix4fv (gl_location(name), 1,  GL_FALSE, (float*)  &x)); }
+void ShaderProgram::Set(const std::string& name, const   int& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const   u32& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const   f32& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const fvec2& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const fvec3& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const fvec4& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const ivec2& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const ivec3& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const ivec4& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const fmat2& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const fmat3& x) { Set(Uniform(name), x); }
+void ShaderProgram::Set(const std::string& name, const fmat4& x) { Set(Uniform(name), x); }
 
 void ShaderProgram::Set(const std::string& name, const Color& color)
 {
-    Set(name, color.as_v4());
+    Set(Uniform(name), color);
 }
 
 void ShaderProgram::Set(const std::string& name, r<Texture> texture)
 {
-    Set(name, *texture);
+    Set(Uniform(name), *texture);
 }
 
 void ShaderProgram::SetArray(const std::string& name, const int* x, int count)
 {
-	gl(glUniform1iv(gl_location(name), count, (int*)&x));
+	SetArray(Uniform(name), x, count);
 }
 
 void ShaderProgram::SetArray(const std::string& name, const u32* x, int count)
 {
-	gl(glUniform1uiv(gl_location(name), count, (u32*)&x));
+	SetArray(Uniform(name), x, count);
 }
 
 void ShaderProgram::SetArray(const std::string& name, const f32* x, int count)
 {
-	gl(glUniform1fv(gl_location(name), count, (f32*)&x));
+	SetArray(Uniform(name), x, count);
 }
 
 void ShaderProgram::Set(const std::string& name, Texture& texture)
 {
-	if (!texture.OnDevice() || texture.Outdated()) texture.SendToDevice();
-	SetTexture(name, texture.DeviceHandle());
+	Set(Uniform(name), texture);
 }
 
 void ShaderProgram::SetTexture(const std::string& name, int handle)
 {
-	if (m_handleToSlot.count(name) == 0)
+	SetTexture(Uniform(name), handle);
+}
+
+bool ShaderProgram::IsReady()
+{
+	if (!OnDevice())
+		return false;
+
+	if (m_linking)
 	{
-		m_handleToSlot.emplace(name, m_slot);
-		m_slot++;
+		GLint complete = GL_FALSE;
+		gl(glGetProgramiv(m_device, GL_COMPLETION_STATUS_KHR, &complete));
+
+		if (complete == GL_TRUE)
+		{
+			gl_finish_link();
+		}
 	}
 
-	int slot = m_handleToSlot.at(name);
+	return !m_linking;
+}
 
-	gl(glActiveTexture(gl_program_texture_slot(slot)));
-	gl(glBindTexture(GL_TEXTURE_2D, handle)); // todo: need texture usage
-	gl(glUniform1i(gl_location(name), slot));
+UniformHandle ShaderProgram::Uniform(const std::string& name)
+{
+	if (!OnDevice()) SendToDevice();
+	gl_wait();
+
+	return FindUniform(name);
+}
+
+UniformHandle ShaderProgram::FindUniform(const std::string& name) const
+{
+	auto itr = m_uniforms.find(name);
+	return itr != m_uniforms.end() ? itr->second : UniformHandle();
+}
+
+void ShaderProgram::Set(UniformHandle uniform, const   int& x) { gl(glUniform1iv       (uniform.location, 1,            (  int*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const   u32& x) { gl(glUniform1uiv      (uniform.location, 1,            (  u32*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const   f32& x) { gl(glUniform1fv       (uniform.location, 1,            (float*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const fvec2& x) { gl(glUniform2fv       (uniform.location, 1,            (float*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const fvec3& x) { gl(glUniform3fv       (uniform.location, 1,            (float*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const fvec4& x) { gl(glUniform4fv       (uniform.location, 1,            (float*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const ivec2& x) { gl(glUniform2iv       (uniform.location, 1,            (  int*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const ivec3& x) { gl(glUniform3iv       (uniform.location, 1,            (  int*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const ivec4& x) { gl(glUniform4iv       (uniform.location, 1,            (  int*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const fmat2& x) { gl(glUniformMatrix2fv (uniform.location, 1,  GL_FALSE, (float*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const fmat3& x) { gl(glUniformMatrix3fv (uniform.location, 1,  GL_FALSE, (float*)  &x)); }
+void ShaderProgram::Set(UniformHandle uniform, const fmat4& x) { gl(glUniformMatrix4fv (uniform.location, 1,  GL_FALSE, (float*)  &x)); }
+
+void ShaderProgram::Set(UniformHandle uniform, const Color& color)
+{
+	Set(uniform, color.as_v4());
+}
+
+void ShaderProgram::Set(UniformHandle uniform, r<Texture> texture)
+{
+	Set(uniform, *texture);
+}
+
+void ShaderProgram::Set(UniformHandle uniform, Texture& texture)
+{
+	if (!texture.OnDevice() || texture.Outdated()) texture.SendToDevice();
+	SetTexture(uniform, texture.DeviceHandle());
+}
+
+void ShaderProgram::SetTexture(UniformHandle uniform, int handle)
+{
+	// not a sampler in this program, nothing to bind to
+	if (uniform.slot == -1)
+		return;
+
+	gl_state_bind_texture_unit(uniform.slot, GL_TEXTURE_2D, handle); // todo: need texture usage
+	gl(glUniform1i(uniform.location, uniform.slot));
+}
+
+void ShaderProgram::SetArray(UniformHandle uniform, const int* x, int count)
+{
+	gl(glUniform1iv(uniform.location, count, x));
+}
+
+void ShaderProgram::SetArray(UniformHandle uniform, const u32* x, int count)
+{
+	gl(glUniform1uiv(uniform.location, count, x));
+}
+
+void ShaderProgram::SetArray(UniformHandle uniform, const f32* x, int count)
+{
+	gl(glUniform1fv(uniform.location, count, x));
+}
+
+void ShaderProgram::SetBlock(const std::string& name, int binding)
+{
+	if (!OnDevice()) SendToDevice();
+	gl_wait();
+
+	GLuint index = gl(glGetUniformBlockIndex(m_device, name.c_str()));
+	if (index != GL_INVALID_INDEX)
+	{
+		gl(glUniformBlockBinding(m_device, index, binding));
+	}
 }
 
 bool ShaderProgram::OnHost()       const { return m_buffers.size() != 0; }
@@ -1041,13 +1373,113 @@ void ShaderProgram::_FreeHost()
 
 void ShaderProgram::_FreeDevice()
 {
+	gl_state_forget_program(m_device);
 	gl(glDeleteProgram(m_device));
 	m_device = 0;
+	m_linking = false;
+}
+
+static bool gl_program_binary_supported()
+{
+	static int supported = -1;
+
+	if (supported == -1)
+	{
+		GLint formats = 0;
+
+		if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)
+		{
+			gl(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats));
+		}
+
+		supported = formats > 0;
+	}
+
+	return supported;
+}
+
+static bool gl_parallel_compile_supported()
+{
+	static int supported = -1;
+
+	if (supported == -1)
+	{
+		supported = GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+
+		// let the driver pick how many threads to use
+		if (GLAD_GL_KHR_parallel_shader_compile)
+		{
+			gl(glMaxShaderCompilerThreadsKHR(0xffffffff));
+		}
+
+		else if (GLAD_GL_ARB_parallel_shader_compile)
+		{
+			gl(glMaxShaderCompilerThreadsARB(0xffffffff));
+		}
+	}
+
+	return supported;
+}
+
+static const std::string& gl_driver_string()
+{
+	static std::string driver;
+
+	if (driver.size() == 0)
+	{
+		driver += (const char*)glGetString(GL_VENDOR);
+		driver += (const char*)glGetString(GL_RENDERER);
+		driver += (const char*)glGetString(GL_VERSION);
+	}
+
+	return driver;
 }
 
 void ShaderProgram::_InitOnDevice()
 {
 	m_device = gl(glCreateProgram());
+	m_hash = 0;
+
+	const std::string& cacheDirectory = Render::GetContext()->shader_cache_directory;
+	bool cache = cacheDirectory.size() > 0 && gl_program_binary_supported();
+
+	if (cache)
+	{
+		std::vector<ShaderCacheStage> stages;
+
+		for (auto& [name, buffer] : m_buffers)
+		{
+			stages.push_back({ (int)name, buffer });
+		}
+
+		m_hash = shader_cache_hash(stages, gl_driver_string());
+
+		u32 format;
+		std::vector<char> binary;
+
+		if (shader_cache_load(shader_cache_file(cacheDirectory, m_hash), m_hash, &format, binary))
+		{
+			gl(glProgramBinary(m_device, format, binary.data(), (GLsizei)binary.size()));
+
+			GLint linked = GL_FALSE;
+			gl(glGetProgramiv(m_device, GL_LINK_STATUS, &linked));
+
+			// the driver can reject a binary, then compile like normal
+			if (linked == GL_TRUE)
+			{
+				m_hash = 0;
+				gl_reflect();
+				return;
+			}
+
+			gl(glDeleteProgram(m_device));
+			m_device = gl(glCreateProgram());
+		}
+
+		gl(glProgramParameteri(m_device, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	}
+
+	bool parallel = gl_parallel_compile_supported();
 
 	for (auto& [name, buffer] : m_buffers)
 	{
@@ -1059,18 +1491,22 @@ void ShaderProgram::_InitOnDevice()
 		glShaderSource(shader, 1, &source, nullptr);
 		gl(glCompileShader(shader));
 
-		// error check
-		GLint isCompiled = 0;
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
-		if (isCompiled == GL_FALSE)
+		// error check, this waits for the compile so only check if it can't happen in the background
+		// otherwise errors show up in the program's link log
+		if (!parallel)
 		{
-			GLint maxLength = 0;
-			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
-			std::vector<GLchar> infoLog(maxLength);
-			glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
-			glDeleteShader(shader); // if soft error this can be removed
-			//log_render("Failed to compile shader: %s", (char*)infoLog.data());
-			//assert(false && "Failed to compile shader"); // maybe soft error
+			GLint isCompiled = 0;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+			if (isCompiled == GL_FALSE)
+			{
+				GLint maxLength = 0;
+				glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+				std::vector<GLchar> infoLog(maxLength);
+				glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
+				glDeleteShader(shader); // if soft error this can be removed
+				//log_render("Failed to compile shader: %s", (char*)infoLog.data());
+				//assert(false && "Failed to compile shader"); // maybe soft error
+			}
 		}
 
 		gl(glAttachShader(m_device, shader));
@@ -1078,10 +1514,17 @@ void ShaderProgram::_InitOnDevice()
 	}
 
 	gl(glLinkProgram(m_device));
+	m_linking = true;
+
+	if (!parallel)
+	{
+		gl_finish_link();
+	}
 }
 
 void ShaderProgram::_UpdateOnDevice()
 {
+	gl_state_forget_program(m_device);
 	gl(glDeleteProgram(m_device));
 	_InitOnDevice();
 }
@@ -1133,8 +1576,107 @@ ShaderProgram& ShaderProgram::copy_into(const ShaderProgram& copy)
 
 GLint ShaderProgram::gl_location(const std::string& name) const
 {
-	GLint location = gl(glGetUniformLocation(m_device, name.c_str()));
-	return location;
+	auto itr = m_uniforms.find(name);
+	return itr != m_uniforms.end() ? itr->second.location : -1;
+}
+
+void ShaderProgram::gl_finish_link()
+{
+	m_linking = false;
+
+	GLint linked = GL_FALSE;
+	gl(glGetProgramiv(m_device, GL_LINK_STATUS, &linked));
+
+	if (linked == GL_FALSE)
+	{
+		GLint maxLength = 0;
+		gl(glGetProgramiv(m_device, GL_INFO_LOG_LENGTH, &maxLength));
+		std::vector<GLchar> infoLog(maxLength + 1);
+		gl(glGetProgramInfoLog(m_device, maxLength, &maxLength, infoLog.data()));
+		log_render("e~Failed to link shader program: %s", infoLog.data());
+		return;
+	}
+
+	// newly compiled, so store it for next time
+	if (m_hash != 0)
+	{
+		GLint bytes = 0;
+		gl(glGetProgramiv(m_device, GL_PROGRAM_BINARY_LENGTH, &bytes));
+
+		if (bytes > 0)
+		{
+			GLenum format = 0;
+			std::vector<char> binary(bytes);
+			gl(glGetProgramBinary(m_device, bytes, &bytes, &format, binary.data()));
+			binary.resize(bytes);
+
+			shader_cache_save(shader_cache_file(Render::GetContext()->shader_cache_directory, m_hash), m_hash, format, binary);
+		}
+
+		m_hash = 0;
+	}
+
+	gl_reflect();
+}
+
+void ShaderProgram::gl_wait()
+{
+	// querying the link status blocks until the driver is done
+	if (m_linking)
+	{
+		gl_finish_link();
+	}
+}
+
+void ShaderProgram::gl_reflect()
+{
+	m_uniforms.clear();
+	m_slot = 0;
+
+	GLint count = 0;
+	GLint maxLength = 0;
+	gl(glGetProgramiv(m_device, GL_ACTIVE_UNIFORMS, &count));
+	gl(glGetProgramiv(m_device, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength));
+
+	std::vector<GLchar> buffer(maxLength + 1);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		gl(glGetActiveUniform(m_device, i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data()));
+
+		std::string name(buffer.data(), length);
+
+		UniformHandle uniform;
+		uniform.location = gl(glGetUniformLocation(m_device, name.c_str()));
+
+		// members of uniform blocks don't have a location
+		if (uniform.location == -1)
+			continue;
+
+		if (gl_is_sampler(type))
+		{
+			uniform.slot = m_slot;
+			m_slot += size;
+		}
+
+		// arrays are reported as name[0], allow setting them by just the name
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			m_uniforms.emplace(name.substr(0, name.size() - 3), uniform);
+		}
+
+		m_uniforms.emplace(name, uniform);
+	}
+
+	// attach to the shared camera data if this program uses it
+	GLuint camera = gl(glGetUniformBlockIndex(m_device, "Camera"));
+	if (camera != GL_INVALID_INDEX)
+	{
+		gl(glUniformBlockBinding(m_device, camera, Render::CameraBlockBinding));
+	}
 }
 
 // Translation
@@ -1318,6 +1860,30 @@ GLenum gl_shader_type(ShaderProgram::ShaderName type)
 	return -1;
 }
 
+bool gl_is_sampler(GLenum uniformType)
+{
+	switch (uniformType)
+	{
+		case GL_SAMPLER_1D:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_1D_SHADOW:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_1D_ARRAY:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_2D_MULTISAMPLE:
+		case GL_SAMPLER_BUFFER:
+		case GL_INT_SAMPLER_2D:
+		case GL_INT_SAMPLER_2D_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_2D:
+		case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+			return true;
+		default:
+			return false;
+	}
+}
+
 GLint gl_program_texture_slot(int slot)
 {
 	return GL_TEXTURE0 + slot;
@@ -1358,7 +1924,7 @@ namespace Render
 		{
 			if (!ctx->default_target) // set target to screen
 			{
-				gl(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+				gl_state_bind_framebuffer(0);
 				gl(glViewport(0, 0, ctx->window_width, ctx->window_height));
 
 				return; // exit
@@ -1374,8 +1940,51 @@ namespace Render
 
 	void SetAlphaBlend(bool blend)
 	{
-		gl(glEnable(GL_BLEND));
-		gl(glBlendFunc(GL_SRC_ALPHA, blend ? GL_ONE_MINUS_SRC_ALPHA : GL_ONE));
+		gl_state_blend(true, GL_SRC_ALPHA, blend ? GL_ONE_MINUS_SRC_ALPHA : GL_ONE);
+	}
+
+	// matches the glsl std140 layout, mat4s have no padding
+	struct CameraBlock
+	{
+		mat4 proj;
+		mat4 view;
+		mat4 viewProj;
+	};
+
+	void SetCameraBlock(const mat4& proj, const mat4& view)
+	{
+		CameraBlock block;
+		block.proj = proj;
+		block.view = view;
+		block.viewProj = proj * view;
+
+		if (ctx->camera_block == 0)
+		{
+			gl(glGenBuffers(1, &ctx->camera_block));
+			gl(glBindBuffer(GL_UNIFORM_BUFFER, ctx->camera_block));
+			gl(glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW));
+			gl(glBindBufferBase(GL_UNIFORM_BUFFER, CameraBlockBinding, ctx->camera_block));
+		}
+
+		gl(glBindBuffer(GL_UNIFORM_BUFFER, ctx->camera_block));
+		gl(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block));
+		gl(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+	}
+
+	void SetShaderCacheDirectory(const std::string& directory)
+	{
+		ctx->shader_cache_directory = directory;
+	}
+
+	void CompileShaders(const std::vector<r<ShaderProgram>>& programs)
+	{
+		for (const r<ShaderProgram>& program : programs)
+		{
+			if (!program->OnDevice())
+			{
+				program->SendToDevice();
+			}
+		}
 	}
 
 	void ClearRenderTarget()
@@ -9,6 +9,7 @@
 #include "SDL.h"
 #include "glad/glad.h"
 #include "util/error_check.h"
+#include "util/gl_state.h"
 
 Window::Window()
 	: m_window     (nullptr)
@@ -64,8 +65,7 @@ void Window::Init()
 	gl(glEnable(GL_DEPTH_TEST));
 
 	// enable transparency
-	gl(glEnable(GL_BLEND));
-	gl(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+	gl_state_blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// vsync
 
@@ -414,6 +414,8 @@ void Window::EndFrame()
 {
 	SDL_GL_SwapWindow(m_window);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	gl_state_end_frame();
 }
 	
 // imgui renderer
@@ -424,7 +426,7 @@ void Window::BeginImgui()
 	// but 99% of the time you want to draw imgui 
 	// to the screen not some back buffer
 		
-	gl(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	gl_state_bind_framebuffer(0);
 
 	ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplSDL2_NewFrame(m_window);
@@ -445,6 +447,9 @@ void Window::EndImgui()
 	{
 		SDL_GL_MakeCurrent(m_window, m_opengl);
 	}
+
+	// imgui binds its own program, textures and vao
+	gl_state_invalidate();
 }
 
 Window::Window(Window&& move) noexcept
@@ -82,6 +82,14 @@ void SceneNode::Tick(float deltaTime, float fixedTime)
 
 			physics.Tick(fixedTime);
 		}
+
+		// the time left over is how far rendering is between the last step and the next
+		physics.SetInterpolationAlpha(timeAcc / fixedTime);
+	}
+
+	else
+	{
+		physics.SetInterpolationAlpha(1.f);
 	}
 
 	for (SceneUpdateGroupNode* group : groups)
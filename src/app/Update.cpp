@@ -130,6 +130,41 @@ PointQueryResult SystemBase::QueryPoint(vec2 pos, float radius)
 	return m_scene->physics.QueryPoint(pos, radius);
 }
 
+void SystemBase::QueryRays(const ArrayView<PhysicsRay>& rays, ArrayView<PhysicsRayHit> hits, PhysicsQueryMode mode)
+{
+	m_scene->physics.QueryRays(rays, hits, mode);
+}
+
+void SystemBase::QueryPoints(const ArrayView<PhysicsPointQuery>& queries, ArrayView<PhysicsPointHit> hits, PhysicsQueryMode mode)
+{
+	m_scene->physics.QueryPoints(queries, hits, mode);
+}
+
+PhysicsClosestHit SystemBase::QueryClosest(vec2 pos, float maxDistance, int ignoreEntity)
+{
+	return m_scene->physics.QueryClosest(pos, maxDistance, ignoreEntity);
+}
+
+void SystemBase::QueryClosest(const ArrayView<PhysicsClosestQuery>& queries, ArrayView<PhysicsClosestHit> hits)
+{
+	m_scene->physics.QueryClosest(queries, hits);
+}
+
+float SystemBase::GetPhysicsAlpha()
+{
+	return m_scene->physics.GetInterpolationAlpha();
+}
+
+void SystemBase::SetPhysicsFocus(const std::vector<vec2>& points)
+{
+	m_scene->physics.SetLodFocus(points);
+}
+
+const PhysicsStats& SystemBase::GetPhysicsStats()
+{
+	return m_scene->physics.GetStats();
+}
+
 vec2 SystemBase::GetAxis(const InputName& name)
 {
 	return m_scene->app->input.GetAxis(name);
@@ -1,13 +1,22 @@
 #include "ext/rendering/BatchLineRenderer.h"
+#include "util/error_check.h" // gives gl
+#include "util/gl_state.h"
+#include <string.h>
 
 BatchLineRenderer::BatchLineRenderer()
 {
 	InitProgram();
 }
 
+BatchLineRenderer::~BatchLineRenderer()
+{
+	gl_state_forget_vertex_array(m_vao);
+	gl(glDeleteVertexArrays(1, &m_vao));
+}
+
 void BatchLineRenderer::Begin()
 {
-	m_mesh.Clear();
+	m_upload.NextFrame();
 }
 
 void BatchLineRenderer::SubmitLine(const vec2& a, const vec2& b, const Color& color, float z)
@@ -37,15 +46,7 @@ void BatchLineRenderer::SubmitLine(const vec2& a, const vec2& b, const Color& co
 	vec4 ca = colorA.as_v4();
 	vec4 cb = colorB.as_v4();
 
-	vec3 _a = vec3(a, 0.f);
-	vec3 _b = vec3(b, 0.f);
-
-	m_mesh.Get(Mesh::aCustom_a1)->Push(1, &world); // need to copy for each point
-	m_mesh.Get(Mesh::aCustom_a1)->Push(1, &world);
-	m_mesh.Get(Mesh::aPosition)->Push(1, &_a);
-	m_mesh.Get(Mesh::aPosition)->Push(1, &_b);
-	m_mesh.Get(Mesh::aColor)->Push(1, &ca);
-	m_mesh.Get(Mesh::aColor)->Push(1, &cb);
+	PushLine(vec3(a, 0.f), vec3(b, 0.f), ca, cb, world);
 }
 
 void BatchLineRenderer::SubmitLine(const vec3& a, const vec3& b, const Color& colorA, const Color& colorB, const Transform& transform)
@@ -54,20 +55,49 @@ void BatchLineRenderer::SubmitLine(const vec3& a, const vec3& b, const Color& co
 	vec4 ca = colorA.as_v4();
 	vec4 cb = colorB.as_v4();
 
-	m_mesh.Get(Mesh::aCustom_a1)->Push(1, &world); // need to copy for each point
-	m_mesh.Get(Mesh::aCustom_a1)->Push(1, &world);
-	m_mesh.Get(Mesh::aPosition) ->Push(1, &a);
-	m_mesh.Get(Mesh::aPosition) ->Push(1, &b);
-	m_mesh.Get(Mesh::aColor)    ->Push(1, &ca);
-	m_mesh.Get(Mesh::aColor)    ->Push(1, &cb);
+	PushLine(a, b, ca, cb, world);
 }
 
 void BatchLineRenderer::Draw(const Camera& camera)
 {
+	int count = m_upload.Used() / sizeof(Vertex);
+	if (count == 0)
+		return;
+
+	m_upload.Flush();
+
 	m_program.Use();
 	m_program.Set("view", camera.View());
 	m_program.Set("proj", camera.Projection());
-	m_mesh.Draw(Mesh::tLines);
+
+	// the ring gives a different buffer each frame, so point the attributes at this one
+
+	gl_state_bind_vertex_array(m_vao);
+	gl(glBindBuffer(GL_ARRAY_BUFFER, m_upload.DeviceHandle()));
+
+	gl(glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, position)));
+	gl(glVertexAttribPointer(5, 4, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, color)));
+
+	for (int i = 0; i < 4; i++)
+	{
+		gl(glVertexAttribPointer(6 + i, 4, GL_FLOAT, false, sizeof(Vertex), (void*)(offsetof(Vertex, model) + sizeof(vec4) * i)));
+	}
+
+	gl(glDrawArrays(GL_LINES, 0, count));
+}
+
+void BatchLineRenderer::PushLine(const vec3& a, const vec3& b, const vec4& colorA, const vec4& colorB, const mat4& world)
+{
+	// alignment of 1 so the lines of a frame are one contiguous array
+	Vertex* vertices = m_upload.Allocate(sizeof(Vertex) * 2, 1).As<Vertex>();
+
+	vertices[0].position = a;
+	vertices[0].color = colorA;
+	vertices[0].model = world;
+
+	vertices[1].position = b;
+	vertices[1].color = colorB;
+	vertices[1].model = world;
 }
 
 void BatchLineRenderer::InitProgram()
@@ -109,8 +139,16 @@ void BatchLineRenderer::InitProgram()
 	m_program.Add(ShaderProgram::sVertex,   source_vert);
 	m_program.Add(ShaderProgram::sFragment, source_frag);
 
-	m_mesh = Mesh(DYNAMIC_HOST)
-		.Add<vec3>(Mesh::aPosition)
-		.Add<vec4>(Mesh::aColor)
-		.Add<mat4>(Mesh::aCustom_a1);
+	gl(glGenVertexArrays(1, &m_vao));
+	gl_state_bind_vertex_array(m_vao);
+
+	gl(glEnableVertexAttribArray(0));
+	gl(glEnableVertexAttribArray(5));
+
+	for (int i = 0; i < 4; i++)
+	{
+		gl(glEnableVertexAttribArray(6 + i));
+	}
+
+	gl_state_bind_vertex_array(0);
 }
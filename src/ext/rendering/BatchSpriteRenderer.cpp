@@ -1,49 +1,105 @@
 #include "ext/rendering/BatchSpriteRenderer.h"
+#include "util/error_check.h" // gives gl
+#include "util/gl_state.h"
+#include <string.h>
 
 BatchSpriteRenderer::BatchSpriteRenderer()
 {
 	InitProgram();
 }
 
+BatchSpriteRenderer::~BatchSpriteRenderer()
+{
+	m_batches.clear();
+
+	gl(glDeleteBuffers(1, &m_quadVertices));
+	gl(glDeleteBuffers(1, &m_quadIndices));
+}
+
 //BatchSpriteRenderer::BatchSpriteRenderer(const char* vertexShader, const char* fragmentShader)
 //{
 //}
 
-void BatchSpriteRenderer::Begin()
+// remove batches after they haven't been drawn for this many frames
+constexpr int BATCH_MAX_FRAMES_UNUSED = 120;
+
+// bit layout of the sort keys, see header
+constexpr int KEY_LAYER_SHIFT   = 56;
+constexpr int KEY_BLEND_SHIFT   = 54;
+constexpr int KEY_TEXTURE_SHIFT = 32;
+constexpr u64 KEY_TEXTURE_MASK  = (1ull << 22) - 1;
+
+// map the bits of a float to an unsigned int with the same ordering
+static u32 sortable_depth(float z)
 {
-	z = 0;// -camera.z / 2 + 0.01f;
+	u32 bits;
+	memcpy(&bits, &z, sizeof(float));
+	return (bits & 0x80000000) ? ~bits : bits | 0x80000000;
 }
 
-void BatchSpriteRenderer::Draw(const Camera& camera, bool mixTint)
+static u64 sprite_key(u8 layer, BlendMode blend, int handle, float z)
 {
-	SetProgram(camera.Projection(), camera.View(), mixTint);
+	assert((u64)handle <= KEY_TEXTURE_MASK && "Texture handle does not fit in sprite sort key");
 
-	for (auto& [texture, batch] : m_batches) DrawBatch(texture, batch);
-	m_batches.clear(); // can have a much better scheme for keeping vector memory alive
+	return (u64)layer            << KEY_LAYER_SHIFT
+	     | (u64)blend            << KEY_BLEND_SHIFT
+	     | (u64)handle           << KEY_TEXTURE_SHIFT
+	     | (u64)sortable_depth(z);
 }
 
-void BatchSpriteRenderer::SetZOffsetPerDraw(float zOffsetPerDraw)
+void BatchSpriteList::SetLayer(u8 layer)
 {
-	this->zOffsetPerDraw = zOffsetPerDraw;
+	m_layer = layer;
 }
 
-void BatchSpriteRenderer::SubmitColor(const Transform2D& transform, Color tint)
+void BatchSpriteList::SetBlend(BlendMode blend)
 {
-	SubmitTexture(transform, nullptr, vec2(0.f), vec2(0.f), tint);
+	m_blend = blend;
 }
 
-void BatchSpriteRenderer::SubmitSprite(const Transform2D& transform, Sprite& sprite)
+void BatchSpriteList::SetCullRect(const aabb2D& rect)
+{
+	m_cull = true;
+	m_cullRect = rect;
+}
+
+void BatchSpriteList::ClearCullRect()
+{
+	m_cull = false;
+}
+
+bool BatchSpriteList::IsCulled(const Transform2D& transform) const
+{
+	if (!m_cull)
+		return false;
+
+	// the sum of the half extents covers the quad at any rotation
+	float r = abs(transform.scale.x) + abs(transform.scale.y);
+
+	return transform.position.x + r < m_cullRect.min.x || transform.position.x - r > m_cullRect.max.x
+		|| transform.position.y + r < m_cullRect.min.y || transform.position.y - r > m_cullRect.max.y;
+}
+
+void BatchSpriteList::SubmitColor(const Transform2D& transform, Color tint)
+{
+	SubmitHandle(transform, 0, vec2(0.f), vec2(0.f), tint);
+}
+
+void BatchSpriteList::SubmitSprite(const Transform2D& transform, Sprite& sprite)
 {
 	SubmitTexture(transform, sprite.source, sprite.uvOffset, sprite.uvScale, sprite.tint);
 }
 
-void BatchSpriteRenderer::SubmitStaticSprite(const Transform2D& transform, SpriteStaticHandle& sprite)
+void BatchSpriteList::SubmitStaticSprite(const Transform2D& transform, SpriteStaticHandle& sprite)
 {
-    SubmitHandle(transform, sprite.sourceHandle, sprite.uvOffset, sprite.uvScale, sprite.tint);
+	SubmitHandle(transform, sprite.sourceHandle, sprite.uvOffset, sprite.uvScale, sprite.tint);
 }
 
-void BatchSpriteRenderer::SubmitParticle(const Transform2D& transform, Particle& particle)
+void BatchSpriteList::SubmitParticle(const Transform2D& transform, Particle& particle)
 {
+	BlendMode blend = m_blend;
+	m_blend = particle.blendMode;
+
 	if (particle.HasAtlas())
 	{
 		const TextureAtlas::Bounds& bounds = particle.GetCurrentFrameUV();
@@ -52,45 +108,226 @@ void BatchSpriteRenderer::SubmitParticle(const Transform2D& transform, Particle&
 
 	else
 	{
-		SubmitTexture(transform, nullptr, vec2(0.f), vec2(1.f), particle.GetTint());
+		SubmitHandle(transform, 0, vec2(0.f), vec2(1.f), particle.GetTint());
 	}
+
+	m_blend = blend;
 }
 
-void BatchSpriteRenderer::SubmitTexture(const Transform2D& transform, r<Texture> texture, vec2 uvOffset, vec2 uvScale, Color tint)
+void BatchSpriteList::SubmitTexture(const Transform2D& transform, r<Texture> texture, vec2 uvOffset, vec2 uvScale, Color tint)
 {
-    int handle = 0;
-    
-    if (texture) {
-        if (texture->OnHost())
-            texture->SendToDevice();
-        
-        handle = texture->DeviceHandle();
-    }
-    
-    else {
-        handle = m_default->DeviceHandle();
-    }
-    
-    SubmitHandle(transform, handle, uvOffset, uvScale, tint);
+	if (!texture)
+	{
+		SubmitHandle(transform, 0, uvOffset, uvScale, tint);
+		return;
+	}
+
+	// before queuing the texture to be sent
+	if (IsCulled(transform))
+		return;
+
+	// the renderer sends the texture on Draw, until then the handle is unknown
+
+	bool needsSend = texture->OnHost() && (!texture->OnDevice() || texture->Outdated());
+	if (needsSend)
+		m_pending.emplace_back((u32)m_commands.size(), texture);
+
+	SubmitHandle(transform, needsSend ? 0 : texture->DeviceHandle(), uvOffset, uvScale, tint);
 }
 
-void BatchSpriteRenderer::SubmitHandle(const Transform2D& transform, int handle, vec2 uvOffset, vec2 uvScale, Color tint)
+void BatchSpriteList::SubmitHandle(const Transform2D& transform, int handle, vec2 uvOffset, vec2 uvScale, Color tint)
 {
-    // could compress to:
-    // uv (4 floats)
-    // model (scale 2 float, pos 3 floats, rot 1 float) 6 floats
-    // tint (1 uint32)
+	if (IsCulled(transform))
+		return;
+
+	BatchSpriteInstance instance;
+	instance.uv       = vec4(uvOffset, uvScale);
+	instance.position = vec3(transform.position, transform.z);
+	instance.rotation = transform.rotation;
+	instance.scale    = transform.scale;
+	instance.tint     = tint.as_u32;
+
+	BatchSpriteCommand command;
+	command.instance = (u32)m_instances.size();
+	command.key = sprite_key(m_layer, m_blend, handle, transform.z);
+
+	m_instances.push_back(instance);
+	m_commands.push_back(command);
+}
 
-    mat4 world = transform.World();
-    world[3][2] += z;
+int BatchSpriteList::Count() const
+{
+	return (int)m_commands.size();
+}
 
-    // add a little offset to stop z fighting
-    // gets a little wonky with many particles
-    z += zOffsetPerDraw;
+void BatchSpriteList::Clear()
+{
+	m_instances.clear();
+	m_commands.clear();
+	m_pending.clear();
 
-    vec4 uv = vec4(uvOffset, uvScale);
-    
-    m_batches[handle].add(world, uv, tint.as_v4());
+	m_layer = 0;
+	m_blend = BLEND_NORMAL;
+	m_cull = false;
+}
+
+void BatchSpriteRenderer::Begin()
+{
+	z = 0;// -camera.z / 2 + 0.01f;
+	m_list.SetLayer(0);
+	m_list.SetBlend(BLEND_NORMAL);
+}
+
+void BatchSpriteRenderer::Draw(const Camera& camera, bool mixTint)
+{
+	MergeList(m_list);
+
+	{
+		std::unique_lock lock(m_listsMutex);
+		for (std::unique_ptr<BatchSpriteList>& list : m_lists)
+			MergeList(*list);
+	}
+
+	if (m_atlas)
+		m_atlas->SendToDevice();
+
+	SetProgram(camera.Projection(), camera.View(), mixTint);
+	SortCommands();
+
+	for (auto& [_, batch] : m_batches) 
+		batch.framesUnused += 1;
+
+	// walk the sorted commands, each run of the same layer/blend/texture is one batch
+	// the blend state is set for the first batch and put back to what the caller had after
+
+	bool callerBlend;
+	GLenum callerSrc, callerDst;
+	gl_state_get_blend(callerBlend, callerSrc, callerDst);
+
+	int additive = -1; // nothing set yet
+
+	for (size_t begin = 0; begin < m_commands.size();)
+	{
+		u32 batchKey = (u32)(m_commands[begin].key >> KEY_TEXTURE_SHIFT);
+
+		size_t end = begin + 1;
+		while (end < m_commands.size() && (u32)(m_commands[end].key >> KEY_TEXTURE_SHIFT) == batchKey)
+			end += 1;
+
+		BatchData& batch = m_batches.try_emplace(batchKey, m_quadVertices, m_quadIndices).first->second;
+		BatchSpriteInstance* instances = batch.begin((int)(end - begin));
+
+		if (!instances)
+		{
+			begin = end;
+			continue;
+		}
+
+		// add a little offset in sorted order to stop z fighting
+		// gets a little wonky with many particles
+
+		for (size_t i = begin; i < end; i++)
+		{
+			BatchSpriteInstance& instance = instances[i - begin];
+			instance = m_instances[m_commands[i].instance];
+			instance.position.z += z;
+
+			z += zOffsetPerDraw;
+		}
+
+		int batchAdditive = ((m_commands[begin].key >> KEY_BLEND_SHIFT) & 0x3) == BLEND_ADD;
+		if (batchAdditive != additive)
+		{
+			Render::SetAlphaBlend(!batchAdditive);
+			additive = batchAdditive;
+		}
+
+		DrawBatch((int)(batchKey & KEY_TEXTURE_MASK), batch);
+
+		begin = end;
+	}
+
+	if (additive != -1)
+		gl_state_blend(callerBlend, callerSrc, callerDst);
+
+	for (auto itr = m_batches.begin(); itr != m_batches.end();)
+	{
+		if (itr->second.framesUnused > BATCH_MAX_FRAMES_UNUSED) itr = m_batches.erase(itr);
+		else                                                    ++itr;
+	}
+
+	m_instances.clear();
+	m_commands.clear();
+}
+
+void BatchSpriteRenderer::SetZOffsetPerDraw(float zOffsetPerDraw)
+{
+	this->zOffsetPerDraw = zOffsetPerDraw;
+}
+
+void BatchSpriteRenderer::SetAtlas(r<SpriteAtlas> atlas)
+{
+	m_atlas = atlas;
+}
+
+BatchSpriteList& BatchSpriteRenderer::GetList(int index)
+{
+	std::unique_lock lock(m_listsMutex);
+
+	while ((int)m_lists.size() <= index)
+		m_lists.push_back(std::make_unique<BatchSpriteList>());
+
+	return *m_lists.at(index);
+}
+
+void BatchSpriteRenderer::SetLayer(u8 layer)
+{
+	m_list.SetLayer(layer);
+}
+
+void BatchSpriteRenderer::SetBlend(BlendMode blend)
+{
+	m_list.SetBlend(blend);
+}
+
+void BatchSpriteRenderer::SetCullRect(const aabb2D& rect)
+{
+	m_list.SetCullRect(rect);
+}
+
+void BatchSpriteRenderer::ClearCullRect()
+{
+	m_list.ClearCullRect();
+}
+
+void BatchSpriteRenderer::SubmitColor(const Transform2D& transform, Color tint)
+{
+	m_list.SubmitColor(transform, tint);
+}
+
+void BatchSpriteRenderer::SubmitSprite(const Transform2D& transform, Sprite& sprite)
+{
+	m_list.SubmitSprite(transform, sprite);
+}
+
+void BatchSpriteRenderer::SubmitStaticSprite(const Transform2D& transform, SpriteStaticHandle& sprite)
+{
+	m_list.SubmitStaticSprite(transform, sprite);
+}
+
+void BatchSpriteRenderer::SubmitParticle(const Transform2D& transform, Particle& particle)
+{
+	m_list.SubmitParticle(transform, particle);
+}
+
+void BatchSpriteRenderer::SubmitTexture(const Transform2D& transform, r<Texture> texture, vec2 uvOffset, vec2 uvScale, Color tint)
+{
+	m_list.SubmitTexture(transform, texture, uvOffset, uvScale, tint);
+}
+
+void BatchSpriteRenderer::SubmitHandle(const Transform2D& transform, int handle, vec2 uvOffset, vec2 uvScale, Color tint)
+{
+	m_list.SubmitHandle(transform, handle, uvOffset, uvScale, tint);
 }
 
 void BatchSpriteRenderer::InitProgram()
@@ -101,9 +338,10 @@ void BatchSpriteRenderer::InitProgram()
 		"layout (location = 0) in vec2 pos;"
 		"layout (location = 1) in vec2 uv;"
 
-		"layout (location = 6) in vec4 uvOffsetAndScale;"
-		"layout (location = 7) in vec4 tint;"
-		"layout (location = 10) in mat4 model;"
+		"layout (location = 2) in vec4 uvOffsetAndScale;"
+		"layout (location = 3) in vec4 positionAndRotation;"
+		"layout (location = 4) in vec2 scale;"
+		"layout (location = 5) in vec4 tint;"
 
 		"out vec2 TexCoords;"
 		"out vec4 Tint;"
@@ -115,7 +353,13 @@ void BatchSpriteRenderer::InitProgram()
 		"{"
 			"TexCoords = uv * uvOffsetAndScale.zw + uvOffsetAndScale.xy;"
 			"Tint = tint;"
-			"gl_Position = proj * view * model * vec4(pos, 0.0, 1.0);"
+
+			"vec2 scaled = pos * scale;"
+			"float s = sin(positionAndRotation.w);"
+			"float c = cos(positionAndRotation.w);"
+			"vec2 world = vec2(scaled.x * c - scaled.y * s, scaled.x * s + scaled.y * c) + positionAndRotation.xy;"
+
+			"gl_Position = proj * view * vec4(world, positionAndRotation.z, 1.0);"
 		"}";
 
 	const char* source_frag = 
@@ -150,7 +394,34 @@ void BatchSpriteRenderer::InitProgram()
 	m_program.Add(ShaderProgram::sVertex,   source_vert);
 	m_program.Add(ShaderProgram::sFragment, source_frag);
     m_program.SendToDevice();
+
+	m_uniformProj    = m_program.Uniform("proj");
+	m_uniformView    = m_program.Uniform("view");
+	m_uniformMixTint = m_program.Uniform("mixTint");
+	m_uniformSprite  = m_program.Uniform("sprite");
     
+	vec2 positions[4] = { vec2(-0.5f, -0.5f), vec2(0.5f, -0.5f), vec2(0.5f, 0.5f), vec2(-0.5f, 0.5f) };
+	vec2 uvs[4]       = { vec2( 0,  0), vec2(1,  0), vec2(1, 1), vec2( 0, 1) };
+	int  index[6]     = { 0, 1, 2, 0, 2, 3 };
+
+	vec2 vertices[8];
+	for (int i = 0; i < 4; i++)
+	{
+		vertices[i * 2 + 0] = positions[i];
+		vertices[i * 2 + 1] = uvs[i];
+	}
+
+	// the index buffer binding is part of the bound vao, so unbind whatever mesh was last drawn
+	gl_state_bind_vertex_array(0);
+
+	gl(glGenBuffers(1, &m_quadVertices));
+	gl(glBindBuffer(GL_ARRAY_BUFFER, m_quadVertices));
+	gl(glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW));
+
+	gl(glGenBuffers(1, &m_quadIndices));
+	gl(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_quadIndices));
+	gl(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index), index, GL_STATIC_DRAW));
+
 	m_default = mkr<Texture>(Texture(5, 5, Texture::uRGBA));
 	m_default->ClearHost(Color(255, 255, 255, 255));
     m_default->SendToDevice();
@@ -159,60 +430,191 @@ void BatchSpriteRenderer::InitProgram()
 void BatchSpriteRenderer::SetProgram(const mat4& proj, const mat4& view, bool mixTint)
 {
 	m_program.Use();
-	m_program.Set("proj", proj);
-	m_program.Set("view", view);
-	m_program.Set("mixTint", (float)mixTint);
+	m_program.Set(m_uniformProj, proj);
+	m_program.Set(m_uniformView, view);
+	m_program.Set(m_uniformMixTint, (float)mixTint);
 }
 
 void BatchSpriteRenderer::DrawBatch(int texture, BatchData& batch)
 {
-	if (texture) m_program.SetTexture("sprite", texture);
-	else         m_program.Set("sprite", *m_default);
+	if (texture) m_program.SetTexture(m_uniformSprite, texture);
+	else         m_program.Set(m_uniformSprite, *m_default);
 
 	batch.finalize();
 }
 
-r<Texture> BatchSpriteRenderer::GetDefaultTexture() const
+void BatchSpriteRenderer::MergeList(BatchSpriteList& list)
 {
-    return m_default;
+	// send textures which were submitted before being on the device
+	// and patch in their handles. If there is an atlas, try to use it first
+	// because static textures can only be added while they are on the host
+
+	for (auto& [command, texture] : list.m_pending)
+	{
+		BatchSpriteCommand& pending = list.m_commands.at(command);
+		int handle = 0;
+
+		SpriteAtlasEntry entry;
+		if (m_atlas && m_atlas->Get(texture, &entry))
+		{
+			vec4& uv = list.m_instances.at(pending.instance).uv;
+			uv = vec4(entry.uvOffset + vec2(uv.x, uv.y) * entry.uvScale, vec2(uv.z, uv.w) * entry.uvScale);
+
+			handle = m_atlas->PageHandle(entry.page);
+		}
+
+		else
+		{
+			if (texture->OnHost())
+				texture->SendToDevice();
+
+			handle = texture->DeviceHandle();
+		}
+
+		pending.key |= (u64)handle << KEY_TEXTURE_SHIFT;
+	}
+
+	u32 offset = (u32)m_instances.size();
+
+	m_instances.insert(m_instances.end(), list.m_instances.begin(), list.m_instances.end());
+
+	for (BatchSpriteCommand command : list.m_commands)
+	{
+		command.instance += offset;
+		m_commands.push_back(command);
+	}
+
+	// keep the layer, blend and cull rect of the list, only the sprites are consumed
+
+	u8 layer = list.m_layer;
+	BlendMode blend = list.m_blend;
+	bool cull = list.m_cull;
+	aabb2D cullRect = list.m_cullRect;
+
+	list.Clear();
+	list.SetLayer(layer);
+	list.SetBlend(blend);
+
+	if (cull)
+		list.SetCullRect(cullRect);
 }
 
-BatchSpriteRenderer::BatchData::BatchData()
+void BatchSpriteRenderer::SortCommands()
 {
-	quad = Mesh(DYNAMIC_HOST)
-		//.Add<vec2>(Mesh::aPosition,     { vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, 1) })
-		.Add<vec2>(Mesh::aPosition,     { vec2(-0.5f, -0.5f), vec2(0.5f, -0.5f), vec2(0.5f, 0.5f), vec2(-0.5f, 0.5f) })
-		.Add<vec2>(Mesh::aTextureCoord, { vec2( 0,  0), vec2(1,  0), vec2(1, 1), vec2( 0, 1) })
-		.Add<int> (Mesh::aIndexBuffer,  { 0, 1, 2, 0, 2, 3 })
+	// LSD radix sort on the keys, 8 bits at a time
+	// skip passes where every key has the same digit, usually most of the layer/blend bits
+
+	if (m_commands.size() < 2)
+		return;
 
-		.Add<vec4>(Mesh::aCustom_a1, 1)
-		.Add<vec4>(Mesh::aCustom_a2, 1)
-		.Add<mat4>(Mesh::aCustom_b1, 1);
+	m_commandsScratch.resize(m_commands.size());
+
+	BatchSpriteCommand* from = m_commands.data();
+	BatchSpriteCommand* to   = m_commandsScratch.data();
+	size_t count = m_commands.size();
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t offsets[256] = {};
 
-	uvs    = quad.Get(Mesh::aCustom_a1).get();
-	tints  = quad.Get(Mesh::aCustom_a2).get();
-	models = quad.Get(Mesh::aCustom_b1).get();
+		for (size_t i = 0; i < count; i++)
+			offsets[(from[i].key >> shift) & 0xff] += 1;
 
-	count = 0;
+		if (offsets[(from[0].key >> shift) & 0xff] == count)
+			continue;
+
+		size_t sum = 0;
+		for (size_t& offset : offsets)
+		{
+			size_t c = offset;
+			offset = sum;
+			sum += c;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			to[offsets[(from[i].key >> shift) & 0xff]++] = from[i];
+
+		std::swap(from, to);
+	}
+
+	if (from != m_commands.data())
+		std::swap(m_commands, m_commandsScratch);
 }
 
-void BatchSpriteRenderer::BatchData::add(const mat4& model, const vec4& uv, const vec4& tint)
+r<Texture> BatchSpriteRenderer::GetDefaultTexture() const
 {
-	uvs   ->Push(uv);
-	tints ->Push(tint);
-	models->Push(model);
+    return m_default;
+}
 
-	count += 1;
+BatchSpriteRenderer::BatchData::BatchData(GLuint quadVertices, GLuint quadIndices)
+{
+	gl(glGenBuffers(1, &instances));
+	gl(glGenVertexArrays(1, &vao));
+	gl_state_bind_vertex_array(vao);
+
+	gl(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndices));
+
+	// position and uv are interleaved
+
+	gl(glBindBuffer(GL_ARRAY_BUFFER, quadVertices));
+	gl(glEnableVertexAttribArray(0));
+	gl(glEnableVertexAttribArray(1));
+	gl(glVertexAttribPointer(0, 2, GL_FLOAT, false, sizeof(vec2) * 2, (void*)0));
+	gl(glVertexAttribPointer(1, 2, GL_FLOAT, false, sizeof(vec2) * 2, (void*)sizeof(vec2)));
+
+	// instance data
+
+	gl(glBindBuffer(GL_ARRAY_BUFFER, instances));
+	gl(glEnableVertexAttribArray(2));
+	gl(glEnableVertexAttribArray(3));
+	gl(glEnableVertexAttribArray(4));
+	gl(glEnableVertexAttribArray(5));
+	gl(glVertexAttribPointer(2, 4, GL_FLOAT,         false, sizeof(BatchSpriteInstance), (void*)offsetof(BatchSpriteInstance, uv)));
+	gl(glVertexAttribPointer(3, 4, GL_FLOAT,         false, sizeof(BatchSpriteInstance), (void*)offsetof(BatchSpriteInstance, position))); // position and rotation
+	gl(glVertexAttribPointer(4, 2, GL_FLOAT,         false, sizeof(BatchSpriteInstance), (void*)offsetof(BatchSpriteInstance, scale)));
+	gl(glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, true,  sizeof(BatchSpriteInstance), (void*)offsetof(BatchSpriteInstance, tint)));
+	gl(glVertexAttribDivisor(2, 1));
+	gl(glVertexAttribDivisor(3, 1));
+	gl(glVertexAttribDivisor(4, 1));
+	gl(glVertexAttribDivisor(5, 1));
+
+	gl_state_bind_vertex_array(0);
 }
 
-void BatchSpriteRenderer::BatchData::finalize()
+BatchSpriteRenderer::BatchData::~BatchData()
 {
-	quad.MarkForUpdate();
-	quad.DrawInstanced(count);
+	gl_state_forget_vertex_array(vao);
+	gl(glDeleteVertexArrays(1, &vao));
+	gl(glDeleteBuffers(1, &instances));
+}
 
-	uvs   ->Resize(count);
-	tints ->Resize(count);
-	models->Resize(count);
+BatchSpriteInstance* BatchSpriteRenderer::BatchData::begin(int count)
+{
+	this->count = count;
+	framesUnused = 0;
+
+	gl(glBindBuffer(GL_ARRAY_BUFFER, instances));
+
+	// only realloc the device buffer when it needs to grow
+	// otherwise invalidate it so the driver can hand back fresh memory without a stall
+
+	if (count > capacity)
+	{
+		capacity = max(count, capacity + capacity / 2);
+		gl(glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(BatchSpriteInstance), nullptr, GL_DYNAMIC_DRAW));
+	}
+
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+	BatchSpriteInstance* mapped = (BatchSpriteInstance*)gl(glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(BatchSpriteInstance), access));
+
+	return mapped;
+}
+
+void BatchSpriteRenderer::BatchData::finalize()
+{
+	gl(glBindBuffer(GL_ARRAY_BUFFER, instances));
+	gl(glUnmapBuffer(GL_ARRAY_BUFFER));
 
-	count = 0;
+	gl_state_bind_vertex_array(vao);
+	gl(glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, count));
 }
@@ -0,0 +1,854 @@
+#include "ext/rendering/Culling.h"
+#include "glm/mat4x4.hpp"
+#include <assert.h>
+#include <float.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	include <xmmintrin.h>
+#	define wCULL_SSE
+#endif
+
+//
+//	Bounds
+//
+
+CullBounds::CullBounds()
+	: min (0.f)
+	, max (0.f)
+{}
+
+CullBounds::CullBounds(vec3 min, vec3 max)
+	: min (min)
+	, max (max)
+{}
+
+CullBounds CullBounds::combine(const CullBounds& other) const
+{
+	return CullBounds(glm::min(min, other.min), glm::max(max, other.max));
+}
+
+bool CullBounds::contains(const CullBounds& other) const
+{
+	return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+		&& max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+}
+
+float CullBounds::surface_area() const
+{
+	vec3 d = max - min;
+	return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+CullResult Frustum::Test(const CullBounds& bounds) const
+{
+	CullResult result = CULL_INSIDE;
+
+	for (const vec4& plane : planes)
+	{
+		// the corners furthest along and against the normal
+		vec3 positive = vec3(plane.x > 0.f ? bounds.max.x : bounds.min.x, plane.y > 0.f ? bounds.max.y : bounds.min.y, plane.z > 0.f ? bounds.max.z : bounds.min.z);
+		vec3 negative = vec3(plane.x > 0.f ? bounds.min.x : bounds.max.x, plane.y > 0.f ? bounds.min.y : bounds.max.y, plane.z > 0.f ? bounds.min.z : bounds.max.z);
+
+		if (dot(vec3(plane), positive) + plane.w < 0.f) return CULL_OUTSIDE;
+		if (dot(vec3(plane), negative) + plane.w < 0.f) result = CULL_INTERSECTS;
+	}
+
+	return result;
+}
+
+Frustum Frustum::FromMatrix(const mat4& m)
+{
+	// rows of the matrix, glm is column major
+	vec4 row0 = vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+	vec4 row1 = vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+	vec4 row2 = vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+	vec4 row3 = vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Frustum frustum;
+	frustum.planes[0] = row3 + row0; // left
+	frustum.planes[1] = row3 - row0; // right
+	frustum.planes[2] = row3 + row1; // bottom
+	frustum.planes[3] = row3 - row1; // top
+	frustum.planes[4] = row3 + row2; // near
+	frustum.planes[5] = row3 - row2; // far
+
+	for (vec4& plane : frustum.planes)
+	{
+		plane /= length(vec3(plane));
+	}
+
+	return frustum;
+}
+
+Frustum Frustum::FromCamera(const Camera& camera)
+{
+	return FromMatrix(camera.Projection() * camera.View());
+}
+
+aabb2D CullCameraRect(const Camera& camera)
+{
+	vec2 size = camera.ScreenSize();
+	vec2 position = vec2(camera.position);
+
+	return aabb2D(position - size, position + size);
+}
+
+static bool cull_overlaps(const aabb2D& a, const aabb2D& b)
+{
+	return a.min.x <= b.max.x && a.max.x >= b.min.x
+		&& a.min.y <= b.max.y && a.max.y >= b.min.y;
+}
+
+static bool cull_contains(const aabb2D& outer, const aabb2D& inner)
+{
+	return outer.min.x <= inner.min.x && outer.max.x >= inner.max.x
+		&& outer.min.y <= inner.min.y && outer.max.y >= inner.max.y;
+}
+
+int CullRects(const aabb2D& view, const float* minX, const float* minY, const float* maxX, const float* maxY, int count, int* visible)
+{
+	int written = 0;
+	int i = 0;
+
+#ifdef wCULL_SSE
+	const __m128 viewMinX = _mm_set1_ps(view.min.x);
+	const __m128 viewMinY = _mm_set1_ps(view.min.y);
+	const __m128 viewMaxX = _mm_set1_ps(view.max.x);
+	const __m128 viewMaxY = _mm_set1_ps(view.max.y);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 outside = _mm_or_ps(
+			_mm_or_ps(_mm_cmplt_ps(_mm_loadu_ps(maxX + i), viewMinX), _mm_cmpgt_ps(_mm_loadu_ps(minX + i), viewMaxX)),
+			_mm_or_ps(_mm_cmplt_ps(_mm_loadu_ps(maxY + i), viewMinY), _mm_cmpgt_ps(_mm_loadu_ps(minY + i), viewMaxY)));
+
+		int mask = _mm_movemask_ps(outside);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (!(mask & (1 << lane))) visible[written++] = i + lane;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		bool outside = maxX[i] < view.min.x || minX[i] > view.max.x
+		            || maxY[i] < view.min.y || minY[i] > view.max.y;
+
+		if (!outside) visible[written++] = i;
+	}
+
+	return written;
+}
+
+int CullBoxes(const Frustum& frustum, const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ, int count, int* visible)
+{
+	int written = 0;
+	int i = 0;
+
+#ifdef wCULL_SSE
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x0 = _mm_loadu_ps(minX + i), x1 = _mm_loadu_ps(maxX + i);
+		__m128 y0 = _mm_loadu_ps(minY + i), y1 = _mm_loadu_ps(maxY + i);
+		__m128 z0 = _mm_loadu_ps(minZ + i), z1 = _mm_loadu_ps(maxZ + i);
+
+		__m128 outside = zero;
+
+		for (const vec4& plane : frustum.planes)
+		{
+			// the normal is the same for all 4 boxes, so the corner furthest along it is a select per plane
+			__m128 px = plane.x > 0.f ? x1 : x0;
+			__m128 py = plane.y > 0.f ? y1 : y0;
+			__m128 pz = plane.z > 0.f ? z1 : z0;
+
+			__m128 d = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane.x)), _mm_mul_ps(py, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, zero));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (!(mask & (1 << lane))) visible[written++] = i + lane;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		CullBounds bounds = CullBounds(vec3(minX[i], minY[i], minZ[i]), vec3(maxX[i], maxY[i], maxZ[i]));
+		if (frustum.Test(bounds) != CULL_OUTSIDE) visible[written++] = i;
+	}
+
+	return written;
+}
+
+//
+//	Quadtree
+//
+
+static u64 quadtree_key(int depth, int x, int y)
+{
+	return ((u64)depth << 56) | ((u64)x << 28) | (u64)y;
+}
+
+static void quadtree_unkey(u64 key, int* depth, int* x, int* y)
+{
+	*depth = (int)(key >> 56);
+	*x = (int)((key >> 28) & 0xfffffff);
+	*y = (int)(key & 0xfffffff);
+}
+
+CullQuadtree::CullQuadtree(const aabb2D& world, int maxDepth)
+	: m_world    (world)
+	, m_size     (max(world.width(), world.height()))
+	, m_maxDepth (maxDepth)
+{
+	assert(maxDepth >= 0 && maxDepth <= 27 && "Quadtree depth needs to fit in the node key");
+}
+
+int CullQuadtree::Insert(const aabb2D& bounds, u32 user)
+{
+	int proxy;
+
+	if (m_free.size() > 0)
+	{
+		proxy = m_free.back();
+		m_free.pop_back();
+	}
+
+	else
+	{
+		proxy = (int)m_proxies.size();
+		m_proxies.emplace_back();
+	}
+
+	Proxy& p = m_proxies.at(proxy);
+	p.bounds = bounds;
+	p.user = user;
+	p.alive = true;
+
+	AddToNode(proxy, PickNode(bounds));
+	m_count += 1;
+
+	return proxy;
+}
+
+void CullQuadtree::Update(int proxy, const aabb2D& bounds)
+{
+	Proxy& p = m_proxies.at(proxy);
+	assert(p.alive && "Quadtree proxy was removed");
+
+	p.bounds = bounds;
+	u64 key = PickNode(bounds);
+
+	// still in the same cell, only the bounds change
+	if (key == p.node)
+	{
+		Node& node = m_nodes.at(key);
+		node.minX[p.index] = bounds.min.x;
+		node.minY[p.index] = bounds.min.y;
+		node.maxX[p.index] = bounds.max.x;
+		node.maxY[p.index] = bounds.max.y;
+		return;
+	}
+
+	RemoveFromNode(proxy);
+	AddToNode(proxy, key);
+}
+
+void CullQuadtree::Remove(int proxy)
+{
+	Proxy& p = m_proxies.at(proxy);
+	assert(p.alive && "Quadtree proxy was removed");
+
+	RemoveFromNode(proxy);
+	p.alive = false;
+
+	m_free.push_back(proxy);
+	m_count -= 1;
+}
+
+void CullQuadtree::Query(const aabb2D& view, std::vector<u32>& visible) const
+{
+	QueryNode(quadtree_key(0, 0, 0), view, visible);
+}
+
+int CullQuadtree::Count() const
+{
+	return m_count;
+}
+
+void CullQuadtree::Clear()
+{
+	m_nodes.clear();
+	m_proxies.clear();
+	m_free.clear();
+	m_count = 0;
+}
+
+u64 CullQuadtree::PickNode(const aabb2D& bounds) const
+{
+	vec2 center = bounds.center();
+
+	if (!m_world.contains_point(center))
+	{
+		return quadtree_key(0, 0, 0);
+	}
+
+	// the deepest cell the object is no larger than, its loose bounds reach half a cell past each side
+	float extent = max(bounds.width(), bounds.height());
+	float cell = m_size;
+	int depth = 0;
+
+	while (depth < m_maxDepth && extent <= cell * .5f)
+	{
+		cell *= .5f;
+		depth += 1;
+	}
+
+	int cells = 1 << depth;
+	int x = clamp((int)((center.x - m_world.min.x) / cell), 0, cells - 1);
+	int y = clamp((int)((center.y - m_world.min.y) / cell), 0, cells - 1);
+
+	return quadtree_key(depth, x, y);
+}
+
+void CullQuadtree::AddToNode(int proxy, u64 key)
+{
+	Proxy& p = m_proxies.at(proxy);
+	Node& node = m_nodes[key];
+
+	p.node = key;
+	p.index = (int)node.proxies.size();
+
+	node.minX.push_back(p.bounds.min.x);
+	node.minY.push_back(p.bounds.min.y);
+	node.maxX.push_back(p.bounds.max.x);
+	node.maxY.push_back(p.bounds.max.y);
+	node.proxies.push_back(proxy);
+
+	// count up to the root so queries can skip empty branches
+
+	int depth, x, y;
+	quadtree_unkey(key, &depth, &x, &y);
+
+	for (; depth >= 0; depth--, x >>= 1, y >>= 1)
+	{
+		m_nodes[quadtree_key(depth, x, y)].subtreeCount += 1;
+	}
+}
+
+void CullQuadtree::RemoveFromNode(int proxy)
+{
+	Proxy& p = m_proxies.at(proxy);
+	Node& node = m_nodes.at(p.node);
+
+	// swap with the last so the arrays stay packed
+
+	int last = (int)node.proxies.size() - 1;
+
+	if (p.index != last)
+	{
+		node.minX[p.index] = node.minX[last];
+		node.minY[p.index] = node.minY[last];
+		node.maxX[p.index] = node.maxX[last];
+		node.maxY[p.index] = node.maxY[last];
+		node.proxies[p.index] = node.proxies[last];
+
+		m_proxies.at(node.proxies[p.index]).index = p.index;
+	}
+
+	node.minX.pop_back();
+	node.minY.pop_back();
+	node.maxX.pop_back();
+	node.maxY.pop_back();
+	node.proxies.pop_back();
+
+	int depth, x, y;
+	quadtree_unkey(p.node, &depth, &x, &y);
+
+	for (; depth >= 0; depth--, x >>= 1, y >>= 1)
+	{
+		auto itr = m_nodes.find(quadtree_key(depth, x, y));
+		itr->second.subtreeCount -= 1;
+
+		if (itr->second.subtreeCount == 0)
+		{
+			m_nodes.erase(itr);
+		}
+	}
+}
+
+void CullQuadtree::QueryNode(u64 key, const aabb2D& view, std::vector<u32>& visible) const
+{
+	auto itr = m_nodes.find(key);
+
+	if (itr == m_nodes.end())
+		return;
+
+	const Node& node = itr->second;
+
+	int depth, x, y;
+	quadtree_unkey(key, &depth, &x, &y);
+
+	// the root also holds objects outside of the world, so it's always searched
+	if (depth > 0)
+	{
+		aabb2D loose = LooseBounds(key);
+
+		if (!cull_overlaps(view, loose))
+			return;
+
+		if (cull_contains(view, loose))
+		{
+			AddSubtree(key, visible);
+			return;
+		}
+	}
+
+	int count = (int)node.proxies.size();
+
+	if (count > 0)
+	{
+		m_scratch.resize(count);
+		int written = CullRects(view, node.minX.data(), node.minY.data(), node.maxX.data(), node.maxY.data(), count, m_scratch.data());
+
+		for (int i = 0; i < written; i++)
+		{
+			visible.push_back(m_proxies[node.proxies[m_scratch[i]]].user);
+		}
+	}
+
+	if (depth < m_maxDepth && node.subtreeCount > count)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			QueryNode(quadtree_key(depth + 1, x * 2 + (i & 1), y * 2 + (i >> 1)), view, visible);
+		}
+	}
+}
+
+void CullQuadtree::AddSubtree(u64 key, std::vector<u32>& visible) const
+{
+	auto itr = m_nodes.find(key);
+
+	if (itr == m_nodes.end())
+		return;
+
+	const Node& node = itr->second;
+
+	for (int proxy : node.proxies)
+	{
+		visible.push_back(m_proxies[proxy].user);
+	}
+
+	int depth, x, y;
+	quadtree_unkey(key, &depth, &x, &y);
+
+	if (depth < m_maxDepth && node.subtreeCount > (int)node.proxies.size())
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			AddSubtree(quadtree_key(depth + 1, x * 2 + (i & 1), y * 2 + (i >> 1)), visible);
+		}
+	}
+}
+
+aabb2D CullQuadtree::LooseBounds(u64 key) const
+{
+	int depth, x, y;
+	quadtree_unkey(key, &depth, &x, &y);
+
+	float cell = m_size / (1 << depth);
+	vec2 center = m_world.min + (vec2(x, y) + .5f) * cell;
+
+	return aabb2D(center - cell, center + cell);
+}
+
+//
+//	BVH
+//
+
+CullBVH::CullBVH(float margin)
+	: m_margin (margin)
+{}
+
+int CullBVH::Insert(const CullBounds& bounds, u32 user)
+{
+	int leaf = AllocateNode();
+	Node& node = m_nodes[leaf];
+
+	node.tight = bounds;
+	node.bounds = CullBounds(bounds.min - m_margin, bounds.max + m_margin);
+	node.user = user;
+	node.height = 0;
+
+	InsertLeaf(leaf);
+	m_count += 1;
+
+	return leaf;
+}
+
+bool CullBVH::Update(int proxy, const CullBounds& bounds)
+{
+	Node& node = m_nodes.at(proxy);
+	assert(node.IsLeaf() && node.height == 0 && "BVH proxy was removed");
+
+	node.tight = bounds;
+
+	if (node.bounds.contains(bounds))
+		return false;
+
+	RemoveLeaf(proxy);
+	m_nodes[proxy].bounds = CullBounds(bounds.min - m_margin, bounds.max + m_margin);
+	InsertLeaf(proxy);
+
+	return true;
+}
+
+void CullBVH::Remove(int proxy)
+{
+	assert(m_nodes.at(proxy).IsLeaf() && m_nodes.at(proxy).height == 0 && "BVH proxy was removed");
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	m_count -= 1;
+}
+
+void CullBVH::Query(const Frustum& frustum, std::vector<u32>& visible) const
+{
+	if (m_root == -1)
+		return;
+
+	m_minX.clear(); m_minY.clear(); m_minZ.clear();
+	m_maxX.clear(); m_maxY.clear(); m_maxZ.clear();
+	m_users.clear();
+
+	// nodes known to be inside are pushed as ~index, so their subtree is added without testing
+	m_stack.clear();
+	m_stack.push_back(m_root);
+
+	while (m_stack.size() > 0)
+	{
+		int index = m_stack.back();
+		m_stack.pop_back();
+
+		if (index < 0)
+		{
+			const Node& node = m_nodes[~index];
+
+			if (node.IsLeaf()) visible.push_back(node.user);
+			else
+			{
+				m_stack.push_back(~node.child1);
+				m_stack.push_back(~node.child2);
+			}
+
+			continue;
+		}
+
+		const Node& node = m_nodes[index];
+
+		// leaves are gathered and tested together
+		if (node.IsLeaf())
+		{
+			m_minX.push_back(node.tight.min.x); m_minY.push_back(node.tight.min.y); m_minZ.push_back(node.tight.min.z);
+			m_maxX.push_back(node.tight.max.x); m_maxY.push_back(node.tight.max.y); m_maxZ.push_back(node.tight.max.z);
+			m_users.push_back(node.user);
+			continue;
+		}
+
+		switch (frustum.Test(node.bounds))
+		{
+			case CULL_OUTSIDE:
+				break;
+			case CULL_INSIDE:
+				m_stack.push_back(~node.child1);
+				m_stack.push_back(~node.child2);
+				break;
+			case CULL_INTERSECTS:
+				m_stack.push_back(node.child1);
+				m_stack.push_back(node.child2);
+				break;
+		}
+	}
+
+	int count = (int)m_users.size();
+
+	m_scratch.resize(count);
+	int written = CullBoxes(frustum, m_minX.data(), m_minY.data(), m_minZ.data(), m_maxX.data(), m_maxY.data(), m_maxZ.data(), count, m_scratch.data());
+
+	for (int i = 0; i < written; i++)
+	{
+		visible.push_back(m_users[m_scratch[i]]);
+	}
+}
+
+int CullBVH::Count() const
+{
+	return m_count;
+}
+
+int CullBVH::Height() const
+{
+	return m_root == -1 ? 0 : m_nodes[m_root].height;
+}
+
+void CullBVH::Clear()
+{
+	m_nodes.clear();
+	m_root = -1;
+	m_free = -1;
+	m_count = 0;
+}
+
+int CullBVH::AllocateNode()
+{
+	int index;
+
+	if (m_free != -1)
+	{
+		index = m_free;
+		m_free = m_nodes[index].parent;
+	}
+
+	else
+	{
+		index = (int)m_nodes.size();
+		m_nodes.emplace_back();
+	}
+
+	m_nodes[index] = Node();
+	return index;
+}
+
+void CullBVH::FreeNode(int node)
+{
+	m_nodes[node].parent = m_free;
+	m_nodes[node].height = -1;
+	m_free = node;
+}
+
+void CullBVH::InsertLeaf(int leaf)
+{
+	if (m_root == -1)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = -1;
+		return;
+	}
+
+	// walk down to the sibling which grows the tree's surface area the least
+
+	CullBounds leafBounds = m_nodes[leaf].bounds;
+	int index = m_root;
+
+	while (!m_nodes[index].IsLeaf())
+	{
+		const Node& node = m_nodes[index];
+
+		float area = node.bounds.surface_area();
+		float combinedArea = node.bounds.combine(leafBounds).surface_area();
+
+		float cost = 2.f * combinedArea;              // make a new parent for this node and the leaf
+		float inheritance = 2.f * (combinedArea - area); // pushing the leaf further down grows this node
+
+		auto descendCost = [&](int child)
+		{
+			const Node& c = m_nodes[child];
+			float grown = c.bounds.combine(leafBounds).surface_area();
+			return (c.IsLeaf() ? grown : grown - c.bounds.surface_area()) + inheritance;
+		};
+
+		float cost1 = descendCost(node.child1);
+		float cost2 = descendCost(node.child2);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	int sibling = index;
+	int oldParent = m_nodes[sibling].parent;
+	int newParent = AllocateNode(); // can move m_nodes
+
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].bounds = m_nodes[sibling].bounds.combine(leafBounds);
+	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].child1 = sibling;
+	m_nodes[newParent].child2 = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	if (oldParent == -1)
+	{
+		m_root = newParent;
+	}
+
+	else if (m_nodes[oldParent].child1 == sibling)
+	{
+		m_nodes[oldParent].child1 = newParent;
+	}
+
+	else
+	{
+		m_nodes[oldParent].child2 = newParent;
+	}
+
+	Refit(m_nodes[leaf].parent);
+}
+
+void CullBVH::RemoveLeaf(int leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = -1;
+		return;
+	}
+
+	int parent = m_nodes[leaf].parent;
+	int grandParent = m_nodes[parent].parent;
+	int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	if (grandParent == -1)
+	{
+		m_root = sibling;
+		m_nodes[sibling].parent = -1;
+		FreeNode(parent);
+		return;
+	}
+
+	if (m_nodes[grandParent].child1 == parent) m_nodes[grandParent].child1 = sibling;
+	else                                       m_nodes[grandParent].child2 = sibling;
+
+	m_nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+
+	Refit(grandParent);
+}
+
+void CullBVH::Refit(int index)
+{
+	while (index != -1)
+	{
+		index = Balance(index);
+
+		Node& node = m_nodes[index];
+		const Node& child1 = m_nodes[node.child1];
+		const Node& child2 = m_nodes[node.child2];
+
+		node.height = 1 + max(child1.height, child2.height);
+		node.bounds = child1.bounds.combine(child2.bounds);
+
+		index = node.parent;
+	}
+}
+
+int CullBVH::Balance(int iA)
+{
+	// rotate the taller child of A up if it's more than one level taller than the other
+
+	Node& A = m_nodes[iA];
+
+	if (A.IsLeaf() || A.height < 2)
+		return iA;
+
+	int iB = A.child1;
+	int iC = A.child2;
+	Node& B = m_nodes[iB];
+	Node& C = m_nodes[iC];
+
+	int balance = C.height - B.height;
+
+	if (balance > 1)
+	{
+		int iF = C.child1;
+		int iG = C.child2;
+		Node& F = m_nodes[iF];
+		Node& G = m_nodes[iG];
+
+		C.child1 = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+
+		if (C.parent == -1)                         m_root = iC;
+		else if (m_nodes[C.parent].child1 == iA)    m_nodes[C.parent].child1 = iC;
+		else                                        m_nodes[C.parent].child2 = iC;
+
+		// the taller grandchild stays under C
+		if (F.height > G.height)
+		{
+			C.child2 = iF;
+			A.child2 = iG;
+			G.parent = iA;
+			A.bounds = B.bounds.combine(G.bounds);
+			C.bounds = A.bounds.combine(F.bounds);
+			A.height = 1 + max(B.height, G.height);
+			C.height = 1 + max(A.height, F.height);
+		}
+
+		else
+		{
+			C.child2 = iG;
+			A.child2 = iF;
+			F.parent = iA;
+			A.bounds = B.bounds.combine(F.bounds);
+			C.bounds = A.bounds.combine(G.bounds);
+			A.height = 1 + max(B.height, F.height);
+			C.height = 1 + max(A.height, G.height);
+		}
+
+		return iC;
+	}
+
+	if (balance < -1)
+	{
+		int iD = B.child1;
+		int iE = B.child2;
+		Node& D = m_nodes[iD];
+		Node& E = m_nodes[iE];
+
+		B.child1 = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+
+		if (B.parent == -1)                         m_root = iB;
+		else if (m_nodes[B.parent].child1 == iA)    m_nodes[B.parent].child1 = iB;
+		else                                        m_nodes[B.parent].child2 = iB;
+
+		if (D.height > E.height)
+		{
+			B.child2 = iD;
+			A.child1 = iE;
+			E.parent = iA;
+			A.bounds = C.bounds.combine(E.bounds);
+			B.bounds = A.bounds.combine(D.bounds);
+			A.height = 1 + max(C.height, E.height);
+			B.height = 1 + max(A.height, D.height);
+		}
+
+		else
+		{
+			B.child2 = iE;
+			A.child1 = iD;
+			D.parent = iA;
+			A.bounds = C.bounds.combine(D.bounds);
+			B.bounds = A.bounds.combine(E.bounds);
+			A.height = 1 + max(C.height, D.height);
+			B.height = 1 + max(A.height, E.height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
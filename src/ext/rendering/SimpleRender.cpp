@@ -8,6 +8,7 @@ r<ShaderProgram> meshProgram;
 std::unordered_map<int, Color> spriteColors;
 ShowEntityIdMode drawEntityIdMode;
 r<BatchSpriteRenderer> spriteRender;
+std::vector<u32> spriteVisible; // ids from a SpriteCullIndex
 
 // lines
 r<BatchLineRenderer> lineRender;
@@ -115,13 +116,39 @@ void RenderMeshes(const Camera& camera, EntityWorld& world)
     }
 }
 
+static void RenderParticles(BatchSpriteRenderer& render, const Camera& camera, EntityWorld& world)
+{
+	Render::SetAlphaBlend(false);
+
+	for (auto [t, p] : world.Query<Transform2D, Particle>())
+	{
+		if (p.HasAtlas())
+		{
+			const TextureAtlas::Bounds& uv = p.GetCurrentFrameUV();
+
+			a<TextureAtlas>& atlas = p.atlas;
+			a<Texture>& source = atlas->source;
+			r<Texture> s = source;
+
+			render.SubmitTexture(t, s, uv.uvOffset, uv.uvScale, p.GetTint());
+		}
+
+		else
+		{
+			render.SubmitColor(t, p.GetTint());
+		}
+	}
+
+	render.Draw(camera, drawEntityIdMode == ONLY);
+}
+
 void RenderSprites(BatchSpriteRenderer& render, const Camera& camera, EntityWorld& world)
 {
 	render.Begin();
 
 	// draw sprites
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	Render::SetAlphaBlend(true);
 		
 	for (auto [entity, transform, sprite] : world.QueryWithEntity<Transform2D, Sprite>())
 	{
@@ -132,28 +159,35 @@ void RenderSprites(BatchSpriteRenderer& render, const Camera& camera, EntityWorl
 
 	// draw particles
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	RenderParticles(render, camera, world);
+}
 
-	for (auto [t, p] : world.Query<Transform2D, Particle>())
-	{
-		if (p.HasAtlas())
-		{
-			const TextureAtlas::Bounds& uv = p.GetCurrentFrameUV();
+void RenderSprites(BatchSpriteRenderer& render, const Camera& camera, EntityWorld& world, SpriteCullIndex& index)
+{
+	spriteVisible.clear();
 
-			a<TextureAtlas>& atlas = p.atlas;
-			a<Texture>& source = atlas->source;
-			r<Texture> s = source;
+	index.Sync(world);
+	index.Query(CullCameraRect(camera), spriteVisible);
 
-			render.SubmitTexture(t, s, uv.uvOffset, uv.uvScale, p.GetTint());
-		}
+	render.Begin();
 
-		else
-		{
-			render.SubmitColor(t, p.GetTint());
-		}
+	// draw sprites, only the ones the camera sees
+
+	Render::SetAlphaBlend(true);
+
+	for (u32 id : spriteVisible)
+	{
+		Entity entity = world.Wrap(id);
+		Sprite& sprite = entity.Get<Sprite>();
+
+		render.SubmitTexture(entity.Get<Transform2D>(), sprite.source, sprite.uvOffset, sprite.uvScale, TintToDebugMode(entity, sprite));
 	}
 
 	render.Draw(camera, drawEntityIdMode == ONLY);
+
+	// draw particles
+
+	RenderParticles(render, camera, world);
 }
 
 void RenderLines(BatchLineRenderer& render, const Camera& camera, EntityWorld& world)
@@ -173,6 +207,11 @@ void RenderSprites(const Camera& camera, EntityWorld& world)
 	RenderSprites(*spriteRender, camera, world);
 }
 
+void RenderSprites(const Camera& camera, EntityWorld& world, SpriteCullIndex& index)
+{
+	RenderSprites(*spriteRender, camera, world, index);
+}
+
 void RenderLines(const Camera& camera, EntityWorld& world)
 {
 	RenderLines(*lineRender, camera, world);
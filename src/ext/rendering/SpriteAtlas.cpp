@@ -0,0 +1,89 @@
+#include "ext/rendering/SpriteAtlas.h"
+
+// leave a pixel between textures so neighbours don't bleed when filtering
+constexpr int ATLAS_PADDING = 1;
+
+SpriteAtlas::SpriteAtlas(int pageSize, int maxTextureSize, TextureCachePacker packer)
+	: m_pageSize       (pageSize)
+	, m_maxTextureSize (maxTextureSize)
+	, m_packer         (packer)
+{}
+
+bool SpriteAtlas::Get(const r<Texture>& texture, SpriteAtlasEntry* entry)
+{
+	auto itr = m_entries.find(texture.get());
+	if (itr != m_entries.end())
+	{
+		if (itr->second.texture.lock() == texture)
+		{
+			*entry = itr->second.entry;
+			return true;
+		}
+
+		m_entries.erase(itr); // old texture was freed, its space in the page is lost until the atlas is recreated
+	}
+
+	bool canAdd = texture->OnHost()
+		&& texture->IsStatic()
+		&& texture->UsageType() == Texture::uRGBA
+		&& texture->Width()  <= m_maxTextureSize
+		&& texture->Height() <= m_maxTextureSize;
+
+	if (!canAdd)
+		return false;
+
+	char* pixels = (char*)texture->Pixels();
+	int width = texture->Width();
+	int height = texture->Height();
+
+	// try the newest page first, older pages are usually full
+
+	TextureCacheImg img;
+	img.handle = 0;
+
+	int page = (int)m_pages.size() - 1;
+	if (page >= 0)
+		img = m_pages.back().TryAdd(pixels, width, height, 4);
+
+	if (img.handle == 0)
+	{
+		m_pages.emplace_back(m_pageSize, m_pageSize, 4, m_packer, ATLAS_PADDING);
+		m_pages.back().SendToDevice(); // create the device texture so the page has a handle
+
+		page = (int)m_pages.size() - 1;
+		img = m_pages.back().TryAdd(pixels, width, height, 4);
+	}
+
+	if (img.handle == 0)
+		return false;
+
+	Entry& added = m_entries[texture.get()];
+	added.texture = texture;
+	added.entry.page = page;
+	added.entry.uvOffset = img.offset;
+	added.entry.uvScale = img.scale;
+
+	*entry = added.entry;
+	return true;
+}
+
+void SpriteAtlas::SendToDevice()
+{
+	for (TextureCache& page : m_pages)
+		page.SendToDevice();
+}
+
+int SpriteAtlas::NumberOfPages() const
+{
+	return (int)m_pages.size();
+}
+
+int SpriteAtlas::PageHandle(int page) const
+{
+	return m_pages.at(page).GetTexture()->DeviceHandle();
+}
+
+r<Texture> SpriteAtlas::PageTexture(int page) const
+{
+	return m_pages.at(page).GetTexture();
+}
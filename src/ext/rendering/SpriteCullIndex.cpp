@@ -0,0 +1,73 @@
+#include "ext/rendering/SpriteCullIndex.h"
+#include "ext/rendering/Sprite.h"
+
+SpriteCullIndex::SpriteCullIndex(const aabb2D& world, int maxDepth)
+	: m_tree (world, maxDepth)
+{}
+
+void SpriteCullIndex::Sync(EntityWorld& world)
+{
+	m_stamp += 1;
+
+	for (auto [entity, transform, sprite] : world.QueryWithEntity<Transform2D, Sprite>())
+	{
+		u32 id = entity.Id();
+		aabb2D bounds = SpriteBounds(transform);
+
+		auto [itr, added] = m_entries.try_emplace(id);
+		Entry& entry = itr->second;
+
+		if (added)
+		{
+			entry.proxy = m_tree.Insert(bounds, id);
+			entry.bounds = bounds;
+		}
+
+		else if (   entry.bounds.min.x != bounds.min.x || entry.bounds.min.y != bounds.min.y
+		         || entry.bounds.max.x != bounds.max.x || entry.bounds.max.y != bounds.max.y)
+		{
+			m_tree.Update(entry.proxy, bounds);
+			entry.bounds = bounds;
+		}
+
+		entry.stamp = m_stamp;
+	}
+
+	// ids include the entity's version, so a reused entity is a new entry and the old one is removed here
+
+	for (auto itr = m_entries.begin(); itr != m_entries.end();)
+	{
+		if (itr->second.stamp != m_stamp)
+		{
+			m_tree.Remove(itr->second.proxy);
+			itr = m_entries.erase(itr);
+		}
+
+		else
+		{
+			++itr;
+		}
+	}
+}
+
+void SpriteCullIndex::Query(const aabb2D& view, std::vector<u32>& visible) const
+{
+	m_tree.Query(view, visible);
+}
+
+int SpriteCullIndex::Count() const
+{
+	return (int)m_entries.size();
+}
+
+void SpriteCullIndex::Clear()
+{
+	m_tree.Clear();
+	m_entries.clear();
+}
+
+aabb2D SpriteCullIndex::SpriteBounds(const Transform2D& transform)
+{
+	float r = abs(transform.scale.x) + abs(transform.scale.y);
+	return aabb2D(transform.position - vec2(r), transform.position + vec2(r));
+}
@@ -0,0 +1,143 @@
+#include "ext/rendering/TextureLoader.h"
+#include <climits>
+
+TextureLoader::TextureLoader(int threadCount)
+	: m_pool (threadCount)
+{}
+
+TextureLoader::~TextureLoader()
+{
+	// let the workers finish what they've started, the placeholders are left in place
+	m_pool.shutdown();
+}
+
+a<Texture> TextureLoader::Load(const std::string& filename, const Callback& onLoaded, bool sendToDevice, bool isStatic)
+{
+	std::string name = ::_ar(filename);
+
+	if (Asset::Has(name))
+	{
+		a<Texture> asset = Asset::Get<Texture>(name);
+
+		for (r<Pending>& pending : m_pending)
+		{
+			if (pending->name == name)
+			{
+				if (onLoaded) pending->callbacks.push_back(onLoaded);
+				return asset;
+			}
+		}
+
+		if (onLoaded) onLoaded(asset);
+		return asset;
+	}
+
+	std::string path = ::_a(filename);
+
+	if (!std::filesystem::exists(std::filesystem::path(path)))
+	{
+		log_io("w~Failed to load texture from file: '%s'", path.c_str());
+		return a<Texture>();
+	}
+
+	// the placeholder isn't static so it keeps its host memory if something sends it to the device
+	a<Texture> asset = Asset::Make<Texture>(name, 1, 1, Texture::uRGBA, false);
+	asset->ClearHost(Color(0, 0, 0, 0));
+
+	r<Pending> pending = mkr<Pending>();
+	pending->name = name;
+	pending->target = asset.ref();
+	pending->sendToDevice = sendToDevice;
+	if (onLoaded) pending->callbacks.push_back(onLoaded);
+
+	m_pending.push_back(pending);
+
+	m_pool.thread([this, pending, path, isStatic]()
+	{
+		pending->decoded = mkr<Texture>(path, isStatic);
+
+		std::unique_lock lock(m_decodedMutex);
+		m_decoded.push_back(pending);
+	});
+
+	return asset;
+}
+
+void TextureLoader::Update(int uploadBudget)
+{
+	std::vector<r<Pending>> finished;
+
+	{
+		std::unique_lock lock(m_decodedMutex);
+
+		int bytes = 0;
+		int count = 0;
+
+		for (; count < (int)m_decoded.size(); count++)
+		{
+			const r<Pending>& pending = m_decoded.at(count);
+			int size = pending->sendToDevice ? pending->decoded->BufferSize() : 0;
+
+			if (count > 0 && bytes + size > uploadBudget)
+				break;
+
+			bytes += size;
+		}
+
+		finished.assign(m_decoded.begin(), m_decoded.begin() + count);
+		m_decoded.erase(m_decoded.begin(), m_decoded.begin() + count);
+	}
+
+	for (r<Pending>& pending : finished)
+	{
+		std::erase(m_pending, pending);
+		Finish(*pending);
+	}
+}
+
+void TextureLoader::Flush()
+{
+	m_pool.wait();
+	Update(INT_MAX);
+}
+
+bool TextureLoader::IsLoading(const a<Texture>& texture) const
+{
+	const r<Texture> target = texture.ref();
+
+	for (const r<Pending>& pending : m_pending)
+	{
+		if (pending->target == target)
+			return true;
+	}
+
+	return false;
+}
+
+int TextureLoader::NumberLoading() const
+{
+	return (int)m_pending.size();
+}
+
+void TextureLoader::Finish(Pending& pending)
+{
+	// swap the decoded texture into the placeholder, so every copy of the asset sees it
+	pending.target->Cleanup();
+	*pending.target = std::move(*pending.decoded);
+	pending.decoded = nullptr;
+
+	if (pending.sendToDevice)
+	{
+		pending.target->SendToDevice();
+	}
+
+	// the asset might have been freed while loading, still give the texture to the callbacks
+	a<Texture> asset = Asset::Has(pending.name)
+		? Asset::Get<Texture>(pending.name)
+		: a<Texture>(pending.target);
+
+	for (Callback& callback : pending.callbacks)
+	{
+		callback(asset);
+	}
+}
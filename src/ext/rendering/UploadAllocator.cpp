@@ -0,0 +1,98 @@
+#include "ext/rendering/UploadAllocator.h"
+#include "util/error_check.h" // gives gl
+#include "util/gl_state.h"
+#include "util/math.h"
+
+UploadAllocator::UploadAllocator(int framesInFlight)
+{
+	m_frames.resize(max(1, framesInFlight));
+}
+
+UploadAllocator::~UploadAllocator()
+{
+	for (Frame& frame : m_frames)
+	{
+		if (frame.buffer)
+		{
+			gl(glDeleteBuffers(1, &frame.buffer));
+		}
+	}
+}
+
+UploadAllocation UploadAllocator::Allocate(int bytes, int alignment)
+{
+	int offset = m_used;
+
+	if (alignment > 1)
+	{
+		offset = (offset + alignment - 1) / alignment * alignment;
+	}
+
+	int end = offset + bytes;
+
+	// grow by half again so the staging memory settles on the largest frame
+	if (end > (int)m_staging.size())
+	{
+		m_staging.resize(max(end, (int)m_staging.size() + (int)m_staging.size() / 2));
+		gl_state_count_upload(0, true);
+	}
+
+	m_used = end;
+
+	UploadAllocation allocation;
+	allocation.data = m_staging.data() + offset;
+	allocation.offset = offset;
+	allocation.bytes = bytes;
+
+	return allocation;
+}
+
+void UploadAllocator::Flush()
+{
+	if (m_used == m_flushed)
+		return;
+
+	Frame& frame = m_frames.at(m_current);
+
+	if (!frame.buffer)
+	{
+		gl(glGenBuffers(1, &frame.buffer));
+	}
+
+	gl(glBindBuffer(GL_ARRAY_BUFFER, frame.buffer));
+
+	// if the buffer has to grow, the ranges flushed earlier this frame need to be uploaded again
+	// draws already issued keep using the old storage
+
+	if (m_used > frame.capacity)
+	{
+		frame.capacity = max(m_used, (int)m_staging.size());
+		gl(glBufferData(GL_ARRAY_BUFFER, frame.capacity, nullptr, GL_STREAM_DRAW));
+		gl_state_count_upload(0, true);
+
+		m_flushed = 0;
+	}
+
+	int bytes = m_used - m_flushed;
+	gl(glBufferSubData(GL_ARRAY_BUFFER, m_flushed, bytes, m_staging.data() + m_flushed));
+	gl_state_count_upload(bytes, false);
+
+	m_flushed = m_used;
+}
+
+void UploadAllocator::NextFrame()
+{
+	m_current = (m_current + 1) % (int)m_frames.size();
+	m_used = 0;
+	m_flushed = 0;
+}
+
+GLuint UploadAllocator::DeviceHandle() const
+{
+	return m_frames.at(m_current).buffer;
+}
+
+int UploadAllocator::Used() const
+{
+	return m_used;
+}
@@ -3,12 +3,58 @@
 
 namespace meta
 {
+	//
+	//	type
+	//
+
+	bool type::is_packed() const
+	{
+		int generation = types_generation();
+
+		if (m_info->m_packed_generation == generation)
+		{
+			return m_info->m_is_packed;
+		}
+
+		const type* base = get_type();
+		bool packed = m_info->m_is_trivial && !base->has_custom_write() && !base->has_custom_read();
+
+		if (packed && base->is_complex())
+		{
+			// classes without members write nothing
+			auto& members = base->get_members();
+			size_t offset = 0;
+
+			packed = members.size() > 0;
+
+			for (int i = 0; i < (int)members.size() && packed; i++)
+			{
+				meta::type* member = members.at(i);
+
+				packed = member->member_offset() == offset && member->is_packed();
+				offset += member->info()->m_size;
+			}
+
+			packed = packed && offset == m_info->m_size;
+		}
+
+		m_info->m_is_packed = packed;
+		m_info->m_packed_generation = generation;
+
+		return packed;
+	}
+
 	//
 	//	serial_writer
 	//
 
 	void serial_writer::write_class(meta::type* type, const void* instance)
 	{
+		if (type->is_complex() && write_packed(type, instance, 1)) // plain data
+		{
+			return;
+		}
+
 		if (!type->get_type()->is_complex() || type->get_type()->has_custom_write()) // simple / custom
 		{
 			type->_serial_write(this, instance);
@@ -19,13 +65,13 @@ namespace meta
 			class_begin(type);
 
 			auto& members = type->get_members();
-			for (int i = 0; i < members.size(); i++)
+			for (int i = 0; i < (int)members.size(); i++)
 			{
 				meta::type* member = members.at(i);
 
 				write_member(member, member->walk_ptr(instance), member->member_name());
 
-				if (i != members.size() - 1)
+				if (i != (int)members.size() - 1)
 				{
 					class_delim();
 				}
@@ -46,7 +92,13 @@ namespace meta
 	{
 		array_begin(type, length);
 
-		for (int i =  0; i < length; i++)
+		if (write_packed(type, instance, length))
+		{
+			array_end();
+			return;
+		}
+
+		for (size_t i = 0; i < length; i++)
 		{
 			write_class(type, (char*)instance + i * type->info()->m_size);
 
@@ -66,6 +118,11 @@ namespace meta
 		string_end();
 	}
 
+	bool serial_writer::write_packed(type* /*type*/, const void* /*instance*/, size_t /*count*/)
+	{
+		return false;
+	}
+
 	pseudo_writer serial_writer::pseudo()
 	{
 		return pseudo_writer(this);
@@ -77,6 +134,11 @@ namespace meta
 
 	void serial_reader::read_class(type* type, void* instance)
 	{
+		if (type->is_complex() && read_packed(type, instance, 1)) // plain data
+		{
+			return;
+		}
+
 		if (!type->get_type()->is_complex() || type->get_type()->has_custom_read()) // simple / custom
 		{
 			type->_serial_read(this, instance);
@@ -90,13 +152,13 @@ namespace meta
 			type->construct(instance);
 
 			auto& members = type->get_members();
-			for (int i = 0; i < members.size(); i++)
+			for (int i = 0; i < (int)members.size(); i++)
 			{
 				meta::type* member = members.at(i);
 
 				read_member(member, member->walk_ptr(instance), member->member_name());
 
-				if (i != members.size() - 1)
+				if (i != (int)members.size() - 1)
 				{
 					class_delim();
 				}
@@ -117,7 +179,13 @@ namespace meta
 	{
 		array_begin(type, length);
 
-		for (int i =  0; i < length; i++)
+		if (read_packed(type, instance, length))
+		{
+			array_end();
+			return;
+		}
+
+		for (size_t i = 0; i < length; i++)
 		{
 			read_class(type, (char*)instance + i * type->info()->m_size);
 
@@ -137,6 +205,11 @@ namespace meta
 		string_end();
 	}
 
+	bool serial_reader::read_packed(type* /*type*/, void* /*instance*/, size_t /*count*/)
+	{
+		return false;
+	}
+
 	pseudo_reader serial_reader::pseudo()
 	{
 		return pseudo_reader(this);
@@ -243,6 +316,18 @@ namespace meta
 
 		reg.rtype = type;
 		reg.location = GetContextLocation();
+
+		types_changed();
+	}
+
+	void types_changed()
+	{
+		ctx->generation += 1;
+	}
+
+	int types_generation()
+	{
+		return ctx->generation;
 	}
 
 	bool has_registered_type(id_type id)
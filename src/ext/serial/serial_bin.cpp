@@ -28,6 +28,15 @@ void bin_writer::write_bytes(const char* bytes, size_t length)
     m_out.write(bytes, length);
 }
 
+bool bin_writer::write_packed(meta::type* type, const void* instance, size_t count)
+{
+	if (!type->is_packed())
+		return false;
+
+	write_bytes((const char*)instance, count * type->info()->m_size);
+	return true;
+}
+
 //
 //		Reader
 //
@@ -61,3 +70,12 @@ void bin_reader::read_bytes(char* bytes, size_t length)
 {
     m_in.read(bytes, length);
 }
+
+bool bin_reader::read_packed(meta::type* type, void* instance, size_t count)
+{
+	if (!type->is_packed())
+		return false;
+
+	read_bytes((char*)instance, count * type->info()->m_size);
+	return true;
+}
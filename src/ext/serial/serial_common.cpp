@@ -66,6 +66,38 @@ void read_Rigidbody2D(meta::serial_reader* serial, Rigidbody2D& instance)
     instance.SetPreInit(def);
 }
 
+void write_PhysicsSnapshot(meta::serial_writer* serial, const PhysicsSnapshot& instance)
+{
+	size_t size = instance.bytes.size();
+
+	serial->pseudo()
+		.begin<PhysicsSnapshot>()
+		.member("size", size)
+		.custom<u8>("bytes", [&]() { serial->write_bytes((const char*)instance.bytes.data(), size); })
+		.end();
+}
+
+void read_PhysicsSnapshot(meta::serial_reader* serial, PhysicsSnapshot& instance)
+{
+	size_t size;
+
+	meta::pseudo_reader r = serial->pseudo()
+		.begin<PhysicsSnapshot>()
+		.member("size", size);
+
+	// snapshots are restored with an int size, anything bigger is a bad file
+	if (size > (size_t)INT_MAX)
+	{
+		log_io("e~Failed to read PhysicsSnapshot reason: Size %zu is too large", size);
+		size = 0;
+	}
+
+	instance.bytes.resize(size);
+
+	r.custom<u8>("bytes", [&]() { serial->read_bytes((char*)instance.bytes.data(), size); })
+	 .end();
+}
+
 void write_CircleCollider(meta::serial_writer * writer, const CircleCollider& instance)
 {
 	vec2 center = instance.GetCenter();
@@ -297,6 +329,11 @@ void register_common_types()
 		.custom_read(&read_Rigidbody2D)
 		.custom_write(&write_Rigidbody2D);
 
+	describe<PhysicsSnapshot>()
+		.name("PhysicsSnapshot")
+		.custom_write(&write_PhysicsSnapshot)
+		.custom_read(&read_PhysicsSnapshot);
+
 	describe<CircleCollider>()
 		.name("CircleCollider")
 		.custom_write(&write_CircleCollider)
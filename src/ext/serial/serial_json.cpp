@@ -1,7 +1,7 @@
 #include "ext/serial/serial_json.h"
-#include "json/json.h"
 #include <string.h>
-#include <sstream>
+#include <stdlib.h>
+#include <iterator>
 
 // for debug
 #include "Log.h"
@@ -45,73 +45,144 @@ void json_writer::write_bytes(const char* bytes, size_t length)
 //		Reader
 //
 
-json_value_s* json_reader::json_frame::get_value()
+static const char* json_skip_space(const char* p)
 {
-	switch (what)
+	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+	return p;
+}
+
+static int json_hex(const char* p)
+{
+	int value = 0;
+
+	for (int i = 0; i < 4; i++)
 	{
-		case 0: return value;
-		case 1: return item->value;
-		case 2: return member->value;
+		char c = p[i];
+		value <<= 4;
+
+		     if (c >= '0' && c <= '9') value |= c - '0';
+		else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+		else return -1;
 	}
-    
-    return nullptr;
+
+	return value;
 }
 
 json_reader::json_reader(std::istream& in)
 	: meta::serial_reader (in, true)
-	//, m_json              (nullptr)
+	, m_at                (nullptr)
 {
-	std::stringstream ss; ss << m_in.rdbuf();
-	std::string str = ss.str(); // big copy?
-	
-	m_frames.emplace(nullptr, json_parse(str.c_str(), str.size()));
+	// read the stream once, sized up front if it can seek
+	std::streampos start = m_in.tellg();
+	m_in.seekg(0, std::ios::end);
+	std::streampos end = m_in.tellg();
+
+	if (start != std::streampos(-1) && end != std::streampos(-1))
+	{
+		m_json.resize((size_t)(end - start));
+		m_in.seekg(start);
+		m_in.read(m_json.data(), m_json.size());
+		m_json.resize((size_t)m_in.gcount()); // text mode can read less than the size
+	}
+
+	else
+	{
+		m_in.clear();
+		m_json.assign(std::istreambuf_iterator<char>(m_in), std::istreambuf_iterator<char>());
+	}
+
+	m_at = m_json.c_str();
+	m_frames.push(json_frame { nullptr, fValue, false });
 }
 
 void json_reader::class_begin(meta::type* type)
 {
-	m_frames.emplace(type, json_value_as_object(m_frames.top().get_value())->start);
+	expect('{');
+	m_frames.push(json_frame { type, fObject, false });
 }
 
 void json_reader::class_delim()
 {
-	// increment object frame
-	json_frame& frame = m_frames.top();
-	frame.member = frame.member->next;
+	skip_space();
+	if (*m_at == ',') m_at++;
 }
 
 void json_reader::class_end()
 {
-	// remove object frame
+	// skip members which weren't read, their keys and values
+	skip_space();
+	while (*m_at && *m_at != '}')
+	{
+		if (*m_at == ']') // mismatched, let the array this is in close
+		{
+			log_io("e~JSON: expected '}' at %d", (int)(m_at - m_json.c_str()));
+			break;
+		}
+
+		if (*m_at == ',' || *m_at == ':') m_at++;
+		else                              m_at = skip_value(m_at);
+
+		skip_space();
+	}
+
+	expect('}');
 	m_frames.pop();
+	consumed();
 }
 
 void json_reader::member_begin(meta::type* type, const char* name)
 {
-	m_frames.emplace(type, m_frames.top().get_value());
+	// members are read in order, so the key isn't checked
+	skip_space();
+	if (*m_at == '"') m_at = skip_string(m_at);
+	expect(':');
+
+	m_frames.push(json_frame { type, fValue, false });
 }
 
 void json_reader::member_end()
 {
-	// remove member frame
+	if (!m_frames.top().consumed)
+	{
+		m_at = skip_value(m_at);
+	}
+
 	m_frames.pop();
 }
 
 void json_reader::array_begin(meta::type* type, size_t length)
 {
-	m_frames.emplace(type, json_value_as_array(m_frames.top().get_value())->start);
+	expect('[');
+	m_frames.push(json_frame { type, fArray, false });
 }
 
 void json_reader::array_delim()
 {
-	// increment array frame
-	json_frame& frame = m_frames.top();
-	frame.item = frame.item->next;
+	skip_space();
+	if (*m_at == ',') m_at++;
 }
 
 void json_reader::array_end()
 {
-	// remove array frame
+	skip_space();
+	while (*m_at && *m_at != ']')
+	{
+		if (*m_at == '}') // mismatched, let the object this is in close
+		{
+			log_io("e~JSON: expected ']' at %d", (int)(m_at - m_json.c_str()));
+			break;
+		}
+
+		if (*m_at == ',') m_at++;
+		else              m_at = skip_value(m_at);
+
+		skip_space();
+	}
+
+	expect(']');
 	m_frames.pop();
+	consumed();
 }
 
 void json_reader::string_begin(size_t length)
@@ -126,43 +197,99 @@ void json_reader::string_end()
 
 size_t json_reader::read_length()
 {
-	json_value_s* jvalue = m_frames.top().get_value();
+	skip_space();
 
-	switch (jvalue->type)
+	switch (*m_at)
 	{
-		case json_type_e::json_type_string: return json_value_as_string(jvalue)->string_size;
-		case json_type_e::json_type_array:  return json_value_as_array (jvalue)->length;
+		case '"': 
+		{
+			return read_string(m_at, nullptr, 0);
+		}
+
+		case '[':
+		{
+			// count the items without reading them
+			const char* p = json_skip_space(m_at + 1);
+			size_t length = 0;
+
+			while (*p && *p != ']')
+			{
+				p = json_skip_space(skip_value(p));
+				length += 1;
+
+				if (*p == ',') p = json_skip_space(p + 1);
+				else           break;
+			}
+
+			return length;
+		}
 	}
 
-	assert(false && "json type has no size");
+	// the data doesn't match the type, read it as empty and the value is skipped
+	log_io("e~JSON: expected a string or array at %d", (int)(m_at - m_json.c_str()));
 	return 0;
 }
 
 void json_reader::read_bytes(char* bytes, size_t length)
 {
-	json_value_s* jvalue = m_frames.top().get_value();
+	skip_space();
 
-	switch (jvalue->type)
+	switch (*m_at)
 	{
-		case json_type_e::json_type_string:
+		case '"':
 		{
-			json_string_s* jstring = json_value_as_string(jvalue);
-			memcpy(bytes, jstring->string, length);
+			read_string(m_at, bytes, length);
+			m_at = skip_string(m_at);
+			break;
+		}
+
+		case 't':
+		case 'f':
+		case 'n':
+		{
+			// strncmp stops at the end of the buffer, so a truncated literal isn't stepped over
+			     if (strncmp(m_at, "true",  4) == 0) { *bytes = (char)true;  m_at += 4; }
+			else if (strncmp(m_at, "false", 5) == 0) { *bytes = (char)false; m_at += 5; }
+			else if (strncmp(m_at, "null",  4) == 0) {                       m_at += 4; }
+
+			else
+			{
+				log_io("e~JSON: invalid literal at %d", (int)(m_at - m_json.c_str()));
+				m_at = skip_value(m_at);
+			}
 
-			log_io("JSON: read string %s", jstring->string);
 			break;
 		}
 
-		case json_type_e::json_type_number:
+		case '{':
+		case '[':
+		{
+			// the data doesn't match the type, skip the whole value
+			log_io("e~JSON: expected a value at %d", (int)(m_at - m_json.c_str()));
+			m_at = skip_value(m_at);
+			break;
+		}
+
+		case '}':
+		case ']':
+		case ',':
+		case '\0':
+		{
+			// missing value, leave the closer for class_end/array_end
+			log_io("e~JSON: expected a value at %d", (int)(m_at - m_json.c_str()));
+			break;
+		}
+
+		default:
 		{
-			json_number_s* jnumber = json_value_as_number(jvalue);
 			meta::type* type = m_frames.top().type;
+			assert(type && "json number was read without a type");
 
 			if (type->info()->m_is_floating)
 			{		
-				     if (meta::is_same<     float> (type)) *(      float*)bytes = std::stof (jnumber->number);
-				else if (meta::is_same<     double>(type)) *(     double*)bytes = std::stod (jnumber->number);
-				else if (meta::is_same<long double>(type)) *(long double*)bytes = std::stold(jnumber->number);
+				     if (meta::is_same<     float> (type)) *(      float*)bytes = strtof (m_at, nullptr);
+				else if (meta::is_same<     double>(type)) *(     double*)bytes = strtod (m_at, nullptr);
+				else if (meta::is_same<long double>(type)) *(long double*)bytes = strtold(m_at, nullptr);
 							
 				else
 				{
@@ -172,42 +299,164 @@ void json_reader::read_bytes(char* bytes, size_t length)
 			
 			else
 			{
-				unsigned long long largest = std::stoull(jnumber->number);
+				unsigned long long largest = strtoull(m_at, nullptr, 10);
 				memcpy(bytes, &largest, type->info()->m_size);
 			}
 
-			log_io("JSON: read number %s", jnumber->number);
+			m_at = skip_value(m_at);
 			break;
 		}
+	}
 
-		case json_type_e::json_type_false:
-		{
-			*bytes = (char)false;
+	consumed();
+}
 
-			log_io("JSON: read false");
-			break;
+void json_reader::skip_space()
+{
+	m_at = json_skip_space(m_at);
+}
+
+bool json_reader::expect(char c)
+{
+	skip_space();
+
+	if (*m_at != c)
+	{
+		log_io("e~JSON: expected '%c' at %d", c, (int)(m_at - m_json.c_str()));
+		return false;
+	}
+
+	m_at++;
+	return true;
+}
+
+void json_reader::consumed()
+{
+	json_frame& frame = m_frames.top();
+	if (frame.kind == fValue) frame.consumed = true;
+}
+
+const char* json_reader::skip_value(const char* p) const
+{
+	p = json_skip_space(p);
+
+	switch (*p)
+	{
+		case '"':
+		{
+			return skip_string(p);
 		}
 
-		case json_type_e::json_type_true:
+		case '{':
+		case '[':
 		{
-			*bytes = (char)true;
+			int depth = 0;
 
-			log_io("JSON: read true");
-			break;
-		}
+			while (*p)
+			{
+				switch (*p)
+				{
+					case '"': p = skip_string(p); continue;
+					case '{':
+					case '[': depth += 1; break;
+					case '}':
+					case ']': depth -= 1; break;
+				}
 
-		//case json_type_e::json_type_object: // why was this necessary?
-		//{
-		//	meta::type* type = m_frames.top().type;
-		//	read_class(type, bytes);
+				p++;
 
-		//	log_io("JSON: read object");
-		//	break;
-		//}
+				if (depth == 0)
+					break;
+			}
+
+			return p;
+		}
 
 		default:
 		{
-			assert(false && "json type wasn't valid");
+			// always move forward, a stray closer or comma would stall the loops in class_end/array_end
+			const char* start = p;
+			while (*p && !strchr(",}] \t\n\r", *p)) p++;
+			return (p == start && *p) ? p + 1 : p;
+		}
+	}
+}
+
+const char* json_reader::skip_string(const char* p) const
+{
+	p++; // "
+
+	while (*p && *p != '"')
+	{
+		p += (*p == '\\' && p[1]) ? 2 : 1;
+	}
+
+	return *p ? p + 1 : p;
+}
+
+size_t json_reader::read_string(const char* p, char* out, size_t capacity) const
+{
+	size_t length = 0;
+
+	auto put = [&](char c)
+	{
+		if (out && length < capacity) out[length] = c;
+		length += 1;
+	};
+
+	p++; // "
+
+	while (*p && *p != '"')
+	{
+		if (*p != '\\')
+		{
+			put(*p++);
+			continue;
 		}
+
+		p++;
+
+		switch (*p)
+		{
+			case 'b': put('\b'); break;
+			case 'f': put('\f'); break;
+			case 'n': put('\n'); break;
+			case 'r': put('\r'); break;
+			case 't': put('\t'); break;
+			case 'u':
+			{
+				int code = json_hex(p + 1);
+				if (code < 0) break;
+				p += 4;
+
+				// surrogate pair
+				if (code >= 0xD800 && code <= 0xDBFF && p[1] == '\\' && p[2] == 'u')
+				{
+					int low = json_hex(p + 3);
+					if (low >= 0xDC00 && low <= 0xDFFF)
+					{
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+						p += 6;
+					}
+				}
+
+				// utf8
+				     if (code < 0x80)    { put((char)code); }
+				else if (code < 0x800)   { put((char)(0xC0 | (code >> 6)));  put((char)(0x80 | (code & 0x3F))); }
+				else if (code < 0x10000) { put((char)(0xE0 | (code >> 12))); put((char)(0x80 | ((code >> 6) & 0x3F)));  put((char)(0x80 | (code & 0x3F))); }
+				else                     { put((char)(0xF0 | (code >> 18))); put((char)(0x80 | ((code >> 12) & 0x3F))); put((char)(0x80 | ((code >> 6) & 0x3F))); put((char)(0x80 | (code & 0x3F))); }
+
+				break;
+			}
+			default: // \\ \" \/
+			{
+				if (*p) put(*p);
+				break;
+			}
+		}
+
+		if (*p) p++;
 	}
+
+	return length;
 }
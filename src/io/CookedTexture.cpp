@@ -0,0 +1,352 @@
+#include "io/CookedTexture.h"
+#include "io/ImageFromDisk.h"
+#include "Log.h"
+
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+//
+//	Mapping
+//
+
+CookedTexture::CookedTexture(char* mapping, uint64_t size, void* platform)
+	: m_mapping  (mapping)
+	, m_size     (size)
+	, m_platform (platform)
+{}
+
+CookedTexture::~CookedTexture()
+{
+#ifdef _WIN32
+	UnmapViewOfFile(m_mapping);
+	CloseHandle((HANDLE)m_platform);
+#else
+	munmap(m_mapping, m_size);
+#endif
+}
+
+const CookedTextureHeader& CookedTexture::Header() const
+{
+	return *(const CookedTextureHeader*)m_mapping;
+}
+
+int CookedTexture::MipCount() const
+{
+	return (int)Header().mipCount;
+}
+
+CookedTextureMip CookedTexture::Mip(int level) const
+{
+	const CookedTextureHeader& header = Header();
+
+	CookedTextureMip mip;
+	mip.pixels = m_mapping + header.mipOffsets[level];
+	mip.width  = std::max(1, (int)header.width  >> level);
+	mip.height = std::max(1, (int)header.height >> level);
+	mip.bytes  = (int)header.mipBytes[level];
+
+	return mip;
+}
+
+static bool cooked_texture_valid(const char* mapping, uint64_t size)
+{
+	if (size < sizeof(CookedTextureHeader))
+		return false;
+
+	const CookedTextureHeader& header = *(const CookedTextureHeader*)mapping;
+
+	if (   memcmp(header.magic, COOKED_TEXTURE_MAGIC, 4) != 0
+		|| header.version != COOKED_TEXTURE_VERSION
+		|| header.format != CookedTextureRaw
+		|| header.mipCount == 0
+		|| header.mipCount > COOKED_TEXTURE_MAX_MIPS
+		|| header.width  == 0 || header.width  > COOKED_TEXTURE_MAX_SIZE
+		|| header.height == 0 || header.height > COOKED_TEXTURE_MAX_SIZE
+		|| header.channels == 0 || header.channels > 4
+		|| header.bytesPerChannel != 1) // raw is always 8 bit
+	{
+		return false;
+	}
+
+	// levels are tightly packed and uploaded with an unpack alignment of 1, so the upload reads
+	// width * height * channels from each level. The level has to hold at least that many bytes
+	// and they all have to be inside the mapping
+
+	for (uint32_t i = 0; i < header.mipCount; i++)
+	{
+		uint64_t width  = std::max(1u, header.width  >> i);
+		uint64_t height = std::max(1u, header.height >> i);
+		uint64_t needed = width * height * header.channels * header.bytesPerChannel;
+
+		if (   header.mipBytes[i] < needed
+			|| header.mipBytes[i] > size
+			|| header.mipOffsets[i] > size - header.mipBytes[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+r<CookedTexture> io_MapCookedTexture(const char* cookedPath)
+{
+	char* mapping = nullptr;
+	uint64_t size = 0;
+	void* platform = nullptr;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(cookedPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	size = (uint64_t)fileSize.QuadPart;
+
+	HANDLE view = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	CloseHandle(file); // the mapping keeps the file open
+
+	if (!view)
+		return nullptr;
+
+	mapping = (char*)MapViewOfFile(view, FILE_MAP_COPY, 0, 0, 0);
+	platform = view;
+
+	if (!mapping)
+	{
+		CloseHandle(view);
+		return nullptr;
+	}
+#else
+	int file = open(cookedPath, O_RDONLY);
+	if (file < 0)
+		return nullptr;
+
+	struct stat info;
+	if (fstat(file, &info) != 0)
+	{
+		close(file);
+		return nullptr;
+	}
+
+	size = (uint64_t)info.st_size;
+
+	// private so writes to the pixels stay in memory
+	void* view = size > 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	close(file); // the mapping keeps the file open
+
+	if (view == MAP_FAILED)
+		return nullptr;
+
+	mapping = (char*)view;
+#endif
+
+	r<CookedTexture> cooked = mkr<CookedTexture>(mapping, size, platform);
+
+	if (!cooked_texture_valid(mapping, size))
+	{
+		log_io("w~Failed to load cooked texture '%s' reason: Invalid header", cookedPath);
+		return nullptr;
+	}
+
+	return cooked;
+}
+
+std::string io_FindCookedTexture(const std::string& imagePath)
+{
+	namespace fs = std::filesystem;
+
+	fs::path image = fs::path(imagePath);
+
+	if (image.extension() == COOKED_TEXTURE_EXTENSION)
+	{
+		return imagePath;
+	}
+
+	std::error_code error;
+	fs::path cooked = fs::path(imagePath + COOKED_TEXTURE_EXTENSION);
+
+	if (!fs::exists(cooked, error))
+	{
+		return "";
+	}
+
+	// an image edited after it was cooked should be decoded again
+	if (fs::exists(image, error) && fs::last_write_time(image, error) > fs::last_write_time(cooked, error))
+	{
+		return "";
+	}
+
+	return cooked.string();
+}
+
+//
+//	Cooking
+//
+
+static uint64_t cooked_texture_align(uint64_t offset)
+{
+	return (offset + 15) / 16 * 16;
+}
+
+// halve a level with a box filter, the last row/column is repeated for odd sizes
+static std::vector<char> cooked_texture_downsample(const std::vector<char>& pixels, int width, int height, int channels)
+{
+	int w = std::max(1, width / 2);
+	int h = std::max(1, height / 2);
+
+	std::vector<char> out(w * h * channels);
+
+	for (int y = 0; y < h; y++)
+	for (int x = 0; x < w; x++)
+	{
+		int x0 = std::min(x * 2, width  - 1), x1 = std::min(x * 2 + 1, width  - 1);
+		int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+
+		for (int c = 0; c < channels; c++)
+		{
+			int sum = (unsigned char)pixels[(x0 + y0 * width) * channels + c]
+			        + (unsigned char)pixels[(x1 + y0 * width) * channels + c]
+			        + (unsigned char)pixels[(x0 + y1 * width) * channels + c]
+			        + (unsigned char)pixels[(x1 + y1 * width) * channels + c];
+
+			out[(x + y * w) * channels + c] = (char)((sum + 2) / 4);
+		}
+	}
+
+	return out;
+}
+
+bool io_CookTexture(const char* imagePath, const char* cookedPath, bool mips)
+{
+	// stb flips the rows on load, so they are stored the way gl wants them
+	RawImageData image = io_LoadImageFromFile(imagePath);
+
+	if (!image.buffer)
+	{
+		return false;
+	}
+
+	if (image.width > COOKED_TEXTURE_MAX_SIZE || image.height > COOKED_TEXTURE_MAX_SIZE)
+	{
+		log_io("w~Failed to cook texture '%s' reason: Larger than %d", imagePath, COOKED_TEXTURE_MAX_SIZE);
+		free(image.buffer);
+		return false;
+	}
+
+	std::vector<std::vector<char>> levels;
+	levels.emplace_back(image.buffer, image.buffer + image.width * image.height * image.channels);
+	free(image.buffer);
+
+	int width = image.width;
+	int height = image.height;
+
+	while (mips && (width > 1 || height > 1) && levels.size() < COOKED_TEXTURE_MAX_MIPS)
+	{
+		levels.push_back(cooked_texture_downsample(levels.back(), width, height, image.channels));
+		width  = std::max(1, width  / 2);
+		height = std::max(1, height / 2);
+	}
+
+	CookedTextureHeader header = {};
+	memcpy(header.magic, COOKED_TEXTURE_MAGIC, 4);
+	header.version = COOKED_TEXTURE_VERSION;
+	header.format = CookedTextureRaw;
+	header.width = image.width;
+	header.height = image.height;
+	header.channels = image.channels;
+	header.bytesPerChannel = 1;
+	header.mipCount = (uint32_t)levels.size();
+
+	uint64_t offset = cooked_texture_align(sizeof(CookedTextureHeader));
+
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		header.mipOffsets[i] = offset;
+		header.mipBytes[i] = levels[i].size();
+		offset = cooked_texture_align(offset + levels[i].size());
+	}
+
+	FILE* file = fopen(cookedPath, "wb");
+
+	if (!file)
+	{
+		log_io("w~Failed to cook texture '%s' reason: Couldn't open '%s'", imagePath, cookedPath);
+		return false;
+	}
+
+	const char padding[16] = {};
+
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(padding, 1, header.mipOffsets[0] - sizeof(header), file);
+
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		uint64_t end = i + 1 < levels.size() ? header.mipOffsets[i + 1] : offset;
+
+		fwrite(levels[i].data(), 1, levels[i].size(), file);
+		fwrite(padding, 1, end - header.mipOffsets[i] - levels[i].size(), file);
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+int io_CookTexturesInFolder(const char* folder, bool mips)
+{
+	namespace fs = std::filesystem;
+
+	int count = 0;
+
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(folder))
+	{
+		if (!entry.is_regular_file())
+			continue;
+
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+		if (   extension != ".png" && extension != ".jpg" && extension != ".jpeg"
+			&& extension != ".tga" && extension != ".bmp")
+		{
+			continue;
+		}
+
+		std::string imagePath = entry.path().string();
+
+		if (io_FindCookedTexture(imagePath).size() > 0)
+			continue;
+
+		std::string cookedPath = imagePath + COOKED_TEXTURE_EXTENSION;
+
+		if (io_CookTexture(imagePath.c_str(), cookedPath.c_str(), mips))
+		{
+			count += 1;
+		}
+	}
+
+	return count;
+}
@@ -10,7 +10,8 @@ RawImageData io_LoadImageFromFile(const char* filepath)
     int width, height, channels, format;
 	stbi_info(filepath, &width, &height, &channels);
 
-	stbi_set_flip_vertically_on_load(true);
+	// per thread so images can be decoded on workers
+	stbi_set_flip_vertically_on_load_thread(true);
 
 	switch (channels)
 	{
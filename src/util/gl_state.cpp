@@ -0,0 +1,241 @@
+#include "util/gl_state.h"
+#include "util/error_check.h" // gives gl
+
+#define GL_STATE_UNKNOWN 0xffffffffu
+#define GL_STATE_TEXTURE_UNITS 32
+#define GL_STATE_TEXTURE_TARGETS 5
+
+struct GlState
+{
+	GLuint program;
+	GLuint vao;
+	GLuint framebuffer;
+
+	int activeUnit;
+	GLuint textures[GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_TARGETS];
+
+	int blendEnabled; // -1 for unknown
+	GLenum blendSrc;
+	GLenum blendDst;
+
+	GlStateCounters frame;
+	GlStateCounters lastFrame;
+
+	GlState()
+	{
+		Invalidate();
+	}
+
+	void Invalidate()
+	{
+		program = GL_STATE_UNKNOWN;
+		vao = GL_STATE_UNKNOWN;
+		framebuffer = GL_STATE_UNKNOWN;
+		activeUnit = -1;
+
+		for (int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+		for (int target = 0; target < GL_STATE_TEXTURE_TARGETS; target++)
+		{
+			textures[unit][target] = GL_STATE_UNKNOWN;
+		}
+
+		blendEnabled = -1;
+		blendSrc = GL_STATE_UNKNOWN;
+		blendDst = GL_STATE_UNKNOWN;
+	}
+
+	// returns true if the call needs to be issued, and sets the shadow to value
+	bool Change(GLuint& shadow, GLuint value)
+	{
+		if (shadow == value)
+		{
+			frame.skipped += 1;
+			return false;
+		}
+
+		shadow = value;
+		frame.issued += 1;
+		return true;
+	}
+};
+
+static GlState state;
+
+// -1 for targets that aren't shadowed
+static int gl_state_texture_target_index(GLenum target)
+{
+	switch (target)
+	{
+		case GL_TEXTURE_1D:       return 0;
+		case GL_TEXTURE_2D:       return 1;
+		case GL_TEXTURE_3D:       return 2;
+		case GL_TEXTURE_CUBE_MAP: return 3;
+		case GL_TEXTURE_2D_ARRAY: return 4;
+		default:                  return -1;
+	}
+}
+
+void gl_state_use_program(GLuint program)
+{
+	if (state.Change(state.program, program))
+	{
+		gl(glUseProgram(program));
+	}
+}
+
+void gl_state_bind_vertex_array(GLuint vao)
+{
+	if (state.Change(state.vao, vao))
+	{
+		gl(glBindVertexArray(vao));
+	}
+}
+
+void gl_state_bind_framebuffer(GLuint framebuffer)
+{
+	if (state.Change(state.framebuffer, framebuffer))
+	{
+		gl(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+	}
+}
+
+void gl_state_bind_texture(GLenum target, GLuint texture)
+{
+	int index = gl_state_texture_target_index(target);
+
+	// the unit is unknown until the first gl_state_active_texture, so always issue
+	if (index == -1 || state.activeUnit < 0 || state.activeUnit >= GL_STATE_TEXTURE_UNITS)
+	{
+		state.frame.issued += 1;
+		gl(glBindTexture(target, texture));
+		return;
+	}
+
+	if (state.Change(state.textures[state.activeUnit][index], texture))
+	{
+		gl(glBindTexture(target, texture));
+	}
+}
+
+void gl_state_bind_texture_unit(int unit, GLenum target, GLuint texture)
+{
+	gl_state_active_texture(unit);
+	gl_state_bind_texture(target, texture);
+}
+
+void gl_state_active_texture(int unit)
+{
+	if (state.activeUnit == unit)
+	{
+		state.frame.skipped += 1;
+		return;
+	}
+
+	state.activeUnit = unit;
+	state.frame.issued += 1;
+	gl(glActiveTexture(GL_TEXTURE0 + unit));
+}
+
+void gl_state_blend(bool enabled, GLenum src, GLenum dst)
+{
+	if (state.blendEnabled != (int)enabled)
+	{
+		state.blendEnabled = (int)enabled;
+		state.frame.issued += 1;
+
+		if (enabled) { gl(glEnable(GL_BLEND)); }
+		else         { gl(glDisable(GL_BLEND)); }
+	}
+
+	else
+	{
+		state.frame.skipped += 1;
+	}
+
+	if (!enabled)
+		return;
+
+	if (state.blendSrc != src || state.blendDst != dst)
+	{
+		state.blendSrc = src;
+		state.blendDst = dst;
+		state.frame.issued += 1;
+
+		gl(glBlendFunc(src, dst));
+	}
+
+	else
+	{
+		state.frame.skipped += 1;
+	}
+}
+
+void gl_state_get_blend(bool& enabled, GLenum& src, GLenum& dst)
+{
+	if (state.blendEnabled == -1)
+	{
+		GLboolean blend;
+		gl(blend = glIsEnabled(GL_BLEND));
+		state.blendEnabled = blend ? 1 : 0;
+	}
+
+	if (state.blendSrc == GL_STATE_UNKNOWN || state.blendDst == GL_STATE_UNKNOWN)
+	{
+		GLint value;
+		gl(glGetIntegerv(GL_BLEND_SRC_RGB, &value)); state.blendSrc = (GLenum)value;
+		gl(glGetIntegerv(GL_BLEND_DST_RGB, &value)); state.blendDst = (GLenum)value;
+	}
+
+	enabled = state.blendEnabled == 1;
+	src = state.blendSrc;
+	dst = state.blendDst;
+}
+
+void gl_state_forget_program(GLuint program)
+{
+	if (state.program == program) state.program = GL_STATE_UNKNOWN;
+}
+
+void gl_state_forget_vertex_array(GLuint vao)
+{
+	if (state.vao == vao) state.vao = GL_STATE_UNKNOWN;
+}
+
+void gl_state_forget_framebuffer(GLuint framebuffer)
+{
+	if (state.framebuffer == framebuffer) state.framebuffer = GL_STATE_UNKNOWN;
+}
+
+void gl_state_forget_texture(GLuint texture)
+{
+	for (int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+	for (int target = 0; target < GL_STATE_TEXTURE_TARGETS; target++)
+	{
+		if (state.textures[unit][target] == texture)
+		{
+			state.textures[unit][target] = GL_STATE_UNKNOWN;
+		}
+	}
+}
+
+void gl_state_count_upload(int bytes, bool reallocated)
+{
+	state.frame.bytesUploaded += bytes;
+	state.frame.reallocations += reallocated ? 1 : 0;
+}
+
+void gl_state_invalidate()
+{
+	state.Invalidate();
+}
+
+void gl_state_end_frame()
+{
+	state.lastFrame = state.frame;
+	state.frame = {};
+}
+
+GlStateCounters gl_state_frame_counters()
+{
+	return state.lastFrame;
+}
@@ -0,0 +1,114 @@
+#include "util/shader_cache.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+
+#define SHADER_CACHE_MAGIC "WSPB"
+#define SHADER_CACHE_VERSION 1
+
+struct ShaderCacheHeader
+{
+	char magic[4];
+	u32 version;
+	u64 hash;
+	u32 format;
+	u32 bytes;
+};
+
+// fnv-1a
+static void shader_cache_mix(u64& hash, const void* data, size_t bytes)
+{
+	const u8* p = (const u8*)data;
+
+	for (size_t i = 0; i < bytes; i++)
+	{
+		hash ^= p[i];
+		hash *= 1099511628211ull;
+	}
+}
+
+u64 shader_cache_hash(std::vector<ShaderCacheStage> stages, const std::string& driver)
+{
+	std::stable_sort(stages.begin(), stages.end(), [](const ShaderCacheStage& a, const ShaderCacheStage& b) { return a.stage < b.stage; });
+
+	u64 hash = 14695981039346656037ull;
+
+	// lengths are mixed in too so moving text between stages changes the hash
+
+	for (const ShaderCacheStage& stage : stages)
+	{
+		u64 length = stage.source.size();
+		shader_cache_mix(hash, &stage.stage, sizeof(stage.stage));
+		shader_cache_mix(hash, &length, sizeof(length));
+		shader_cache_mix(hash, stage.source.data(), stage.source.size());
+	}
+
+	shader_cache_mix(hash, driver.data(), driver.size());
+
+	return hash;
+}
+
+std::string shader_cache_file(const std::string& directory, u64 hash)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+
+	return (std::filesystem::path(directory) / name).string();
+}
+
+bool shader_cache_load(const std::string& file, u64 hash, u32* format, std::vector<char>& binary)
+{
+	FILE* f = fopen(file.c_str(), "rb");
+
+	if (!f)
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	// the size is checked before allocating, a cut off file could claim any size
+	ShaderCacheHeader header;
+	bool valid = fread(&header, sizeof(header), 1, f) == 1
+		&& memcmp(header.magic, SHADER_CACHE_MAGIC, 4) == 0
+		&& header.version == SHADER_CACHE_VERSION
+		&& header.hash == hash
+		&& (u64)size == sizeof(header) + (u64)header.bytes;
+
+	if (valid)
+	{
+		binary.resize(header.bytes);
+		valid = fread(binary.data(), 1, header.bytes, f) == header.bytes;
+		*format = header.format;
+	}
+
+	fclose(f);
+
+	return valid;
+}
+
+bool shader_cache_save(const std::string& file, u64 hash, u32 format, const std::vector<char>& binary)
+{
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(file).parent_path(), error);
+
+	FILE* f = fopen(file.c_str(), "wb");
+
+	if (!f)
+		return false;
+
+	ShaderCacheHeader header;
+	memcpy(header.magic, SHADER_CACHE_MAGIC, 4);
+	header.version = SHADER_CACHE_VERSION;
+	header.hash = hash;
+	header.format = format;
+	header.bytes = (u32)binary.size();
+
+	bool written = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(binary.data(), 1, binary.size(), f) == binary.size();
+
+	fclose(f);
+
+	return written;
+}
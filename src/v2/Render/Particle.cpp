@@ -2,6 +2,7 @@
 #include "ext/rendering/ImportShader.h"
 
 #include "util/error_check.h"
+#include "util/gl_state.h"
 #include "util/filesystem.h"
 #include "util/random.h"
 #include "util/stl.h"
@@ -12,6 +13,11 @@
 #include "ext/serial/serial_json.h"
 #include <fstream>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	include <xmmintrin.h>
+#	define wPARTICLE_SSE
+#endif
+
 void particle_RegisterMetaTypes()
 {
 	meta::describe<RandomBool>().name("RandomBool").member<&RandomBool::odds>("odds");
@@ -92,6 +98,7 @@ ParticleSpawn particle_LoadSpawn(const std::string& filepath)
 ParticleMesh::ParticleMesh(int fixedCount)
 {
 	m_particles = new ParticleData[fixedCount];
+	m_culling = new ParticleCulling[fixedCount];
 	m_fixedCount = fixedCount;
 
 	// Create buffers
@@ -122,7 +129,7 @@ ParticleMesh::ParticleMesh(int fixedCount)
 	// Create buffer array 
 
 	gl(glGenVertexArrays(1, &m_particlesVAO));
-	gl(glBindVertexArray(m_particlesVAO));
+	gl_state_bind_vertex_array(m_particlesVAO);
 
 	// set index buffer
 	gl(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexEBO));
@@ -167,6 +174,8 @@ ParticleMesh::ParticleMesh(int fixedCount)
 void ParticleMesh::Destroy()
 {
 	delete[] m_particles;
+	delete[] m_culling;
+	gl_state_forget_vertex_array(m_particlesVAO);
 	gl(glDeleteVertexArrays(1, &m_particlesVAO));
 }
 
@@ -181,44 +190,95 @@ int ParticleMesh::Emit(const ParticleData& particle)
 		return -1;
 
 	m_particles[count] = particle;
+	m_culling[count] = {};
 	count += 1;
 
+	if (m_hasCulled)
+		m_visibleCount += 1;
+
 	return count - 1;
 }
 
+// step everything but the life of a particle
+static void particle_simulate(ParticleData& data, float dt)
+{
+	// pos / vel
+	data.position += data.velocity * dt;
+	data.rotation += data.aVelocity * dt;
+	data.velocity *= clamp(1.f - dt * data.damping, 0.f, 1.f);
+	data.aVelocity *= clamp(1.f - dt * data.aDamping, 0.f, 1.f);
+
+	float lifeRatio = data.life / data.initialLife;
+
+	// scale
+	if (data.enableScalingByLife) {
+		float ratio = 1.f - pow(lifeRatio, data.factorScale);
+		data.scale = lerp(data.initialScale , data.finalScale, ratio);
+	}
+
+	// tint
+	if (data.enableTintByLife) {
+		float ratio = 1.f - pow(lifeRatio, data.factorTint);
+		data.tint = lerp(data.initialTint, data.finalTint, ratio);
+	}
+}
+
+// if a particle comes back on screen, catch up on the time it skipped
+// return 1 if the particle is visible
+static int particle_set_culled(ParticleData& data, ParticleCulling& culling, bool culled)
+{
+	if (!culled && culling.culledTime > 0.f)
+	{
+		particle_simulate(data, culling.culledTime);
+		culling.culledTime = 0.f;
+	}
+
+	culling.culled = culled;
+	return culled ? 0 : 1;
+}
+
 void ParticleMesh::Update(float dt)
 {
+	int interval = max(offscreen.interval, 1);
+	int budget = offscreen.budget < 0 ? count : offscreen.budget;
+
+	m_updateFrame += 1;
+
 	for (int i = 0; i < count; i++)
 	{
 		ParticleData& data = m_particles[i];
+		ParticleCulling& culling = m_culling[i];
 
-		// pos / vel
-		data.position += data.velocity * dt;
-		data.rotation += data.aVelocity * dt;
-		data.velocity *= clamp(1.f - dt * data.damping, 0.f, 1.f);
-		data.aVelocity *= clamp(1.f - dt * data.aDamping, 0.f, 1.f);
-
-		float lifeRatio = data.life / data.initialLife;
-
-		// scale
-		if (data.enableScalingByLife) {
-			float ratio = 1.f - pow(lifeRatio, data.factorScale);
-			data.scale = lerp(data.initialScale , data.finalScale, ratio);
+		if (!culling.culled)
+		{
+			particle_simulate(data, dt);
 		}
 
-		// tint
-		if (data.enableTintByLife) {
-			float ratio = 1.f - pow(lifeRatio, data.factorTint);
-			data.tint = lerp(data.initialTint, data.finalTint, ratio);
+		else
+		{
+			// off-screen particles are spread over the interval so the cost is even each update
+			culling.culledTime += dt;
+
+			bool due = (i + m_updateFrame) % interval == 0;
+			if (due && budget > 0)
+			{
+				particle_simulate(data, culling.culledTime);
+				culling.culledTime = 0.f;
+				budget -= 1;
+			}
 		}
 
-		// life
+		// life always counts down, so culled particles still die on time
 		data.life -= dt;
 		if (data.life < 0.f)
 		{
 			int newIndex = i;
 
+			if (m_hasCulled && !culling.culled)
+				m_visibleCount -= 1;
+
 			data = std::move(m_particles[count - 1]);
+			culling = m_culling[count - 1];
 			count -= 1;
 			i--;
 
@@ -230,11 +290,109 @@ void ParticleMesh::Update(float dt)
 
 void ParticleMesh::Draw()
 {
+	// the culled flags are only current if a cull pass ran since the last draw
+	int drawCount = m_hasCulled ? m_visibleCount : count;
+	m_hasCulled = false;
+
+	if (drawCount <= 0)
+		return;
+
 	gl(glBindBuffer(GL_ARRAY_BUFFER, m_particleInstVBO));
-	gl(glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(ParticleData), m_particles));
 
-	gl(glBindVertexArray(m_particlesVAO));
-	gl(glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, count));
+	if (drawCount == count) // nothing was culled, upload in one go
+	{
+		gl(glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(ParticleData), m_particles));
+	}
+
+	else // write only the visible particles into the instance buffer
+	{
+		GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+		ParticleData* instances = (ParticleData*)gl(glMapBufferRange(GL_ARRAY_BUFFER, 0, drawCount * sizeof(ParticleData), access));
+
+		if (!instances)
+			return;
+
+		int next = 0;
+		for (int i = 0; i < count && next < drawCount; i++)
+		{
+			if (!m_culling[i].culled)
+			{
+				instances[next] = m_particles[i];
+				next += 1;
+			}
+		}
+
+		gl(glUnmapBuffer(GL_ARRAY_BUFFER));
+	}
+
+	gl_state_bind_vertex_array(m_particlesVAO);
+	gl(glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, drawCount));
+}
+
+int ParticleMesh::Cull(vec2 min, vec2 max)
+{
+	// the quad of a particle is at most |scale.x| + |scale.y| from its position
+	// for any rotation, so test that radius against the bounds
+
+	int visible = 0;
+	int i = 0;
+
+#ifdef wPARTICLE_SSE
+	const __m128 minX = _mm_set1_ps(min.x);
+	const __m128 minY = _mm_set1_ps(min.y);
+	const __m128 maxX = _mm_set1_ps(max.x);
+	const __m128 maxY = _mm_set1_ps(max.y);
+	const __m128 sign = _mm_set1_ps(-0.f);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		ParticleData* p = m_particles + i;
+		ParticleCulling* c = m_culling + i;
+
+		__m128 x  = _mm_setr_ps(p[0].position.x, p[1].position.x, p[2].position.x, p[3].position.x);
+		__m128 y  = _mm_setr_ps(p[0].position.y, p[1].position.y, p[2].position.y, p[3].position.y);
+		__m128 sx = _mm_setr_ps(p[0].scale.x,    p[1].scale.x,    p[2].scale.x,    p[3].scale.x);
+		__m128 sy = _mm_setr_ps(p[0].scale.y,    p[1].scale.y,    p[2].scale.y,    p[3].scale.y);
+
+		__m128 r = _mm_add_ps(_mm_andnot_ps(sign, sx), _mm_andnot_ps(sign, sy));
+
+		__m128 outsideX = _mm_or_ps(_mm_cmplt_ps(_mm_add_ps(x, r), minX), _mm_cmpgt_ps(_mm_sub_ps(x, r), maxX));
+		__m128 outsideY = _mm_or_ps(_mm_cmplt_ps(_mm_add_ps(y, r), minY), _mm_cmpgt_ps(_mm_sub_ps(y, r), maxY));
+
+		int mask = _mm_movemask_ps(_mm_or_ps(outsideX, outsideY));
+
+		visible += particle_set_culled(p[0], c[0], mask & 1);
+		visible += particle_set_culled(p[1], c[1], mask & 2);
+		visible += particle_set_culled(p[2], c[2], mask & 4);
+		visible += particle_set_culled(p[3], c[3], mask & 8);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		ParticleData& p = m_particles[i];
+		float r = abs(p.scale.x) + abs(p.scale.y);
+
+		bool outside = p.position.x + r < min.x
+					|| p.position.y + r < min.y
+					|| p.position.x - r > max.x
+					|| p.position.y - r > max.y;
+
+		visible += particle_set_culled(p, m_culling[i], outside);
+	}
+
+	m_visibleCount = visible;
+	m_hasCulled = true;
+	return visible;
+}
+
+void ParticleMesh::ClearCulling()
+{
+	for (int i = 0; i < count; i++)
+		particle_set_culled(m_particles[i], m_culling[i], false);
+
+	m_visibleCount = count;
+	m_hasCulled = true;
 }
 
 void ParticleMesh::SortZOrder(float zBase)
@@ -271,13 +429,29 @@ void ParticleSystem::Init()
 
 	m_textureCache = TextureCache(2048, 2048, 4);
 
-	RegTexture(Asset::LoadFromFile<Texture>(_a("sprites/star.png")));
-	RegTexture(Asset::LoadFromFile<Texture>(_a("sprites/smoke1.png")));
-	RegTexture(Asset::LoadFromFile<Texture>(_a("sprites/smoke2.png")));
-	RegTexture(Asset::LoadFromFile<Texture>(_a("sprites/smoke3.png")));
-	RegTexture(Asset::LoadFromFile<Texture>(_a("sprites/smoke4.png")));
-	RegTexture(Asset::LoadFromFile<Texture>(_a("sprites/smoke5.png")));
-	RegTexture(Asset::LoadFromFile<Texture>(_a("sprites/smoke6.png")));
+	// decode on the loader's threads, these get packed into the cache so they stay on the host
+	// registered in this order below, so the handles are always the same
+
+	const char* sprites[] = {
+		"sprites/star.png",
+		"sprites/smoke1.png",
+		"sprites/smoke2.png",
+		"sprites/smoke3.png",
+		"sprites/smoke4.png",
+		"sprites/smoke5.png",
+		"sprites/smoke6.png"
+	};
+
+	for (const char* sprite : sprites)
+	{
+		m_loading.push_back(m_loader.Load(_a(sprite), {}, false, false));
+	}
+
+	// emit reads the cache uvs, so these need to be registered before the first particle
+	// the decodes still run in parallel, this only waits for the slowest one
+
+	m_loader.Flush();
+	RegLoadedTextures();
 }
 
 int ParticleSystem::GetCount() const
@@ -377,6 +551,8 @@ void ParticleSystem::EmitSpawnPerSecond(ParticleSpawn& spawn, float dt)
 
 void ParticleSystem::Update(float dt)
 {
+	RegLoadedTextures();
+
 	m_additiveBlend.Update(dt);
 	m_noBlend.Update(dt);
 }
@@ -395,19 +571,32 @@ void ParticleSystem::Draw(const CameraLens& lens)
 
 	gl(glEnable(GL_DEPTH_TEST));
 
-	gl(glEnable(GL_BLEND));
-	gl(glBlendFunc(GL_SRC_ALPHA, GL_ONE));
+	gl_state_blend(true, GL_SRC_ALPHA, GL_ONE);
 
 	m_additiveBlend.SortZOrder(0.f);
+	if (m_enableCulling) m_additiveBlend.Cull(m_min, m_max);
+	else                 m_additiveBlend.ClearCulling();
 	m_additiveBlend.Draw();
 
-	gl(glEnable(GL_BLEND));
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_state_blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_noBlend.SortZOrder(3.f);
+	if (m_enableCulling) m_noBlend.Cull(m_min, m_max);
+	else                 m_noBlend.ClearCulling();
 	m_noBlend.Draw();
 }
 
+void ParticleSystem::SetCulling(bool enable)
+{
+	m_enableCulling = enable;
+}
+
+void ParticleSystem::SetOffscreenRate(bool additive, const ParticleOffscreenRate& rate)
+{
+	ParticleMesh& mesh = additive ? m_additiveBlend : m_noBlend;
+	mesh.offscreen = rate;
+}
+
 TextureCacheImg ParticleSystem::RegTexture(r<Texture> texture)
 {
 	TextureCacheImg img  = m_textureCache.Add((char*)texture->Pixels(), texture->Width(), texture->Height(), texture->Channels());
@@ -417,3 +606,18 @@ TextureCacheImg ParticleSystem::RegTexture(r<Texture> texture)
 
 	return img;
 }
+
+void ParticleSystem::RegLoadedTextures()
+{
+	m_loader.Update();
+
+	while (m_loading.size() > 0 && !m_loader.IsLoading(m_loading.front()))
+	{
+		if (m_loading.front()) // failed loads are empty
+		{
+			RegTexture(m_loading.front());
+		}
+
+		m_loading.erase(m_loading.begin());
+	}
+}
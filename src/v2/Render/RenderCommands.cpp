@@ -0,0 +1,332 @@
+#include "v2/Render/RenderCommands.h"
+#include "glm/mat4x4.hpp"
+#include <algorithm>
+#include <string.h>
+#include <assert.h>
+
+//
+//	Backends
+//
+
+void RenderCommandBackendGl::SetTarget(const r<Target>& target)
+{
+	Render::SetRenderTarget(target);
+}
+
+void RenderCommandBackendGl::BindPipeline(const RenderPipeline& pipeline)
+{
+	pipeline.program->Use();
+	Render::SetAlphaBlend(pipeline.alphaBlend);
+}
+
+// copied out of the float array, the ints were stored bitwise
+template<typename _t>
+static _t render_uniform_value(const RenderUniform& uniform)
+{
+	static_assert(sizeof(_t) <= sizeof(uniform.value));
+
+	_t value;
+	memcpy(&value, uniform.value, sizeof(_t));
+	return value;
+}
+
+void RenderCommandBackendGl::SetUniform(ShaderProgram& program, const RenderUniform& uniform)
+{
+	switch (uniform.type)
+	{
+		case RenderUniformInt:  program.Set(uniform.handle, render_uniform_value<  int>(uniform)); break;
+		case RenderUniformU32:  program.Set(uniform.handle, render_uniform_value<  u32>(uniform)); break;
+		case RenderUniformF32:  program.Set(uniform.handle, render_uniform_value<  f32>(uniform)); break;
+		case RenderUniformVec2: program.Set(uniform.handle, render_uniform_value<fvec2>(uniform)); break;
+		case RenderUniformVec3: program.Set(uniform.handle, render_uniform_value<fvec3>(uniform)); break;
+		case RenderUniformVec4: program.Set(uniform.handle, render_uniform_value<fvec4>(uniform)); break;
+		case RenderUniformMat4: program.Set(uniform.handle, render_uniform_value<fmat4>(uniform)); break;
+	}
+}
+
+void RenderCommandBackendGl::SetTexture(ShaderProgram& program, UniformHandle uniform, const r<Texture>& texture)
+{
+	program.Set(uniform, *texture);
+}
+
+void RenderCommandBackendGl::Draw(Mesh& mesh, int instances)
+{
+	if (instances > 0) mesh.DrawInstanced(instances);
+	else               mesh.Draw();
+}
+
+static std::string render_uniform_to_string(const RenderUniform& uniform)
+{
+	int count = 0;
+
+	switch (uniform.type)
+	{
+		case RenderUniformInt:  return std::to_string(render_uniform_value<int>(uniform));
+		case RenderUniformU32:  return std::to_string(render_uniform_value<u32>(uniform));
+		case RenderUniformF32:  count = 1;  break;
+		case RenderUniformVec2: count = 2;  break;
+		case RenderUniformVec3: count = 3;  break;
+		case RenderUniformVec4: count = 4;  break;
+		case RenderUniformMat4: count = 16; break;
+	}
+
+	std::string str;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (i > 0) str += " ";
+		str += std::to_string(uniform.value[i]);
+	}
+
+	return str;
+}
+
+void RenderCommandBackendLog::SetTarget(const r<Target>& target)
+{
+	lines.push_back("target " + (target ? std::to_string(target->DeviceHandle()) : std::string("default")));
+}
+
+void RenderCommandBackendLog::BindPipeline(const RenderPipeline& pipeline)
+{
+	lines.push_back("pipeline " + std::to_string(pipeline.program->DeviceHandle()) + (pipeline.alphaBlend ? " alpha" : " additive"));
+}
+
+void RenderCommandBackendLog::SetUniform(ShaderProgram& /*program*/, const RenderUniform& uniform)
+{
+	lines.push_back("uniform " + std::to_string(uniform.handle.location) + " " + render_uniform_to_string(uniform));
+}
+
+void RenderCommandBackendLog::SetTexture(ShaderProgram& /*program*/, UniformHandle uniform, const r<Texture>& texture)
+{
+	lines.push_back("texture " + std::to_string(uniform.location) + " " + (texture ? std::to_string(texture->DeviceHandle()) : std::string("null")));
+}
+
+void RenderCommandBackendLog::Draw(Mesh& mesh, int instances)
+{
+	lines.push_back("draw " + std::to_string(mesh.DeviceHandle()) + " " + std::to_string(instances));
+}
+
+//
+//	Buffer
+//
+
+void RenderCommandBuffer::SetKey(u64 key)
+{
+	m_key = key;
+}
+
+void RenderCommandBuffer::SetTarget(r<Target> target)
+{
+	if (!target)
+	{
+		m_target = -1;
+		return;
+	}
+
+	m_target = (int)m_targets.size();
+	m_targets.push_back(target);
+}
+
+void RenderCommandBuffer::BindPipeline(const RenderPipeline& pipeline)
+{
+	m_pipelines.push_back(pipeline);
+}
+
+void RenderCommandBuffer::BindPipeline(r<ShaderProgram> program, bool alphaBlend)
+{
+	RenderPipeline pipeline;
+	pipeline.program = program;
+	pipeline.alphaBlend = alphaBlend;
+
+	BindPipeline(pipeline);
+}
+
+void RenderCommandBuffer::BindMesh(r<Mesh> mesh)
+{
+	m_meshes.push_back(mesh);
+}
+
+void RenderCommandBuffer::SetUniform(UniformHandle uniform, const   int& x) { SetUniform(uniform, RenderUniformInt,  &x, sizeof(x)); }
+void RenderCommandBuffer::SetUniform(UniformHandle uniform, const   u32& x) { SetUniform(uniform, RenderUniformU32,  &x, sizeof(x)); }
+void RenderCommandBuffer::SetUniform(UniformHandle uniform, const   f32& x) { SetUniform(uniform, RenderUniformF32,  &x, sizeof(x)); }
+void RenderCommandBuffer::SetUniform(UniformHandle uniform, const fvec2& x) { SetUniform(uniform, RenderUniformVec2, &x, sizeof(x)); }
+void RenderCommandBuffer::SetUniform(UniformHandle uniform, const fvec3& x) { SetUniform(uniform, RenderUniformVec3, &x, sizeof(x)); }
+void RenderCommandBuffer::SetUniform(UniformHandle uniform, const fvec4& x) { SetUniform(uniform, RenderUniformVec4, &x, sizeof(x)); }
+void RenderCommandBuffer::SetUniform(UniformHandle uniform, const fmat4& x) { SetUniform(uniform, RenderUniformMat4, &x, sizeof(x)); }
+
+void RenderCommandBuffer::SetUniform(UniformHandle uniform, const Color& color)
+{
+	SetUniform(uniform, color.as_v4());
+}
+
+void RenderCommandBuffer::SetTexture(UniformHandle uniform, r<Texture> texture)
+{
+	m_commands.push_back({ CommandTexture, (u32)m_textures.size() });
+	m_textures.emplace_back(uniform, texture);
+}
+
+void RenderCommandBuffer::SetTexture(const std::string& name, r<Texture> texture)
+{
+	SetTexture(Find(name), texture);
+}
+
+void RenderCommandBuffer::Draw()
+{
+	EndPacket(0);
+}
+
+void RenderCommandBuffer::DrawInstanced(int instances)
+{
+	EndPacket(instances);
+}
+
+int RenderCommandBuffer::Count() const
+{
+	return (int)m_packets.size();
+}
+
+void RenderCommandBuffer::Clear()
+{
+	m_commands.clear();
+	m_packets.clear();
+	m_uniforms.clear();
+	m_textures.clear();
+	m_targets.clear();
+	m_pipelines.clear();
+	m_meshes.clear();
+	m_key = 0;
+	m_begin = 0;
+	m_target = -1;
+}
+
+UniformHandle RenderCommandBuffer::Find(const std::string& name) const
+{
+	assert(m_pipelines.size() > 0 && "Need to bind a pipeline before setting a uniform by name");
+	return m_pipelines.back().program->FindUniform(name);
+}
+
+void RenderCommandBuffer::SetUniform(UniformHandle uniform, RenderUniformType type, const void* value, int bytes)
+{
+	RenderUniform command;
+	command.handle = uniform;
+	command.type = type;
+	memcpy(command.value, value, bytes);
+
+	m_commands.push_back({ CommandUniform, (u32)m_uniforms.size() });
+	m_uniforms.push_back(command);
+}
+
+void RenderCommandBuffer::EndPacket(int instances)
+{
+	assert(m_pipelines.size() > 0 && "Need to bind a pipeline before drawing");
+	assert(m_meshes.size() > 0 && "Need to bind a mesh before drawing");
+
+	Packet packet;
+	packet.key = m_key;
+	packet.begin = m_begin;
+	packet.end = (u32)m_commands.size();
+	packet.target = m_target;
+	packet.pipeline = (u32)m_pipelines.size() - 1;
+	packet.mesh = (u32)m_meshes.size() - 1;
+	packet.instances = instances;
+
+	m_packets.push_back(packet);
+	m_begin = packet.end;
+}
+
+//
+//	Queue
+//
+
+RenderCommandBuffer& RenderCommandQueue::GetBuffer(int index)
+{
+	std::unique_lock lock(m_buffersMutex);
+
+	while ((int)m_buffers.size() <= index)
+	{
+		m_buffers.push_back(std::make_unique<RenderCommandBuffer>());
+	}
+
+	return *m_buffers.at(index);
+}
+
+void RenderCommandQueue::Replay(RenderCommandBackend& backend, r<Target> target)
+{
+	m_sorted.clear();
+
+	for (u32 i = 0; i < m_buffers.size(); i++)
+	for (u32 j = 0; j < m_buffers[i]->m_packets.size(); j++)
+	{
+		m_sorted.push_back({ m_buffers[i]->m_packets[j].key, i, j });
+	}
+
+	// stable so packets with the same key replay in the order of buffer index then recording
+	std::stable_sort(m_sorted.begin(), m_sorted.end(), [](const SortedPacket& a, const SortedPacket& b) { return a.key < b.key; });
+
+	if (m_sorted.size() == 0)
+		return;
+
+	// the target could have been changed since the commands were recorded, so always bind it
+	const Target* currentTarget = target.get();
+	backend.SetTarget(target);
+
+	const RenderPipeline* current = nullptr;
+
+	for (const SortedPacket& sorted : m_sorted)
+	{
+		RenderCommandBuffer& buffer = *m_buffers[sorted.buffer];
+		const RenderCommandBuffer::Packet& packet = buffer.m_packets[sorted.packet];
+		const RenderPipeline& pipeline = buffer.m_pipelines[packet.pipeline];
+
+		const r<Target>& packetTarget = packet.target >= 0 ? buffer.m_targets[packet.target] : target;
+
+		if (currentTarget != packetTarget.get())
+		{
+			backend.SetTarget(packetTarget);
+			currentTarget = packetTarget.get();
+		}
+
+		if (!current || current->program != pipeline.program || current->alphaBlend != pipeline.alphaBlend)
+		{
+			backend.BindPipeline(pipeline);
+			current = &pipeline;
+		}
+
+		ShaderProgram& program = *pipeline.program;
+
+		for (u32 i = packet.begin; i < packet.end; i++)
+		{
+			const RenderCommandBuffer::Command& command = buffer.m_commands[i];
+
+			switch (command.type)
+			{
+				case RenderCommandBuffer::CommandUniform:
+				{
+					backend.SetUniform(program, buffer.m_uniforms[command.index]);
+					break;
+				}
+				case RenderCommandBuffer::CommandTexture:
+				{
+					auto& [uniform, texture] = buffer.m_textures[command.index];
+					backend.SetTexture(program, uniform, texture);
+					break;
+				}
+			}
+		}
+
+		backend.Draw(*buffer.m_meshes[packet.mesh], packet.instances);
+	}
+}
+
+int RenderCommandQueue::Count() const
+{
+	int count = 0;
+	for (const auto& buffer : m_buffers) count += buffer->Count();
+	return count;
+}
+
+void RenderCommandQueue::Clear()
+{
+	for (auto& buffer : m_buffers) buffer->Clear();
+	m_sorted.clear();
+}
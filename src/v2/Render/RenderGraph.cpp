@@ -0,0 +1,390 @@
+#include "v2/Render/RenderGraph.h"
+#include "Log.h"
+#include "util/math.h"
+#include <algorithm>
+#include <set>
+#include <climits>
+#include <assert.h>
+
+RenderGraph& RenderGraph::AddPass(r<RenderPass> pass)
+{
+	m_passes.push_back(pass);
+	m_compiled = false;
+	return *this;
+}
+
+RenderGraph& RenderGraph::CreateAttachment(const std::string& name, const RenderGraphAttachment& desc)
+{
+	m_transient[name] = desc;
+	m_compiled = false;
+	return *this;
+}
+
+RenderGraph& RenderGraph::ImportAttachment(const std::string& name, r<Texture> texture)
+{
+	m_imported[name] = texture;
+	m_compiled = false;
+	return *this;
+}
+
+bool RenderGraph::Compile()
+{
+	m_compiled = false;
+	m_order.clear();
+	m_slots.clear();
+	m_attachmentSlots.clear();
+	m_targets.clear();
+	m_width = 0;
+	m_height = 0;
+
+	int count = (int)m_passes.size();
+
+	// who touches each attachment, in the order passes were added
+
+	std::unordered_map<std::string, std::vector<int>> writers;
+	std::unordered_map<std::string, std::vector<int>> readers;
+
+	auto known = [this](const std::string& name)
+	{
+		return name == RENDER_GRAPH_TARGET || m_transient.count(name) || m_imported.count(name);
+	};
+
+	for (int i = 0; i < count; i++)
+	{
+		for (const auto& [name, slot] : m_passes[i]->writes)
+		{
+			if (!known(name))
+			{
+				log_render("e~[RenderGraph] Pass '%s' writes unknown attachment '%s'", m_passes[i]->name.c_str(), name.c_str());
+				return false;
+			}
+
+			writers[name].push_back(i);
+		}
+
+		for (const std::string& name : m_passes[i]->reads)
+		{
+			if (!known(name) || name == RENDER_GRAPH_TARGET)
+			{
+				log_render("e~[RenderGraph] Pass '%s' reads unknown attachment '%s'", m_passes[i]->name.c_str(), name.c_str());
+				return false;
+			}
+
+			readers[name].push_back(i);
+		}
+	}
+
+	for (const auto& [name, list] : readers)
+	{
+		if (writers[name].size() == 0 && !m_imported.count(name))
+		{
+			log_render("e~[RenderGraph] Attachment '%s' is read but never written", name.c_str());
+			return false;
+		}
+	}
+
+	// cull, keep passes which write something outside of the graph and everything they depend on
+	// a pass writing an attachment depends on the passes which wrote it before, it might draw on top of them
+
+	std::vector<bool> live(count, false);
+	std::vector<int> stack;
+
+	for (int i = 0; i < count; i++)
+	{
+		for (const auto& [name, slot] : m_passes[i]->writes)
+		{
+			if (name == RENDER_GRAPH_TARGET || m_imported.count(name))
+			{
+				stack.push_back(i);
+				break;
+			}
+		}
+	}
+
+	while (stack.size() > 0)
+	{
+		int pass = stack.back();
+		stack.pop_back();
+
+		if (live[pass])
+			continue;
+
+		live[pass] = true;
+
+		for (const std::string& name : m_passes[pass]->reads)
+		for (int writer : writers[name])
+		{
+			stack.push_back(writer);
+		}
+
+		for (const auto& [name, slot] : m_passes[pass]->writes)
+		for (int writer : writers[name])
+		{
+			if (writer < pass) stack.push_back(writer);
+		}
+	}
+
+	// edges, writers of an attachment in order, then its readers after all writers
+
+	std::vector<std::vector<int>> edges(count);
+	std::vector<int> incoming(count, 0);
+
+	auto edge = [&](int from, int to)
+	{
+		if (from == to || !live[from] || !live[to]) return;
+		edges[from].push_back(to);
+		incoming[to] += 1;
+	};
+
+	for (const auto& [name, list] : writers)
+	{
+		for (int i = 1; i < (int)list.size(); i++)
+		{
+			edge(list[i - 1], list[i]);
+		}
+
+		for (int reader : readers[name])
+		for (int writer : list)
+		{
+			edge(writer, reader);
+		}
+	}
+
+	// take the earliest added pass which is ready, so unrelated passes keep their order
+
+	std::set<int> ready;
+	int liveCount = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (!live[i]) continue;
+		if (incoming[i] == 0) ready.insert(i);
+		liveCount += 1;
+	}
+
+	std::vector<int> order;
+
+	while (ready.size() > 0)
+	{
+		int pass = *ready.begin();
+		ready.erase(ready.begin());
+		order.push_back(pass);
+
+		for (int next : edges[pass])
+		{
+			if (--incoming[next] == 0) ready.insert(next);
+		}
+	}
+
+	if ((int)order.size() != liveCount)
+	{
+		log_render("e~[RenderGraph] Passes depend on each other in a cycle");
+		return false;
+	}
+
+	for (int pass : order)
+	{
+		m_order.push_back(m_passes[pass]);
+	}
+
+	// lifetimes of the transient attachments, from the first to the last pass which uses them
+
+	struct Lifetime
+	{
+		std::string name;
+		int first = INT_MAX;
+		int last = -1;
+	};
+
+	std::unordered_map<std::string, Lifetime> lifetimes;
+
+	auto use = [&](const std::string& name, int index)
+	{
+		if (!m_transient.count(name)) return;
+
+		Lifetime& lifetime = lifetimes[name];
+		lifetime.name = name;
+		lifetime.first = std::min(lifetime.first, index);
+		lifetime.last = std::max(lifetime.last, index);
+	};
+
+	for (int i = 0; i < (int)m_order.size(); i++)
+	{
+		for (const auto& [name, slot] : m_order[i]->writes) use(name, i);
+		for (const std::string& name : m_order[i]->reads)   use(name, i);
+	}
+
+	std::vector<Lifetime> sorted;
+
+	for (const auto& [name, lifetime] : lifetimes)
+	{
+		sorted.push_back(lifetime);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const Lifetime& a, const Lifetime& b)
+	{
+		return a.first != b.first ? a.first < b.first : a.name < b.name;
+	});
+
+	// reuse a slot of the same size and usage if its last use was before this attachment's first
+
+	for (const Lifetime& lifetime : sorted)
+	{
+		const RenderGraphAttachment& desc = m_transient.at(lifetime.name);
+		int index = -1;
+
+		for (int i = 0; i < (int)m_slots.size(); i++)
+		{
+			if (m_slots[i].lastUse < lifetime.first && SameSize(m_slots[i].desc, desc))
+			{
+				index = i;
+				break;
+			}
+		}
+
+		if (index == -1)
+		{
+			index = (int)m_slots.size();
+			m_slots.push_back({ desc, -1, nullptr });
+		}
+
+		m_slots[index].lastUse = lifetime.last;
+		m_attachmentSlots[lifetime.name] = index;
+	}
+
+	m_compiled = true;
+
+	return true;
+}
+
+const std::vector<r<RenderPass>>& RenderGraph::Order() const
+{
+	return m_order;
+}
+
+int RenderGraph::AttachmentSlot(const std::string& name) const
+{
+	auto itr = m_attachmentSlots.find(name);
+	return itr != m_attachmentSlots.end() ? itr->second : -1;
+}
+
+int RenderGraph::NumberOfSlots() const
+{
+	return (int)m_slots.size();
+}
+
+int RenderGraph::SlotBytes(int width, int height) const
+{
+	int bytes = 0;
+
+	for (const Slot& slot : m_slots)
+	{
+		bytes += AttachmentBytes(slot.desc, width, height);
+	}
+
+	return bytes;
+}
+
+int RenderGraph::UnaliasedBytes(int width, int height) const
+{
+	int bytes = 0;
+
+	for (const auto& [name, slot] : m_attachmentSlots)
+	{
+		bytes += AttachmentBytes(m_transient.at(name), width, height);
+	}
+
+	return bytes;
+}
+
+void RenderGraph::_Run(const CameraLens& lens, r<Target> target)
+{
+	if (!m_compiled && !Compile())
+		return;
+
+	// without a target, only attachments with a set size are valid
+	int width  = target ? target->Width()  : m_width;
+	int height = target ? target->Height() : m_height;
+
+	if (m_targets.size() != m_order.size() || width != m_width || height != m_height)
+	{
+		ResizeSlots(width, height);
+	}
+
+	for (int i = 0; i < (int)m_order.size(); i++)
+	{
+		RenderPass& pass = *m_order[i];
+
+		pass.attachments.clear();
+
+		auto texture = [this](const std::string& name) -> r<Texture>
+		{
+			auto imported = m_imported.find(name);
+			if (imported != m_imported.end()) return imported->second;
+
+			int slot = AttachmentSlot(name);
+			return slot != -1 ? m_slots[slot].texture : nullptr;
+		};
+
+		for (const std::string& name : pass.reads)            pass.attachments[name] = texture(name);
+		for (const auto& [name, slot] : pass.writes) if (name != RENDER_GRAPH_TARGET) pass.attachments[name] = texture(name);
+
+		pass.Run(lens, m_targets[i] ? m_targets[i] : target);
+	}
+}
+
+void RenderGraph::ResizeSlots(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+
+	for (Slot& slot : m_slots)
+	{
+		int w = slot.desc.width  > 0 ? slot.desc.width  : (int)(width  * slot.desc.scale);
+		int h = slot.desc.height > 0 ? slot.desc.height : (int)(height * slot.desc.scale);
+
+		slot.texture = mkr<Texture>(max(w, 1), max(h, 1), slot.desc.usage, true);
+	}
+
+	// the targets hold onto the old textures, so make them again
+
+	m_targets.clear();
+
+	for (const r<RenderPass>& pass : m_order)
+	{
+		r<Target> target;
+
+		for (const auto& [name, slot] : pass->writes)
+		{
+			if (name == RENDER_GRAPH_TARGET)
+			{
+				assert(pass->writes.size() == 1 && "A pass writing to the graph's target can't write other attachments");
+				target = nullptr;
+				break;
+			}
+
+			if (!target) target = mkr<Target>();
+
+			auto imported = m_imported.find(name);
+			target->Add(slot, imported != m_imported.end() ? imported->second : m_slots[AttachmentSlot(name)].texture);
+		}
+
+		m_targets.push_back(target);
+	}
+}
+
+bool RenderGraph::SameSize(const RenderGraphAttachment& a, const RenderGraphAttachment& b) const
+{
+	return a.usage == b.usage
+		&& a.scale == b.scale
+		&& a.width == b.width
+		&& a.height == b.height;
+}
+
+int RenderGraph::AttachmentBytes(const RenderGraphAttachment& desc, int width, int height) const
+{
+	int w = desc.width  > 0 ? desc.width  : (int)(width  * desc.scale);
+	int h = desc.height > 0 ? desc.height : (int)(height * desc.scale);
+
+	return max(w, 1) * max(h, 1) * gl_num_channels(desc.usage) * gl_bytes_per_channel(desc.usage);
+}
@@ -6,10 +6,39 @@ void RenderPass::Run(const CameraLens& lens, r<Target> target)
 		Init();
 
 	_Run(lens, target);
+
+	if (!backend)
+		backend = mkr<RenderCommandBackendGl>();
+
+	commands.Replay(*backend, target);
+	commands.Clear();
 }
 
 void RenderPass::Init()
 {
 	_Init();
 	hasInit = true;
+}
+
+void RenderPass::SetCommandBackend(r<RenderCommandBackend> backend)
+{
+	this->backend = backend;
+}
+
+RenderPass& RenderPass::Reads(const std::string& attachment)
+{
+	reads.push_back(attachment);
+	return *this;
+}
+
+RenderPass& RenderPass::Writes(const std::string& attachment, Target::AttachmentName slot)
+{
+	writes.emplace_back(attachment, slot);
+	return *this;
+}
+
+r<Texture> RenderPass::Attachment(const std::string& name) const
+{
+	auto itr = attachments.find(name);
+	return itr != attachments.end() ? itr->second : nullptr;
 }
\ No newline at end of file
@@ -2,7 +2,8 @@
 
 // not done
 
-TextureCache::TextureCache(int maxWidth, int maxHeight, int channels)
+TextureCache::TextureCache(int maxWidth, int maxHeight, int channels, TextureCachePacker packer, int padding)
+    : padding (padding)
 {
 	//TextureLayout layout;
 	//layout.width = maxWidth;
@@ -10,48 +11,104 @@ TextureCache::TextureCache(int maxWidth, int maxHeight, int channels)
 	//layout.format = format;
 
     cache = ref(Texture(maxWidth, maxHeight, Texture::uRGBA, false));
+    cache->ClearHost(Color(0, 0, 0, 0));
 	//cache = v2Texture(layout, AccessHostDevice);
 
-    root = new Node();
-    root->rect = { 0, 0, maxWidth - 1, maxHeight - 1 };
+    switch (packer)
+    {
+        case TextureCachePackerTree:
+            root = new Node();
+            root->rect = { 0, 0, maxWidth - 1, maxHeight - 1 };
+            break;
+        case TextureCachePackerRectpack2D:
+            spaces = mkr<Spaces>(rectpack2D::rect_wh(maxWidth, maxHeight));
+            break;
+    }
 }
 
 TextureCacheImg TextureCache::Add(char* pixels, int width, int height, int channels)
 {
-    Node* node = root->AddRect(width, height);
+    TextureCacheImg img = TryAdd(pixels, width, height, channels);
 
-    if (!node) // error, todo: handle this in some way
+    if (img.handle == 0) // error, todo: handle this in some way
         throw nullptr;
 
+    return img;
+}
+
+TextureCacheImg TextureCache::TryAdd(char* pixels, int width, int height, int channels)
+{
+    TextureCacheImg img;
+    img.handle = 0;
+
+    int minX, minY;
+    if (!Reserve(width + padding, height + padding, &minX, &minY))
+        return img;
+
     //TextureView cacheView = cache.host;
     //TextureLayout cacheLayout = cacheView.layout;
 
     for (int x = 0; x < width; x++)
     for (int y = 0; y < height; y++)
     {
-        int from = (x + y * height) * channels;
-        int to = (x + node->rect.minX + (y + node->rect.minY) * cache->Width()) * 4;
+        int from = (x + y * width) * channels;
+        int to = (x + minX + (y + minY) * cache->Width()) * 4;
 
         for (int c = 0; c < channels; c++)
             cache->Pixels()[to + c] = pixels[from + c];
     }
 
-    node->handle = nextHandle;
-    nextHandle += 1;
+    cache->MarkRegionForUpdate(minX, minY, width, height);
 
-    TextureCacheImg img;
-    img.handle = node->handle;
-    img.offset = vec2(node->rect.minX, node->rect.minY) / vec2(cache->Width(), cache->Height());
-    img.scale = vec2(node->rect.width(), node->rect.height()) / vec2(cache->Width(), cache->Height());
+    img.handle = nextHandle;
+    img.offset = vec2(minX, minY) / vec2(cache->Width(), cache->Height());
+    img.scale = vec2(width, height) / vec2(cache->Width(), cache->Height());
+
+    nextHandle += 1;
 
     return img;
 }
 
+bool TextureCache::Reserve(int width, int height, int* minX, int* minY)
+{
+    if (spaces)
+    {
+        std::optional<rectpack2D::rect_xywh> rect = spaces->insert(rectpack2D::rect_wh(width, height));
+
+        if (!rect)
+            return false;
+
+        *minX = rect->x;
+        *minY = rect->y;
+
+        return true;
+    }
+
+    Node* node = root->AddRect(width, height);
+
+    if (!node)
+        return false;
+
+    node->handle = nextHandle;
+
+    *minX = node->rect.minX;
+    *minY = node->rect.minY;
+
+    return true;
+}
+
 TextureCacheImg TextureCache::AddView(const TextureView& view)
 {
     return Add((char*)view.buffer, view.layout.width, view.layout.height, view.layout.NumberOfBytesPerPixel());
 }
 
+TextureCacheImg TextureCache::Add(const std::string& path)
+{
+    // not static so the pixels stay on the host to be copied from
+    Texture texture = Texture(path, false);
+    return Add((char*)texture.Pixels(), texture.Width(), texture.Height(), texture.Channels());
+}
+
 void TextureCache::SendToDevice() {
     cache->SendToDevice();
 }
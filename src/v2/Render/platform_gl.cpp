@@ -1,5 +1,6 @@
 #include "v2/Render/platform_gl.h"
 #include "util/error_check.h" // gives gl
+#include "util/gl_state.h"
 
 TextureHandle _texture_device_alloc(const TextureView& view)
 {
@@ -28,6 +29,7 @@ void _texture_device_free(TextureHandle* texture)
 
 	GLuint handle = texture->handle;
 	
+	gl_state_forget_texture(handle);
 	gl(glDeleteTextures(1, &handle));
 	*texture = {};
 }
@@ -36,7 +38,7 @@ void _texture_device_bind(const TextureHandle& texture)
 {
 	log_render("_texture_device_bind %d -> %d", texture.type, texture.handle);
 
-	gl(glBindTexture(texture.type, texture.handle));
+	gl_state_bind_texture(texture.type, texture.handle);
 }
 
 void _texture_device_realloc(TextureHandle* texture, const TextureView& view)
@@ -84,7 +86,7 @@ void _texture_device_copy_to_host(const TextureHandle& texture, const TextureVie
 	GLenum gformat = gl_format(format);
 	GLenum type = gl_type(format);
 
-	gl(glBindTexture(target, texture.handle));
+	gl_state_bind_texture(target, texture.handle);
 	gl(glGetTexImage(target, 0, gformat, type, view.buffer));
 }
 
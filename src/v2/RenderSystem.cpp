@@ -1,5 +1,6 @@
 #include "v2/RenderSystem.h"
 #include "util/error_check.h"
+#include "util/gl_state.h"
 
 #include "RenderSystemTranslation.h"
 
@@ -119,7 +120,7 @@ void v2TextureResource::copyToDevice()
 	const void* glData = m_data.data();
 
 	glGenTextures(1, &gl_handle);
-	glBindTexture(glTarget, gl_handle);
+	gl_state_bind_texture(glTarget, gl_handle);
 
 	glTexParameteri(glTarget, GL_TEXTURE_MIN_FILTER, glFilter);
 	glTexParameteri(glTarget, GL_TEXTURE_MAG_FILTER, glFilter);
@@ -145,12 +146,13 @@ void v2TextureResource::copyFromDevice()
 	GLenum glType = gl_type(m_format);
 	void* glData = m_data.data();
 
-	glBindTexture(glTarget, gl_handle);
+	gl_state_bind_texture(glTarget, gl_handle);
 	glGetTexImage(glTarget, 0, glFormat, glType, glData);
 }
 
 void v2TextureResource::eraseFromDevice()
 {
+	gl_state_forget_texture(gl_handle);
 	glDeleteTextures(1, &gl_handle);
 }
 
@@ -0,0 +1,261 @@
+#include "gl_recorder.h"
+#include <string.h>
+#include <algorithm>
+
+static GlRecorder s_recorder;
+static GLuint s_nextName = 1;
+
+#define record(function) s_recorder.calls[#function] += 1
+
+int GlRecorder::Count(const std::string& function) const
+{
+	auto itr = calls.find(function);
+	return itr != calls.end() ? itr->second : 0;
+}
+
+int GlRecorder::Total() const
+{
+	int total = 0;
+	for (auto& [function, count] : calls) total += count;
+	return total;
+}
+
+void GlRecorder::Reset()
+{
+	calls.clear();
+	bufferBytes = 0;
+	textureUploads.clear();
+}
+
+std::vector<unsigned char> GlRecorderTextureUpload::Read(int bytesPerPixel) const
+{
+	// each row starts at a multiple of the alignment
+	int row = (rowLength > 0 ? rowLength : width) * bytesPerPixel;
+	int stride = (row + alignment - 1) / alignment * alignment;
+
+	std::vector<unsigned char> bytes;
+	for (int i = 0; i < height; i++)
+	{
+		const unsigned char* begin = (const unsigned char*)pixels + i * stride;
+		bytes.insert(bytes.end(), begin, begin + width * bytesPerPixel);
+	}
+
+	return bytes;
+}
+
+GlRecorder& gl_recorder()
+{
+	return s_recorder;
+}
+
+//
+//	Objects
+//
+
+static void APIENTRY rec_glGenTextures(GLsizei n, GLuint* names) { record(glGenTextures); for (int i = 0; i < n; i++) names[i] = s_nextName++; }
+static void APIENTRY rec_glGenBuffers (GLsizei n, GLuint* names) { record(glGenBuffers);  for (int i = 0; i < n; i++) names[i] = s_nextName++; }
+static void APIENTRY rec_glDeleteTextures(GLsizei, const GLuint*) { record(glDeleteTextures); }
+static void APIENTRY rec_glDeleteBuffers (GLsizei, const GLuint*) { record(glDeleteBuffers); }
+
+static GLuint APIENTRY rec_glCreateProgram()     { record(glCreateProgram); return s_nextName++; }
+static GLuint APIENTRY rec_glCreateShader(GLenum) { record(glCreateShader);  return s_nextName++; }
+static void APIENTRY rec_glDeleteProgram(GLuint) { record(glDeleteProgram); }
+static void APIENTRY rec_glDeleteShader (GLuint) { record(glDeleteShader); }
+
+//
+//	State
+//
+
+static GLenum APIENTRY rec_glGetError() { return GL_NO_ERROR; }
+
+static void APIENTRY rec_glUseProgram       (GLuint)                 { record(glUseProgram); }
+static void APIENTRY rec_glBindVertexArray  (GLuint)                 { record(glBindVertexArray); }
+static void APIENTRY rec_glBindFramebuffer  (GLenum, GLuint)         { record(glBindFramebuffer); }
+static void APIENTRY rec_glBindBuffer       (GLenum, GLuint)         { record(glBindBuffer); }
+static void APIENTRY rec_glBindBufferBase   (GLenum, GLuint, GLuint) { record(glBindBufferBase); }
+static void APIENTRY rec_glBindTexture      (GLenum, GLuint)         { record(glBindTexture); }
+static void APIENTRY rec_glActiveTexture    (GLenum)                 { record(glActiveTexture); }
+static void APIENTRY rec_glEnable           (GLenum)                 { record(glEnable); }
+static void APIENTRY rec_glDisable          (GLenum)                 { record(glDisable); }
+static void APIENTRY rec_glBlendFunc        (GLenum, GLenum)         { record(glBlendFunc); }
+static void APIENTRY rec_glViewport         (GLint, GLint, GLsizei, GLsizei) { record(glViewport); }
+
+static void APIENTRY rec_glTexParameteri(GLenum, GLenum name, GLint value)
+{
+	record(glTexParameteri);
+
+	if (name == GL_TEXTURE_MAX_LEVEL) s_recorder.textureMaxLevel = value;
+}
+
+static void APIENTRY rec_glPixelStorei(GLenum name, GLint value)
+{
+	record(glPixelStorei);
+
+	if (name == GL_UNPACK_ALIGNMENT)  s_recorder.unpackAlignment = value;
+	if (name == GL_UNPACK_ROW_LENGTH) s_recorder.unpackRowLength = value;
+}
+
+//
+//	Data
+//
+
+static void APIENTRY rec_glBufferData(GLenum, GLsizeiptr size, const void* data, GLenum)
+{
+	record(glBufferData);
+	if (data) s_recorder.bufferBytes += (int)size;
+}
+
+static void APIENTRY rec_glBufferSubData(GLenum, GLintptr, GLsizeiptr size, const void*)
+{
+	record(glBufferSubData);
+	s_recorder.bufferBytes += (int)size;
+}
+
+static void APIENTRY rec_glTexImage2D(GLenum, GLint level, GLint, GLsizei width, GLsizei height, GLint, GLenum, GLenum, const void* pixels)
+{
+	record(glTexImage2D);
+	s_recorder.textureUploads.push_back({ level, 0, 0, width, height, s_recorder.unpackAlignment, s_recorder.unpackRowLength, pixels });
+}
+
+static void APIENTRY rec_glTexSubImage2D(GLenum, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum, GLenum, const void* pixels)
+{
+	record(glTexSubImage2D);
+	s_recorder.textureUploads.push_back({ level, x, y, width, height, s_recorder.unpackAlignment, s_recorder.unpackRowLength, pixels });
+}
+
+//
+//	Programs
+//
+
+static void APIENTRY rec_glShaderSource (GLuint, GLsizei, const GLchar* const*, const GLint*) { record(glShaderSource); }
+static void APIENTRY rec_glCompileShader(GLuint)         { record(glCompileShader); }
+static void APIENTRY rec_glAttachShader (GLuint, GLuint) { record(glAttachShader); }
+static void APIENTRY rec_glLinkProgram  (GLuint)         { record(glLinkProgram); }
+
+static void APIENTRY rec_glGetShaderiv(GLuint, GLenum name, GLint* value)
+{
+	record(glGetShaderiv);
+	*value = name == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+
+static void APIENTRY rec_glGetProgramiv(GLuint, GLenum name, GLint* value)
+{
+	record(glGetProgramiv);
+
+	switch (name)
+	{
+		case GL_LINK_STATUS:     *value = GL_TRUE; break;
+		case GL_ACTIVE_UNIFORMS: *value = (GLint)s_recorder.uniforms.size(); break;
+
+		case GL_ACTIVE_UNIFORM_MAX_LENGTH:
+		{
+			*value = 0;
+			for (const GlRecorderUniform& uniform : s_recorder.uniforms)
+				*value = std::max(*value, (GLint)uniform.name.size() + 1);
+			break;
+		}
+
+		default: *value = 0; break;
+	}
+}
+
+static void APIENTRY rec_glGetActiveUniform(GLuint, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+{
+	record(glGetActiveUniform);
+
+	const GlRecorderUniform& uniform = s_recorder.uniforms.at(index);
+	GLsizei count = std::min((GLsizei)uniform.name.size(), bufSize - 1);
+
+	memcpy(name, uniform.name.c_str(), count);
+	name[count] = '\0';
+
+	*length = count;
+	*size = uniform.size;
+	*type = uniform.type;
+}
+
+// locations are the index of the uniform
+static GLint APIENTRY rec_glGetUniformLocation(GLuint, const GLchar* name)
+{
+	record(glGetUniformLocation);
+
+	for (int i = 0; i < (int)s_recorder.uniforms.size(); i++)
+	{
+		if (s_recorder.uniforms[i].name == name)
+			return i;
+	}
+
+	return -1;
+}
+
+static GLuint APIENTRY rec_glGetUniformBlockIndex(GLuint, const GLchar*) { record(glGetUniformBlockIndex); return GL_INVALID_INDEX; }
+
+static void APIENTRY rec_glUniform1i       (GLint, GLint)                               { record(glUniform1i); }
+static void APIENTRY rec_glUniform1iv      (GLint, GLsizei, const GLint*)               { record(glUniform1iv); }
+static void APIENTRY rec_glUniform1uiv     (GLint, GLsizei, const GLuint*)              { record(glUniform1uiv); }
+static void APIENTRY rec_glUniform1fv      (GLint, GLsizei, const GLfloat*)             { record(glUniform1fv); }
+static void APIENTRY rec_glUniform2fv      (GLint, GLsizei, const GLfloat*)             { record(glUniform2fv); }
+static void APIENTRY rec_glUniform3fv      (GLint, GLsizei, const GLfloat*)             { record(glUniform3fv); }
+static void APIENTRY rec_glUniform4fv      (GLint, GLsizei, const GLfloat*)             { record(glUniform4fv); }
+static void APIENTRY rec_glUniform2iv      (GLint, GLsizei, const GLint*)               { record(glUniform2iv); }
+static void APIENTRY rec_glUniform3iv      (GLint, GLsizei, const GLint*)               { record(glUniform3iv); }
+static void APIENTRY rec_glUniform4iv      (GLint, GLsizei, const GLint*)               { record(glUniform4iv); }
+static void APIENTRY rec_glUniformMatrix2fv(GLint, GLsizei, GLboolean, const GLfloat*) { record(glUniformMatrix2fv); }
+static void APIENTRY rec_glUniformMatrix3fv(GLint, GLsizei, GLboolean, const GLfloat*) { record(glUniformMatrix3fv); }
+static void APIENTRY rec_glUniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat*) { record(glUniformMatrix4fv); }
+
+void gl_recorder_install()
+{
+	glad_glGenTextures           = rec_glGenTextures;
+	glad_glGenBuffers            = rec_glGenBuffers;
+	glad_glDeleteTextures        = rec_glDeleteTextures;
+	glad_glDeleteBuffers         = rec_glDeleteBuffers;
+	glad_glCreateProgram         = rec_glCreateProgram;
+	glad_glCreateShader          = rec_glCreateShader;
+	glad_glDeleteProgram         = rec_glDeleteProgram;
+	glad_glDeleteShader          = rec_glDeleteShader;
+
+	glad_glGetError              = rec_glGetError;
+	glad_glUseProgram            = rec_glUseProgram;
+	glad_glBindVertexArray       = rec_glBindVertexArray;
+	glad_glBindFramebuffer       = rec_glBindFramebuffer;
+	glad_glBindBuffer            = rec_glBindBuffer;
+	glad_glBindBufferBase        = rec_glBindBufferBase;
+	glad_glBindTexture           = rec_glBindTexture;
+	glad_glActiveTexture         = rec_glActiveTexture;
+	glad_glEnable                = rec_glEnable;
+	glad_glDisable               = rec_glDisable;
+	glad_glBlendFunc             = rec_glBlendFunc;
+	glad_glViewport              = rec_glViewport;
+	glad_glPixelStorei           = rec_glPixelStorei;
+	glad_glTexParameteri         = rec_glTexParameteri;
+
+	glad_glBufferData            = rec_glBufferData;
+	glad_glBufferSubData         = rec_glBufferSubData;
+	glad_glTexImage2D            = rec_glTexImage2D;
+	glad_glTexSubImage2D         = rec_glTexSubImage2D;
+
+	glad_glShaderSource          = rec_glShaderSource;
+	glad_glCompileShader         = rec_glCompileShader;
+	glad_glAttachShader          = rec_glAttachShader;
+	glad_glLinkProgram           = rec_glLinkProgram;
+	glad_glGetShaderiv           = rec_glGetShaderiv;
+	glad_glGetProgramiv          = rec_glGetProgramiv;
+	glad_glGetActiveUniform      = rec_glGetActiveUniform;
+	glad_glGetUniformLocation    = rec_glGetUniformLocation;
+	glad_glGetUniformBlockIndex  = rec_glGetUniformBlockIndex;
+
+	glad_glUniform1i             = rec_glUniform1i;
+	glad_glUniform1iv            = rec_glUniform1iv;
+	glad_glUniform1uiv           = rec_glUniform1uiv;
+	glad_glUniform1fv            = rec_glUniform1fv;
+	glad_glUniform2fv            = rec_glUniform2fv;
+	glad_glUniform3fv            = rec_glUniform3fv;
+	glad_glUniform4fv            = rec_glUniform4fv;
+	glad_glUniform2iv            = rec_glUniform2iv;
+	glad_glUniform3iv            = rec_glUniform3iv;
+	glad_glUniform4iv            = rec_glUniform4iv;
+	glad_glUniformMatrix2fv      = rec_glUniformMatrix2fv;
+	glad_glUniformMatrix3fv      = rec_glUniformMatrix3fv;
+	glad_glUniformMatrix4fv      = rec_glUniformMatrix4fv;
+}
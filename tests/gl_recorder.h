@@ -0,0 +1,57 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Replaces the gl functions loaded by glad with ones that only record the call, so code
+// that talks to gl can be tested without a window or a gpu
+//
+// Objects get increasing names, compiles and links always succeed and every program
+// reports the same active uniforms
+
+struct GlRecorderUniform
+{
+	std::string name;
+	GLenum type; // GL_FLOAT_MAT4, GL_SAMPLER_2D...
+	int size = 1;
+};
+
+// a glTexImage2D or glTexSubImage2D, with the unpack state it was made with
+struct GlRecorderTextureUpload
+{
+	int level;
+	int x, y, width, height;
+	int alignment;
+	int rowLength;
+	const void* pixels;
+
+	// the rows gl reads from pixels, tightly packed
+	std::vector<unsigned char> Read(int bytesPerPixel) const;
+};
+
+struct GlRecorder
+{
+	std::unordered_map<std::string, int> calls; // by gl function name
+	int bufferBytes = 0; // sent through glBufferData and glBufferSubData
+
+	std::vector<GlRecorderUniform> uniforms;
+	std::vector<GlRecorderTextureUpload> textureUploads;
+
+	// set through glPixelStorei and glTexParameteri, starts at the gl defaults
+	int unpackAlignment = 4;
+	int unpackRowLength = 0;
+	int textureMaxLevel = 1000; // of the last texture it was set on
+
+	int Count(const std::string& function) const;
+	int Total() const;
+
+	// clear the calls and uploads, not the uniforms or the unpack state
+	void Reset();
+};
+
+GlRecorder& gl_recorder();
+
+// point glad at the recorder, call before anything touches gl
+void gl_recorder_install();
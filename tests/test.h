@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+
+// Each test is its own executable, run by ctest. A failed check prints where it was and the
+// test returns non-zero from main. Benchmarks print their times but don't fail on them
+
+inline int& test_failures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(expr) if (!(expr)) { printf("%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #expr); test_failures() += 1; }
+
+#define TEST_RESULT() (test_failures() == 0 ? 0 : 1)
+
+// milliseconds since start
+inline float test_ms(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
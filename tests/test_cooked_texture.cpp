@@ -0,0 +1,128 @@
+// Cooked levels are tightly packed, so they are uploaded with an alignment of 1 and only
+// the bytes of each level are read
+
+#include "test.h"
+#include "gl_recorder.h"
+#include "Rendering.h"
+#include "io/CookedTexture.h"
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+
+// a 24 bit bmp, stb loads it with 3 channels
+static void write_bmp(const char* path, int width, int height, const std::vector<u8>& rgb)
+{
+	int stride = (width * 3 + 3) / 4 * 4;
+	int size = 54 + stride * height;
+
+	u8 header[54] = { 'B', 'M' };
+	auto put = [&](int offset, int value, int bytes) { for (int i = 0; i < bytes; i++) header[offset + i] = (u8)(value >> (i * 8)); };
+
+	put(2, size, 4);
+	put(10, 54, 4);
+	put(14, 40, 4);
+	put(18, width, 4);
+	put(22, height, 4);
+	put(26, 1, 2);
+	put(28, 24, 2);
+
+	FILE* file = fopen(path, "wb");
+	fwrite(header, 1, 54, file);
+
+	// bottom row first, each pixel is bgr
+	for (int y = height - 1; y >= 0; y--)
+	{
+		std::vector<u8> row(stride, 0);
+		for (int x = 0; x < width; x++)
+		{
+			const u8* pixel = &rgb[(x + y * width) * 3];
+			row[x * 3 + 0] = pixel[2];
+			row[x * 3 + 1] = pixel[1];
+			row[x * 3 + 2] = pixel[0];
+		}
+
+		fwrite(row.data(), 1, stride, file);
+	}
+
+	fclose(file);
+}
+
+static void test_rgb()
+{
+	const int width = 5, height = 3;
+
+	std::vector<u8> rgb;
+	for (int y = 0; y < height; y++)
+	for (int x = 0; x < width; x++)
+	{
+		rgb.push_back((u8)(x * 40));
+		rgb.push_back((u8)(y * 80));
+		rgb.push_back((u8)(x + y * width));
+	}
+
+	std::string folder = (std::filesystem::temp_directory_path() / "winter_test_cooked").string();
+	std::filesystem::create_directories(folder);
+
+	std::string imagePath = folder + "/rgb.bmp";
+	std::string cookedPath = imagePath + COOKED_TEXTURE_EXTENSION;
+
+	write_bmp(imagePath.c_str(), width, height, rgb);
+	CHECK(io_CookTexture(imagePath.c_str(), cookedPath.c_str()));
+
+	r<CookedTexture> cooked = io_MapCookedTexture(cookedPath.c_str());
+	CHECK(cooked);
+	if (!cooked) return;
+
+	// 5x3, 2x1, 1x1, none of the rows are a multiple of 4 bytes
+	CHECK(cooked->Header().channels == 3);
+	CHECK(cooked->MipCount() == 3);
+
+	Texture texture(imagePath, false);
+	CHECK(texture.Width() == width && texture.Height() == height);
+
+	// flipped for gl, so the last row of the image is first
+	for (int y = 0; y < height; y++)
+	for (int x = 0; x < width; x++)
+	{
+		const u8* pixel = &rgb[(x + y * width) * 3];
+		CHECK(memcmp(texture.Pixels() + texture.Index(x, height - 1 - y), pixel, 3) == 0);
+	}
+
+	gl_recorder().Reset();
+	texture.SendToDevice();
+
+	CHECK((int)gl_recorder().textureUploads.size() == cooked->MipCount());
+
+	for (const GlRecorderTextureUpload& upload : gl_recorder().textureUploads)
+	{
+		CookedTextureMip mip = cooked->Mip(upload.level);
+		CHECK(upload.width == mip.width && upload.height == mip.height);
+		CHECK(upload.alignment == 1);
+
+		std::vector<u8> expected((u8*)mip.pixels, (u8*)mip.pixels + mip.width * mip.height * 3);
+		CHECK(upload.Read(3) == expected);
+	}
+
+	CHECK(gl_recorder().unpackAlignment == 4);
+	CHECK(gl_recorder().textureMaxLevel == cooked->MipCount() - 1);
+
+	// writing to the host only updates the top level, so the old mips are dropped
+	texture.Set(0, 0, Color(255, 255, 255, 255));
+	texture.SendToDevice();
+	CHECK(gl_recorder().textureMaxLevel == 0);
+
+	cooked = nullptr;
+	texture = Texture();
+
+	std::error_code error;
+	std::filesystem::remove_all(folder, error);
+}
+
+int main()
+{
+	gl_recorder_install();
+
+	test_rgb();
+
+	return TEST_RESULT();
+}
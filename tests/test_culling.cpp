@@ -0,0 +1,300 @@
+// The quadtree and bvh find the same objects as testing every one of them
+
+#include "test.h"
+#include "ext/rendering/Culling.h"
+#include "ext/rendering/SpriteCullIndex.h"
+#include "ext/rendering/Sprite.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+#include <random>
+
+static std::mt19937 rng(1);
+
+static float random_float(float min, float max)
+{
+	return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+static aabb2D random_rect(float world, float maxSize)
+{
+	vec2 min = vec2(random_float(-world, world), random_float(-world, world));
+	return aabb2D(min, min + vec2(random_float(0.f, maxSize), random_float(0.f, maxSize)));
+}
+
+static CullBounds random_box(float world, float maxSize)
+{
+	vec3 min = vec3(random_float(-world, world), random_float(-world, world), random_float(-world, world));
+	return CullBounds(min, min + vec3(random_float(0.f, maxSize), random_float(0.f, maxSize), random_float(0.f, maxSize)));
+}
+
+static bool overlaps(const aabb2D& a, const aabb2D& b)
+{
+	return a.min.x <= b.max.x && a.max.x >= b.min.x
+		&& a.min.y <= b.max.y && a.max.y >= b.min.y;
+}
+
+static std::vector<u32> sorted(std::vector<u32> users)
+{
+	std::sort(users.begin(), users.end());
+	return users;
+}
+
+static void test_quadtree()
+{
+	const int count = 5000;
+
+	// some are bigger than a cell, or outside of the world and end up in the root
+	CullQuadtree tree(aabb2D(vec2(-1024.f), vec2(1024.f)), 8);
+	std::vector<aabb2D> rects;
+	std::vector<int> proxies;
+
+	for (int i = 0; i < count; i++)
+	{
+		rects.push_back(random_rect(1200.f, i % 100 == 0 ? 400.f : 8.f));
+		proxies.push_back(tree.Insert(rects.back(), i));
+	}
+
+	auto check = [&](const aabb2D& view)
+	{
+		std::vector<u32> expected;
+		for (int i = 0; i < count; i++)
+		{
+			if (proxies[i] != -1 && overlaps(view, rects[i]))
+				expected.push_back(i);
+		}
+
+		std::vector<u32> visible;
+		tree.Query(view, visible);
+
+		CHECK(sorted(visible) == expected);
+	};
+
+	for (int i = 0; i < 20; i++) check(random_rect(1024.f, 300.f));
+	check(aabb2D(vec2(-2000.f), vec2(2000.f)));
+
+	// move some a little and some across the world
+	for (int i = 0; i < count; i += 3)
+	{
+		rects[i] = i % 2 ? random_rect(1200.f, 8.f) : aabb2D(rects[i].min + vec2(1.f), rects[i].max + vec2(1.f));
+		tree.Update(proxies[i], rects[i]);
+	}
+
+	for (int i = 0; i < count; i += 7)
+	{
+		tree.Remove(proxies[i]);
+		proxies[i] = -1;
+	}
+
+	CHECK(tree.Count() == count - (count + 6) / 7);
+
+	for (int i = 0; i < 20; i++) check(random_rect(1024.f, 300.f));
+}
+
+static void test_bvh()
+{
+	const int count = 5000;
+
+	CullBVH tree(0.5f);
+	std::vector<CullBounds> boxes;
+	std::vector<int> proxies;
+
+	for (int i = 0; i < count; i++)
+	{
+		boxes.push_back(random_box(500.f, 10.f));
+		proxies.push_back(tree.Insert(boxes.back(), i));
+	}
+
+	auto check = [&](const Frustum& frustum)
+	{
+		std::vector<u32> expected;
+		for (int i = 0; i < count; i++)
+		{
+			if (proxies[i] != -1 && frustum.Test(boxes[i]) != CULL_OUTSIDE)
+				expected.push_back(i);
+		}
+
+		std::vector<u32> visible;
+		tree.Query(frustum, visible);
+
+		CHECK(sorted(visible) == expected);
+	};
+
+	mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 400.f);
+
+	for (int i = 0; i < 10; i++)
+	{
+		vec3 eye = vec3(random_float(-500.f, 500.f), random_float(-500.f, 500.f), random_float(-500.f, 500.f));
+		check(Frustum::FromMatrix(projection * glm::lookAt(eye, vec3(0.f), vec3(0.f, 1.f, 0.f))));
+	}
+
+	// small moves stay in the margin and don't touch the tree
+	int reinserted = 0;
+	for (int i = 0; i < count; i++)
+	{
+		vec3 move = i % 2 ? vec3(0.1f) : vec3(random_float(-50.f, 50.f));
+		boxes[i] = CullBounds(boxes[i].min + move, boxes[i].max + move);
+		reinserted += tree.Update(proxies[i], boxes[i]);
+	}
+
+	CHECK(reinserted <= count / 2);
+
+	for (int i = 0; i < count; i += 5)
+	{
+		tree.Remove(proxies[i]);
+		proxies[i] = -1;
+	}
+
+	CHECK(tree.Count() == count - count / 5);
+
+	for (int i = 0; i < 10; i++)
+	{
+		vec3 eye = vec3(random_float(-500.f, 500.f), random_float(-500.f, 500.f), random_float(-500.f, 500.f));
+		check(Frustum::FromMatrix(projection * glm::lookAt(eye, vec3(0.f), vec3(0.f, 1.f, 0.f))));
+	}
+
+	// stays balanced, a perfect tree of 4000 leaves is 12 high
+	CHECK(tree.Height() < 30);
+}
+
+static void test_arrays()
+{
+	const int count = 1001; // not a multiple of 4, so the tail is tested too
+
+	std::vector<float> minX(count), minY(count), maxX(count), maxY(count);
+	std::vector<aabb2D> rects;
+
+	for (int i = 0; i < count; i++)
+	{
+		rects.push_back(random_rect(100.f, 10.f));
+		minX[i] = rects[i].min.x; minY[i] = rects[i].min.y;
+		maxX[i] = rects[i].max.x; maxY[i] = rects[i].max.y;
+	}
+
+	aabb2D view = aabb2D(vec2(-30.f), vec2(40.f));
+
+	std::vector<int> visible(count);
+	visible.resize(CullRects(view, minX.data(), minY.data(), maxX.data(), maxY.data(), count, visible.data()));
+
+	std::vector<int> expected;
+	for (int i = 0; i < count; i++)
+	{
+		if (overlaps(view, rects[i]))
+			expected.push_back(i);
+	}
+
+	CHECK(visible == expected);
+}
+
+// the index follows the sprites' transforms, and drops entities that lost their sprite
+static void test_sprite_index()
+{
+	EntityWorld world;
+	std::vector<Entity> entities;
+
+	for (int i = 0; i < 2000; i++)
+	{
+		Entity entity = world.Create();
+		entity.Add<Transform2D>(vec2(random_float(-1000.f, 1000.f), random_float(-1000.f, 1000.f)), vec2(random_float(0.5f, 4.f)));
+		entity.Add<Sprite>();
+		entities.push_back(entity);
+	}
+
+	// no sprite, never in the index
+	world.Create().Add<Transform2D>();
+
+	SpriteCullIndex index;
+
+	auto check = [&](const aabb2D& view)
+	{
+		std::vector<u32> expected;
+		for (auto [entity, transform, sprite] : world.QueryWithEntity<Transform2D, Sprite>())
+		{
+			if (overlaps(view, SpriteCullIndex::SpriteBounds(transform)))
+				expected.push_back(entity.Id());
+		}
+
+		std::vector<u32> visible;
+		index.Query(view, visible);
+
+		CHECK(sorted(visible) == sorted(expected));
+	};
+
+	index.Sync(world);
+	CHECK(index.Count() == 2000);
+
+	for (int i = 0; i < 10; i++) check(random_rect(1000.f, 300.f));
+
+	for (int i = 0; i < 2000; i += 3)
+		entities[i].Get<Transform2D>().position += vec2(random_float(-200.f, 200.f), random_float(-200.f, 200.f));
+
+	for (int i = 1; i < 2000; i += 7)
+		entities[i].Destroy();
+
+	for (int i = 2; i < 2000; i += 11)
+	{
+		if (entities[i].IsAlive())
+			entities[i].Remove<Sprite>();
+	}
+
+	index.Sync(world);
+	CHECK((index.Count() == world.GetNumberOf<Transform2D, Sprite>()));
+
+	for (int i = 0; i < 10; i++) check(random_rect(1000.f, 300.f));
+}
+
+// a view of a small part of a large world, the tree against testing everything
+static void bench_quadtree()
+{
+	const int count = 200000;
+
+	CullQuadtree tree(aabb2D(vec2(-8192.f), vec2(8192.f)), 10);
+	std::vector<float> minX, minY, maxX, maxY;
+
+	for (int i = 0; i < count; i++)
+	{
+		aabb2D rect = random_rect(8192.f, 4.f);
+		tree.Insert(rect, i);
+
+		minX.push_back(rect.min.x); minY.push_back(rect.min.y);
+		maxX.push_back(rect.max.x); maxY.push_back(rect.max.y);
+	}
+
+	aabb2D view = aabb2D(vec2(-512.f, -288.f), vec2(512.f, 288.f));
+	std::vector<u32> visible;
+	std::vector<int> all(count);
+
+	const int runs = 100;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < runs; i++)
+	{
+		visible.clear();
+		tree.Query(view, visible);
+	}
+	float treeMs = test_ms(start) / runs;
+
+	int allCount = 0;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < runs; i++)
+	{
+		allCount = CullRects(view, minX.data(), minY.data(), maxX.data(), maxY.data(), count, all.data());
+	}
+	float allMs = test_ms(start) / runs;
+
+	printf("bench: %d of %d visible, quadtree %.3f ms, testing every rect %.3f ms\n", (int)visible.size(), count, treeMs, allMs);
+	CHECK((int)visible.size() == allCount);
+}
+
+int main()
+{
+	meta::CreateContext();
+
+	test_quadtree();
+	test_bvh();
+	test_arrays();
+	test_sprite_index();
+	bench_quadtree();
+
+	return TEST_RESULT();
+}
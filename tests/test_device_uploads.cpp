@@ -0,0 +1,215 @@
+// Only the regions written since the last SendToDevice are uploaded, see DirtyRegions
+
+#include "test.h"
+#include "gl_recorder.h"
+#include "Rendering.h"
+#include "util/gl_state.h"
+
+// the bytes sent since the last call
+static int uploaded()
+{
+	gl_state_end_frame();
+	return gl_state_frame_counters().bytesUploaded;
+}
+
+static void test_regions()
+{
+	DirtyRegions dirty;
+
+	dirty.Add(0, 4);
+	dirty.Add(4, 8); // touches
+	CHECK(dirty.regions.size() == 1);
+	CHECK(dirty.regions[0].minX == 0 && dirty.regions[0].maxX == 8);
+
+	dirty.Add(20, 24);
+	dirty.Add(6, 21); // joins both
+	CHECK(dirty.regions.size() == 1);
+	CHECK(dirty.regions[0].minX == 0 && dirty.regions[0].maxX == 24);
+
+	dirty.Clear();
+
+	for (int i = 0; i < DIRTY_MAX_REGIONS + 1; i++)
+		dirty.Add(i * 10, i * 10 + 1);
+
+	CHECK(dirty.regions.size() == 1); // collapsed into the bounds
+	CHECK(dirty.regions[0].minX == 0 && dirty.regions[0].maxX == DIRTY_MAX_REGIONS * 10 + 1);
+}
+
+static void test_texture()
+{
+	const int full = 64 * 64 * 4;
+
+	Texture texture(64, 64, Texture::uRGBA, false);
+	texture.SendToDevice();
+	CHECK(uploaded() == full);
+
+	gl_recorder().Reset();
+	texture.Set(3, 4, Color(255, 0, 0, 255));
+	texture.SendToDevice();
+	CHECK(uploaded() == 4);
+	CHECK(gl_recorder().Count("glTexSubImage2D") == 1);
+	CHECK(gl_recorder().Count("glTexImage2D") == 0);
+
+	gl_recorder().Reset();
+	texture.Set(4, 4, Color(255, 0, 0, 255));
+	texture.Set(5, 4, Color(255, 0, 0, 255));
+	texture.SendToDevice();
+	CHECK(uploaded() == 8);
+	CHECK(gl_recorder().Count("glTexSubImage2D") == 1);
+
+	gl_recorder().Reset();
+	texture.Set(0, 0, Color(255, 0, 0, 255));
+	texture.Set(60, 60, Color(255, 0, 0, 255));
+	texture.SendToDevice();
+	CHECK(uploaded() == 8);
+	CHECK(gl_recorder().Count("glTexSubImage2D") == 2);
+
+	texture.MarkRegionForUpdate(8, 8, 16, 4);
+	texture.SendToDevice();
+	CHECK(uploaded() == 16 * 4 * 4);
+
+	// clipped to the texture
+	texture.MarkRegionForUpdate(60, 60, 16, 16);
+	texture.SendToDevice();
+	CHECK(uploaded() == 4 * 4 * 4);
+
+	// a full update wins over the rects
+	gl_recorder().Reset();
+	texture.Set(1, 1, Color(255, 0, 0, 255));
+	texture.MarkForUpdate();
+	texture.Set(2, 2, Color(255, 0, 0, 255));
+	texture.SendToDevice();
+	CHECK(uploaded() == full);
+	CHECK(gl_recorder().Count("glTexImage2D") == 1);
+	CHECK(gl_recorder().Count("glTexSubImage2D") == 0);
+
+	// nothing changed
+	texture.SendToDevice();
+	CHECK(uploaded() == 0);
+
+	// a copy isn't on the device yet, so it is sent whole
+	texture.Set(7, 7, Color(255, 0, 0, 255));
+	Texture copy = texture;
+	copy.SendToDevice();
+	CHECK(uploaded() == full);
+}
+
+static void test_buffer()
+{
+	std::vector<float> floats(256, 1.f);
+
+	Buffer buffer(0, 1, Buffer::eFloat, false);
+	buffer.Set(floats);
+	buffer.SendToDevice();
+	CHECK(uploaded() == 1024);
+
+	// grows the device storage by half, so the next push fits
+	buffer.Push(1.f);
+	buffer.SendToDevice();
+	CHECK(uploaded() == 1028);
+
+	gl_recorder().Reset();
+	buffer.Push(1.f);
+	buffer.SendToDevice();
+	CHECK(uploaded() == 4);
+	CHECK(gl_recorder().Count("glBufferData") == 0);
+	CHECK(gl_recorder().Count("glBufferSubData") == 1);
+
+	// everything after the erased element moved down
+	buffer.Erase(250);
+	buffer.SendToDevice();
+	CHECK(uploaded() == (257 - 250) * 4);
+
+	gl_recorder().Reset();
+	buffer.MarkRangeForUpdate(0, 8);
+	buffer.MarkRangeForUpdate(100, 8);
+	buffer.SendToDevice();
+	CHECK(uploaded() == 16);
+	CHECK(gl_recorder().Count("glBufferSubData") == 2);
+
+	// the device keeps the bytes, only the length changes
+	buffer.Pop();
+	buffer.SendToDevice();
+	CHECK(uploaded() == 0);
+
+	buffer.Set(floats);
+	buffer.SendToDevice();
+	CHECK(uploaded() == 1024);
+}
+
+// rows that aren't a multiple of 4 bytes, gl would skip to the next 4 byte boundary for each row
+static void test_unpack()
+{
+	Texture texture(5, 3, Texture::uRGB, false);
+
+	for (int y = 0; y < 3; y++)
+	for (int x = 0; x < 5; x++)
+	{
+		texture.Set(x, y, Color(x, y, x * 10 + y, 255));
+	}
+
+	gl_recorder().Reset();
+	texture.SendToDevice();
+
+	CHECK(gl_recorder().textureUploads.size() == 1);
+	CHECK(gl_recorder().textureUploads[0].Read(3) == std::vector<u8>(texture.Pixels(), texture.Pixels() + texture.BufferSize()));
+
+	gl_recorder().Reset();
+	texture.Set(1, 0, Color(200, 201, 202, 255));
+	texture.Set(3, 2, Color(210, 211, 212, 255));
+	texture.MarkRegionForUpdate(1, 0, 3, 3);
+	texture.SendToDevice();
+
+	CHECK(gl_recorder().textureUploads.size() == 1);
+
+	std::vector<u8> expected;
+	for (int y = 0; y < 3; y++)
+	for (int x = 1; x < 4; x++)
+	{
+		const u8* pixel = texture.Pixels() + (x + y * 5) * 3;
+		expected.insert(expected.end(), pixel, pixel + 3);
+	}
+
+	CHECK(gl_recorder().textureUploads[0].Read(3) == expected);
+
+	// put back for the next upload
+	CHECK(gl_recorder().unpackAlignment == 4);
+	CHECK(gl_recorder().unpackRowLength == 0);
+}
+
+// an edit in a large texture, what the tracking saves over sending the whole texture
+static void bench_texture()
+{
+	Texture texture(1024, 1024, Texture::uRGBA, false);
+	texture.SendToDevice();
+	uploaded();
+
+	const int edits = 1000;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < edits; i++)
+	{
+		texture.Set(i % 1024, (i * 7) % 1024, Color(255, 255, 255, 255));
+		texture.SendToDevice();
+	}
+
+	float ms = test_ms(start);
+	int bytes = uploaded();
+
+	printf("bench: %d single pixel edits in 1024x1024: %d bytes uploaded, %d for each full update, %.3f ms\n", edits, bytes, texture.BufferSize(), ms);
+	CHECK(bytes == edits * 4);
+}
+
+int main()
+{
+	gl_recorder_install();
+
+	test_regions();
+	test_texture();
+	test_buffer();
+	test_unpack();
+	bench_texture();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,80 @@
+// The state cache skips binds of what's already bound
+
+#include "test.h"
+#include "gl_recorder.h"
+#include "Rendering.h"
+#include "util/gl_state.h"
+
+static GlStateCounters end_frame()
+{
+	gl_state_end_frame();
+	return gl_state_frame_counters();
+}
+
+static void test_redundant_binds()
+{
+	gl_state_invalidate();
+	gl_state_end_frame();
+	gl_recorder().Reset();
+
+	gl_state_use_program(5);
+	gl_state_use_program(5);
+	gl_state_use_program(6);
+	CHECK(gl_recorder().Count("glUseProgram") == 2);
+
+	gl_state_bind_vertex_array(3);
+	gl_state_bind_vertex_array(3);
+	gl_state_bind_vertex_array(3);
+	CHECK(gl_recorder().Count("glBindVertexArray") == 1);
+
+	gl_state_bind_framebuffer(0);
+	gl_state_bind_framebuffer(0);
+	CHECK(gl_recorder().Count("glBindFramebuffer") == 1);
+
+	// each unit has its own binding
+	gl_state_bind_texture_unit(0, GL_TEXTURE_2D, 7);
+	gl_state_bind_texture_unit(1, GL_TEXTURE_2D, 7);
+	gl_state_bind_texture_unit(0, GL_TEXTURE_2D, 7);
+	gl_state_bind_texture_unit(1, GL_TEXTURE_2D, 7);
+	CHECK(gl_recorder().Count("glBindTexture") == 2);
+	CHECK(gl_recorder().Count("glActiveTexture") == 4);
+
+	gl_state_blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_state_blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_state_blend(true, GL_SRC_ALPHA, GL_ONE);
+	CHECK(gl_recorder().Count("glEnable") == 1);
+	CHECK(gl_recorder().Count("glBlendFunc") == 2);
+
+	// a deleted name can come back as a new object, so it has to be bound again
+	gl_state_forget_program(6);
+	gl_state_use_program(6);
+	CHECK(gl_recorder().Count("glUseProgram") == 3);
+
+	gl_state_forget_texture(7);
+	gl_state_bind_texture_unit(1, GL_TEXTURE_2D, 7);
+	CHECK(gl_recorder().Count("glBindTexture") == 3);
+
+	// after something else changed the state, nothing is assumed
+	gl_state_invalidate();
+	gl_state_use_program(6);
+	gl_state_bind_vertex_array(3);
+	CHECK(gl_recorder().Count("glUseProgram") == 4);
+	CHECK(gl_recorder().Count("glBindVertexArray") == 2);
+
+	GlStateCounters counters = end_frame();
+	CHECK(counters.issued == gl_recorder().Total());
+	CHECK(counters.skipped == 10);
+
+	// rolled over
+	CHECK(end_frame().issued == 0);
+}
+
+int main()
+{
+	gl_recorder_install();
+	Render::CreateContext();
+
+	test_redundant_binds();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,115 @@
+// Islands solved across a thread pool give the same result as solving them on one thread, with
+// every pile of boxes on one static ground, and the bodies stepped per ms for each thread count
+
+#include "test.h"
+#include "Physics.h"
+#include "Entity.h"
+#include "util/thread_pool.h"
+#include "ext/serial/serial_common.h"
+#include <random>
+
+// the world is declared first, so the entities are destroyed before it
+struct PileScene
+{
+	PhysicsWorld physics;
+	EntityWorld entities;
+	std::vector<Entity> boxes;
+
+	PileScene(int piles, int height)
+	{
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> jitter(-0.1f, 0.1f);
+
+		// one ground under every pile, so each island has the same static body
+		Entity ground = entities.Create();
+		ground.Add<Rigidbody2D>().AddCollider(HullCollider().SetPointsBox(piles * 4.f, 0.5f));
+		physics.Add(ground);
+		ground.Get<Rigidbody2D>().SetType(Rigidbody2D::Static);
+
+		for (int i = 0; i < piles; i++)
+		for (int j = 0; j < height; j++)
+		{
+			Entity box = entities.Create();
+			box.Add<Rigidbody2D>().AddCollider(HullCollider().SetPointsBox(0.5f, 0.5f));
+			physics.Add(box);
+
+			float x = (i - piles / 2) * 4.f + jitter(rng);
+			box.Get<Rigidbody2D>().SetPosition(vec2(x, 1.1f + j * 1.05f));
+			box.Get<Rigidbody2D>().SetVelocity(vec2(0.f, -4.f));
+
+			boxes.push_back(box);
+		}
+	}
+
+	std::vector<float> State() const
+	{
+		std::vector<float> state;
+		for (const Entity& box : boxes)
+		{
+			const Rigidbody2D& body = box.Get<Rigidbody2D>();
+			state.push_back(body.GetPosition().x);
+			state.push_back(body.GetPosition().y);
+			state.push_back(body.GetVelocity().x);
+			state.push_back(body.GetVelocity().y);
+			state.push_back(body.GetAngle());
+		}
+
+		return state;
+	}
+};
+
+// steps a scene with threads solving islands, 0 for the calling thread
+static void run_piles(int threads, int steps, std::vector<float>& state)
+{
+	PileScene scene(200, 10);
+
+	r<thread_pool> pool;
+	if (threads > 0)
+	{
+		pool = mkr<thread_pool>(threads);
+		scene.physics.SetThreadPool(pool.get(), true);
+	}
+
+	int islands = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < steps; i++)
+	{
+		scene.physics.Tick(1.f / 60.f);
+		islands = max(islands, scene.physics.GetStats().islands);
+	}
+
+	float ms = test_ms(start);
+
+	// the piles only touch through the ground
+	CHECK(islands >= 200);
+
+	state = scene.State();
+	scene.physics.SetThreadPool(nullptr);
+
+	printf("bench: %d bodies for %d steps with %d threads in %.1f ms, %.0f bodies per ms\n",
+		(int)scene.boxes.size(), steps, threads, ms, scene.boxes.size() * steps / ms);
+}
+
+static void test_determinism()
+{
+	std::vector<float> serial;
+	run_piles(0, 120, serial);
+
+	for (int threads : { 2, 4, 8 })
+	{
+		std::vector<float> threaded;
+		run_piles(threads, 120, threaded);
+		CHECK(threaded == serial);
+	}
+}
+
+int main()
+{
+	meta::CreateContext();
+	register_common_types();
+
+	test_determinism();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,479 @@
+// Snapshots restore the world bit for bit, closest point queries match testing every body, lod
+// skips the bodies far from the focus, writes to bodies are staged until they are flushed,
+// interpolated poses run from the last step to the current one, batched queries match the
+// single queries, and contacts of bodies removed by a collision function aren't sent
+
+#include "test.h"
+#include "Physics.h"
+#include "Entity.h"
+#include "util/thread_pool.h"
+#include "ext/serial/serial_bin.h"
+#include "ext/serial/serial_common.h"
+#include <random>
+#include <sstream>
+
+static std::mt19937 rng(1);
+
+static float random_float(float min, float max)
+{
+	return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+struct Circle
+{
+	Entity entity;
+	vec2 position;
+	float radius;
+};
+
+// the world is declared first, so the entities are destroyed before it
+struct TestWorld
+{
+	PhysicsWorld physics;
+	EntityWorld entities;
+	std::vector<Circle> circles;
+
+	void Add(vec2 position, float radius, vec2 velocity = vec2(0.f))
+	{
+		Entity entity = entities.Create();
+		Rigidbody2D& body = entity.Add<Rigidbody2D>();
+		body.AddCollider(CircleCollider(radius));
+		physics.Add(entity);
+
+		entity.Get<Rigidbody2D>().SetPosition(position);
+		entity.Get<Rigidbody2D>().SetVelocity(velocity);
+
+		circles.push_back({ entity, position, radius });
+	}
+
+	// a pile of circles falling together, so there are lots of contacts
+	void AddPile(int count, float size)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			vec2 position = vec2(random_float(-size, size), random_float(-size, size));
+			Add(position, random_float(0.2f, 0.6f), -position);
+		}
+	}
+
+	std::vector<float> State() const
+	{
+		std::vector<float> state;
+		for (const Circle& circle : circles)
+		{
+			const Rigidbody2D& body = circle.entity.Get<Rigidbody2D>();
+			state.push_back(body.GetPosition().x);
+			state.push_back(body.GetPosition().y);
+			state.push_back(body.GetVelocity().x);
+			state.push_back(body.GetVelocity().y);
+			state.push_back(body.GetAngle());
+		}
+
+		return state;
+	}
+
+	void Step(int steps)
+	{
+		for (int i = 0; i < steps; i++)
+			physics.Tick(1.f / 60.f);
+	}
+};
+
+static void test_snapshot()
+{
+	TestWorld world;
+	world.AddPile(2000, 40.f);
+	world.Step(10);
+
+	PhysicsSnapshot snapshot;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	world.physics.Snapshot(snapshot);
+	float saveMs = test_ms(start);
+
+	world.Step(30);
+	std::vector<float> expected = world.State();
+
+	start = std::chrono::high_resolution_clock::now();
+	CHECK(world.physics.Restore(snapshot));
+	float restoreMs = test_ms(start);
+
+	world.Step(30);
+	CHECK(world.State() == expected);
+
+	printf("bench: snapshot of %d bodies is %d bytes, saved in %.3f ms, restored in %.3f ms\n", (int)world.circles.size(), (int)snapshot.bytes.size(), saveMs, restoreMs);
+
+	// through a file, then again
+	std::stringstream file;
+	bin_writer(file).write(snapshot);
+
+	PhysicsSnapshot read;
+	bin_reader(file).read(read);
+	CHECK(read.bytes == snapshot.bytes);
+
+	CHECK(world.physics.Restore(read));
+	world.Step(30);
+	CHECK(world.State() == expected);
+
+	// a bad snapshot doesn't change anything
+	std::vector<float> before = world.State();
+
+	PhysicsSnapshot truncated = snapshot;
+	truncated.bytes.resize(truncated.bytes.size() / 2);
+	CHECK(!world.physics.Restore(truncated));
+	CHECK(world.State() == before);
+
+	TestWorld other;
+	other.AddPile(10, 5.f);
+
+	PhysicsSnapshot small;
+	other.physics.Snapshot(small);
+	CHECK(!world.physics.Restore(small));
+	CHECK(world.State() == before);
+}
+
+static void test_closest()
+{
+	TestWorld world;
+
+	for (int i = 0; i < 500; i++)
+		world.Add(vec2(random_float(-100.f, 100.f), random_float(-100.f, 100.f)), random_float(0.2f, 3.f));
+
+	world.physics.Tick(0.f);
+
+	std::vector<PhysicsClosestQuery> queries;
+	for (int i = 0; i < 1000; i++)
+		queries.push_back({ vec2(random_float(-110.f, 110.f), random_float(-110.f, 110.f)), i % 4 ? FLT_MAX : 5.f, -1 });
+
+	// the ignored body is the closest one, so the next one has to be found
+	queries[0] = { world.circles[7].position, FLT_MAX, (int)world.circles[7].entity.Id() };
+
+	std::vector<PhysicsClosestHit> hits(queries.size());
+	world.physics.QueryClosest(queries, hits);
+
+	for (int i = 0; i < (int)queries.size(); i++)
+	{
+		const PhysicsClosestQuery& query = queries[i];
+
+		float expected = FLT_MAX;
+		for (const Circle& circle : world.circles)
+		{
+			if ((int)circle.entity.Id() == query.ignoreEntity)
+				continue;
+
+			expected = min(expected, max(0.f, length(query.point - circle.position) - circle.radius));
+		}
+
+		bool hit = expected < query.maxDistance;
+
+		CHECK(hits[i].hit == hit);
+
+		if (hit)
+		{
+			CHECK(abs(hits[i].distance - expected) < 0.001f);
+			CHECK(hits[i].entity != query.ignoreEntity);
+		}
+
+		PhysicsClosestHit single = world.physics.QueryClosest(query.point, query.maxDistance, query.ignoreEntity);
+		CHECK(single.hit == hits[i].hit);
+		CHECK(!hit || (single.entity == hits[i].entity && single.distance == hits[i].distance));
+	}
+}
+
+static void test_lod()
+{
+	TestWorld world;
+
+	// a pile at the focus and one far away, moving so they don't sleep
+	for (int i = 0; i < 50; i++)
+	{
+		world.Add(vec2(random_float(-5.f, 5.f), random_float(-5.f, 5.f)), 0.5f, vec2(1.f, 0.f));
+		world.Add(vec2(random_float(995.f, 1005.f), random_float(-5.f, 5.f)), 0.5f, vec2(1.f, 0.f));
+	}
+
+	world.physics.SetIterations(4, 2);
+	world.Step(1);
+
+	const PhysicsStats& stats = world.physics.GetStats();
+	CHECK(stats.bodies == 100);
+	CHECK(stats.awakeBodies == 100);
+	CHECK(stats.contacts > 0);
+	CHECK(stats.skippedIslands == 0);
+
+	world.physics.SetLodLevels({ { 100.f, 4 } });
+	world.physics.SetLodFocus({ vec2(0.f) });
+
+	int skipped = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		world.Step(1);
+		skipped += world.physics.GetStats().skippedIslands;
+	}
+
+	CHECK(skipped > 0);
+
+	// the far bodies still move, only less often
+	const Circle& far = world.circles[1];
+	CHECK(far.entity.Get<Rigidbody2D>().GetPosition().x > far.position.x);
+}
+
+static void test_poses()
+{
+	TestWorld world;
+	world.Add(vec2(0.f), 1.f);
+	world.Add(vec2(10.f, 0.f), 1.f, vec2(1.f, 0.f));
+	world.Step(1);
+
+	Rigidbody2D& body = world.circles[0].entity.Get<Rigidbody2D>();
+
+	// reads see the write right away, box2d doesn't until the flush
+	body.SetPosition(vec2(50.f, 0.f));
+	CHECK(body.GetPosition() == vec2(50.f, 0.f));
+	CHECK(world.physics.QueryPoint(vec2(0.f), 0.1f).HasResult());
+	CHECK(!world.physics.QueryPoint(vec2(50.f, 0.f), 0.1f).HasResult());
+
+	world.physics.Flush();
+	CHECK(!world.physics.QueryPoint(vec2(0.f), 0.1f).HasResult());
+	CHECK(world.physics.QueryPoint(vec2(50.f, 0.f), 0.1f).FirstDistance() < 0.001f);
+
+	// a still body falls asleep, and keeps its pose while it isn't copied
+	world.Step(120);
+
+	const PhysicsPoses& poses = world.physics.GetPoses();
+	CHECK(!poses.awake[body.GetProxy()]);
+	CHECK(poses.awake[world.circles[1].entity.Get<Rigidbody2D>().GetProxy()]);
+	CHECK(body.GetPosition() == vec2(50.f, 0.f));
+	CHECK(body.GetVelocity() == vec2(0.f));
+
+	// moving a sleeping body by hand sticks through the next steps
+	body.SetPosition(vec2(60.f, 0.f));
+	world.Step(5);
+	CHECK(body.GetPosition() == vec2(60.f, 0.f));
+	CHECK(world.physics.QueryPoint(vec2(60.f, 0.f), 0.1f).HasResult());
+
+	// the moving body is copied each step
+	CHECK(world.circles[1].entity.Get<Rigidbody2D>().GetPosition().x > 10.f);
+}
+
+static void test_interpolation()
+{
+	TestWorld world;
+	world.Add(vec2(0.f), 1.f, vec2(6.f, 3.f));
+	world.Step(1);
+
+	Rigidbody2D& body = world.circles[0].entity.Get<Rigidbody2D>();
+	body.SetAngularVelocity(2.f);
+	world.Step(1);
+
+	vec2 last = body.GetPosition();
+	float lastAngle = body.GetAngle();
+	world.Step(1);
+
+	vec2 current = body.GetPosition();
+	float currentAngle = body.GetAngle();
+	CHECK(current != last);
+	CHECK(currentAngle != lastAngle);
+
+	world.physics.SetInterpolationAlpha(0.f);
+	CHECK(body.GetInterpolatedPosition() == last);
+	CHECK(body.GetInterpolatedAngle() == lastAngle);
+
+	world.physics.SetInterpolationAlpha(1.f);
+	CHECK(body.GetInterpolatedPosition() == current);
+	CHECK(body.GetInterpolatedAngle() == currentAngle);
+
+	world.physics.SetInterpolationAlpha(0.5f);
+	CHECK(length(body.GetInterpolatedPosition() - (last + current) / 2.f) < 0.0001f);
+
+	// the scale is left alone
+	Transform2D transform(vec2(0.f), vec2(3.f));
+	world.physics.SetInterpolationAlpha(0.f);
+	body.InterpolateTransform(transform);
+	CHECK(transform.position == last);
+	CHECK(transform.rotation == lastAngle);
+	CHECK(transform.scale == vec2(3.f));
+
+	// a body moved by hand doesn't slide from where it was
+	body.SetPosition(vec2(100.f, 0.f));
+	world.Step(1);
+	CHECK(length(body.GetInterpolatedPosition() - vec2(100.f, 0.f)) < 0.0001f);
+}
+
+static bool same_ray_hit(const PhysicsRayHit& a, const PhysicsRayHit& b)
+{
+	return a.hit == b.hit && a.entity == b.entity && a.fixture == b.fixture && a.distance == b.distance;
+}
+
+static bool same_point_hit(const PhysicsPointHit& a, const PhysicsPointHit& b)
+{
+	return a.hit == b.hit && a.entity == b.entity && a.fixture == b.fixture && a.distance == b.distance;
+}
+
+static void test_queries()
+{
+	TestWorld world;
+
+	for (int i = 0; i < 500; i++)
+		world.Add(vec2(random_float(-100.f, 100.f), random_float(-100.f, 100.f)), random_float(0.2f, 3.f));
+
+	world.physics.Tick(0.f);
+
+	std::vector<PhysicsRay> rays;
+	for (int i = 0; i < 1000; i++)
+		rays.push_back({ vec2(random_float(-110.f, 110.f), random_float(-110.f, 110.f)), vec2(random_float(-110.f, 110.f), random_float(-110.f, 110.f)) });
+
+	rays[0].target = rays[0].point; // zero length rays miss
+
+	std::vector<PhysicsRayHit> closest(rays.size());
+	std::vector<PhysicsRayHit> any(rays.size());
+	world.physics.QueryRays(rays, closest, QUERY_CLOSEST);
+	world.physics.QueryRays(rays, any, QUERY_ANY);
+
+	int rayHits = 0;
+	for (int i = 0; i < (int)rays.size(); i++)
+	{
+		RayQueryResult single;
+		if (rays[i].point != rays[i].target)
+			single = world.physics.QueryRay(rays[i].point, rays[i].target);
+
+		CHECK(closest[i].hit == single.HasResult());
+		CHECK(any[i].hit == single.HasResult());
+
+		if (!single.HasResult())
+		{
+			CHECK(closest[i].entity == -1);
+			continue;
+		}
+
+		rayHits += 1;
+
+		CHECK(closest[i].fixture == single.FirstResult().fixture);
+		CHECK(closest[i].distance == single.FirstDistance());
+		CHECK(closest[i].point == single.FirstPoint());
+		CHECK(closest[i].normal == single.FirstNormal());
+		CHECK(closest[i].entity == (int)closest[i].fixture->GetBody()->GetUserData().entityId);
+
+		// any hit is one of the hits along the ray
+		bool found = false;
+		for (const RayQueryResult::Result& result : single.results)
+			found |= result.fixture == any[i].fixture && result.distance == any[i].distance;
+
+		CHECK(found);
+	}
+
+	CHECK(rayHits > 0);
+
+	std::vector<PhysicsPointQuery> points;
+	for (int i = 0; i < 1000; i++)
+		points.push_back({ vec2(random_float(-110.f, 110.f), random_float(-110.f, 110.f)), random_float(0.f, 5.f) });
+
+	std::vector<PhysicsPointHit> closestPoints(points.size());
+	std::vector<PhysicsPointHit> anyPoints(points.size());
+	world.physics.QueryPoints(points, closestPoints, QUERY_CLOSEST);
+	world.physics.QueryPoints(points, anyPoints, QUERY_ANY);
+
+	int pointHits = 0;
+	for (int i = 0; i < (int)points.size(); i++)
+	{
+		const PhysicsPointQuery& query = points[i];
+
+		// QueryPoint stops at the first fixture, like QUERY_ANY
+		PointQueryResult single = world.physics.QueryPoint(query.point, query.radius);
+		CHECK(anyPoints[i].hit == single.HasResult());
+		CHECK(!single.HasResult() || anyPoints[i].distance == single.FirstDistance());
+
+		// the tree is searched with the fattened bounds of each fixture
+		float expected = FLT_MAX;
+		for (const Circle& circle : world.circles)
+		{
+			float reach = query.radius + circle.radius + b2_aabbExtension;
+			if (abs(query.point.x - circle.position.x) < reach && abs(query.point.y - circle.position.y) < reach)
+				expected = min(expected, distance(query.point, circle.position));
+		}
+
+		bool hit = expected != FLT_MAX;
+
+		CHECK(closestPoints[i].hit == hit);
+		CHECK(!hit || abs(closestPoints[i].distance - expected) < 0.0001f);
+		CHECK(!hit || closestPoints[i].distance <= anyPoints[i].distance);
+
+		pointHits += hit;
+	}
+
+	CHECK(pointHits > 0);
+
+	// the same hits when split across threads
+	thread_pool pool(4);
+	world.physics.SetThreadPool(&pool);
+
+	std::vector<PhysicsRayHit> threadedRays(rays.size());
+	world.physics.QueryRays(rays, threadedRays, QUERY_CLOSEST);
+
+	std::vector<PhysicsPointHit> threadedPoints(points.size());
+	world.physics.QueryPoints(points, threadedPoints, QUERY_CLOSEST);
+
+	for (int i = 0; i < (int)rays.size(); i++)
+		CHECK(same_ray_hit(threadedRays[i], closest[i]));
+
+	for (int i = 0; i < (int)points.size(); i++)
+		CHECK(same_point_hit(threadedPoints[i], closestPoints[i]));
+
+	world.physics.SetThreadPool(nullptr);
+}
+
+static void test_contact_removal()
+{
+	// each function takes the body or the colliders of the other entity, which stays alive
+	for (int clear = 0; clear < 2; clear++)
+	{
+		TestWorld world;
+		for (int i = 0; i < 3; i++)
+			world.Add(vec2(0.f), 1.f);
+
+		int calls = 0;
+		for (Circle& circle : world.circles)
+		{
+			circle.entity.Get<Rigidbody2D>().OnCollision += OnCollisionFunc([&calls, clear](CollisionInfo info)
+			{
+				// the contact of a removed body isn't sent, so it's still in box2d
+				CHECK(info.me.Has<Rigidbody2D>() && info.other.Has<Rigidbody2D>());
+				CHECK(info.contact->IsTouching());
+
+				Rigidbody2D& other = info.other.Get<Rigidbody2D>();
+				CHECK(other.GetColliderCount() == 1);
+
+				if (clear) other.ClearColliders();
+				else       info.other.Remove<Rigidbody2D>();
+
+				calls += 1;
+			});
+		}
+
+		world.Step(1);
+
+		// the first body sent takes the other two, and the contact between them is skipped
+		CHECK(calls == 2);
+
+		for (const Circle& circle : world.circles)
+			CHECK(circle.entity.IsAlive());
+
+		world.Step(1);
+		CHECK(calls == 2);
+	}
+}
+
+int main()
+{
+	meta::CreateContext();
+	register_common_types();
+
+	test_snapshot();
+	test_closest();
+	test_lod();
+	test_poses();
+	test_interpolation();
+	test_queries();
+	test_contact_removal();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,229 @@
+// Recorded draws are replayed sorted by key, into the target of the pass
+
+#include "test.h"
+#include "gl_recorder.h"
+#include "v2/Render/RenderCommands.h"
+#include <thread>
+
+// records what was replayed by pointer, so the order can be checked without a device
+struct TestBackend : RenderCommandBackend
+{
+	std::vector<const Target*> targets;
+	std::vector<const ShaderProgram*> pipelines;
+	std::vector<const Mesh*> draws;
+	std::vector<int> uniforms; // locations in the order they were set
+
+	void SetTarget(const r<Target>& target) override { targets.push_back(target.get()); }
+	void BindPipeline(const RenderPipeline& pipeline) override { pipelines.push_back(pipeline.program.get()); }
+	void SetUniform(ShaderProgram& /*program*/, const RenderUniform& uniform) override { uniforms.push_back(uniform.handle.location); }
+	void SetTexture(ShaderProgram& /*program*/, UniformHandle uniform, const r<Texture>& /*texture*/) override { uniforms.push_back(uniform.location); }
+	void Draw(Mesh& mesh, int /*instances*/) override { draws.push_back(&mesh); }
+};
+
+// the recorder gives each uniform its index as its location
+static r<ShaderProgram> make_program()
+{
+	gl_recorder().uniforms = {
+		{ "a",      GL_FLOAT },
+		{ "b",      GL_FLOAT },
+		{ "c",      GL_FLOAT },
+		{ "d",      GL_FLOAT },
+		{ "count",  GL_INT },
+		{ "thread", GL_INT },
+		{ "sprite", GL_SAMPLER_2D }
+	};
+
+	r<ShaderProgram> program = mkr<ShaderProgram>();
+	program->Add(ShaderProgram::sVertex, "void main() {}");
+	program->Add(ShaderProgram::sFragment, "void main() {}");
+	program->SendToDevice();
+
+	return program;
+}
+
+static void test_sorting()
+{
+	r<ShaderProgram> program = make_program();
+	r<Mesh> meshes[4] = { mkr<Mesh>(), mkr<Mesh>(), mkr<Mesh>(), mkr<Mesh>() };
+
+	RenderCommandQueue queue;
+	RenderCommandBuffer& first = queue.GetBuffer(0);
+	RenderCommandBuffer& second = queue.GetBuffer(1);
+
+	first.BindPipeline(program);
+	first.SetKey(2); first.BindMesh(meshes[0]); first.SetUniform("a", 1.f); first.Draw();
+	first.SetKey(0); first.BindMesh(meshes[1]); first.SetUniform("b", 1.f); first.Draw();
+
+	second.BindPipeline(program);
+	second.SetKey(1); second.BindMesh(meshes[2]); second.SetUniform("c", 1.f); second.Draw();
+	second.SetKey(0); second.BindMesh(meshes[3]); second.SetUniform("d", 1.f); second.DrawInstanced(10);
+
+	CHECK(queue.Count() == 4);
+
+	TestBackend backend;
+	queue.Replay(backend);
+
+	// same keys keep buffer order, then the order they were recorded in
+	CHECK(backend.draws.size() == 4);
+	CHECK(backend.draws[0] == meshes[1].get());
+	CHECK(backend.draws[1] == meshes[3].get());
+	CHECK(backend.draws[2] == meshes[2].get());
+	CHECK(backend.draws[3] == meshes[0].get());
+	CHECK((backend.uniforms == std::vector<int>{ 1, 3, 2, 0 }));
+
+	// the same pipeline is only bound once
+	CHECK(backend.pipelines.size() == 1);
+
+	queue.Clear();
+	CHECK(queue.Count() == 0);
+}
+
+// names are looked up when recorded, a handle skips the lookup
+static void test_handles()
+{
+	r<ShaderProgram> program = make_program();
+	r<Mesh> mesh = mkr<Mesh>();
+
+	RenderCommandQueue queue;
+	RenderCommandBuffer& buffer = queue.GetBuffer(0);
+	buffer.BindPipeline(program);
+	buffer.BindMesh(mesh);
+
+	buffer.SetUniform(program->Uniform("c"), 1.f);
+	buffer.SetUniform("c", 1.f);
+	buffer.SetUniform("missing", 1.f);
+	buffer.SetTexture("sprite", nullptr);
+	buffer.Draw();
+
+	TestBackend backend;
+	queue.Replay(backend);
+
+	CHECK((backend.uniforms == std::vector<int>{ 2, 2, -1, 6 }));
+}
+
+static void test_targets()
+{
+	r<ShaderProgram> program = make_program();
+	r<Mesh> mesh = mkr<Mesh>();
+	r<Target> pass = mkr<Target>();
+	r<Target> other = mkr<Target>();
+
+	RenderCommandQueue queue;
+
+	// nothing to draw, so nothing is bound
+	TestBackend empty;
+	queue.Replay(empty, pass);
+	CHECK(empty.targets.size() == 0);
+
+	RenderCommandBuffer& buffer = queue.GetBuffer(0);
+	buffer.BindPipeline(program);
+	buffer.BindMesh(mesh);
+
+	buffer.SetKey(0); buffer.Draw();
+	buffer.SetKey(1); buffer.SetTarget(other); buffer.Draw();
+	buffer.SetKey(2); buffer.Draw();
+	buffer.SetKey(3); buffer.SetTarget(nullptr); buffer.Draw();
+	buffer.SetKey(4); buffer.Draw();
+
+	TestBackend backend;
+	queue.Replay(backend, pass);
+
+	// the pass target is bound even if it looks current, _Run could have changed it
+	CHECK((backend.targets == std::vector<const Target*>{ pass.get(), other.get(), pass.get() }));
+	CHECK(backend.draws.size() == 5);
+
+	// nullptr is the default target
+	TestBackend screen;
+	queue.Replay(screen);
+	CHECK((screen.targets == std::vector<const Target*>{ nullptr, other.get(), nullptr }));
+}
+
+static void test_log()
+{
+	r<ShaderProgram> program = make_program();
+	r<Mesh> mesh = mkr<Mesh>();
+
+	RenderCommandQueue queue;
+	RenderCommandBuffer& buffer = queue.GetBuffer(0);
+	buffer.BindPipeline(program, false);
+	buffer.BindMesh(mesh);
+	buffer.SetUniform("count", 3);
+	buffer.SetTexture("sprite", nullptr);
+	buffer.DrawInstanced(2);
+
+	RenderCommandBackendLog log;
+	queue.Replay(log);
+
+	std::vector<std::string> expected = {
+		"target default",
+		"pipeline " + std::to_string(program->DeviceHandle()) + " additive",
+		"uniform 4 3",
+		"texture 6 null",
+		"draw 0 2"
+	};
+
+	CHECK(log.lines == expected);
+}
+
+// each thread records into its own buffer
+static void test_threads()
+{
+	r<ShaderProgram> program = make_program();
+	r<Mesh> mesh = mkr<Mesh>();
+
+	const int threads = 4;
+	const int draws = 1000;
+
+	RenderCommandQueue queue;
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < threads; t++)
+	{
+		workers.emplace_back([&, t]()
+		{
+			RenderCommandBuffer& buffer = queue.GetBuffer(t);
+			buffer.BindPipeline(program);
+			buffer.BindMesh(mesh);
+
+			for (int i = 0; i < draws; i++)
+			{
+				buffer.SetKey(i);
+				buffer.SetUniform("thread", t);
+				buffer.Draw();
+			}
+		});
+	}
+
+	for (std::thread& worker : workers)
+		worker.join();
+
+	CHECK(queue.Count() == threads * draws);
+
+	RenderCommandBackendLog log;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	queue.Replay(log);
+	float ms = test_ms(start);
+
+	printf("bench: replayed %d draws recorded on %d threads to the log in %.3f ms\n", threads * draws, threads, ms);
+
+	// sorted by key, then by thread
+	CHECK(log.lines.size() == 2 + threads * draws * 2);
+	CHECK(log.lines[2] == "uniform 5 0");
+	CHECK(log.lines[4] == "uniform 5 1");
+	CHECK(log.lines[log.lines.size() - 2] == "uniform 5 3");
+}
+
+int main()
+{
+	gl_recorder_install();
+	Render::CreateContext();
+
+	test_sorting();
+	test_handles();
+	test_targets();
+	test_log();
+	test_threads();
+
+	return TEST_RESULT();
+}
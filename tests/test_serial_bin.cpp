@@ -0,0 +1,196 @@
+// Packed types are written as one block with the same bytes as walking their members, padded or
+// partly described types are walked, and the MB/s of each
+
+#include "test.h"
+#include "ext/serial/serial_bin.h"
+#include "ext/serial/serial_common.h"
+#include "util/math.h"
+#include <random>
+#include <sstream>
+
+static std::mt19937 rng(1);
+
+static float random_float(float min, float max)
+{
+	return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+// every member described, in order and without padding
+struct PackedPoint
+{
+	vec2 position;
+	vec2 velocity;
+	float life;
+	int id;
+
+	bool operator==(const PackedPoint& other) const
+	{
+		return position == other.position && velocity == other.velocity && life == other.life && id == other.id;
+	}
+};
+
+// padding after tag
+struct PaddedPoint
+{
+	u8 tag;
+	float value;
+};
+
+// middle isn't described, so it isn't written
+struct PartialPoint
+{
+	float first;
+	float middle;
+	float last;
+};
+
+// the path taken before packed types, member by member
+struct walk_writer : bin_writer
+{
+	using bin_writer::bin_writer;
+	bool write_packed(meta::type*, const void*, size_t) override { return false; }
+};
+
+struct walk_reader : bin_reader
+{
+	using bin_reader::bin_reader;
+	bool read_packed(meta::type*, void*, size_t) override { return false; }
+};
+
+static void describe_points()
+{
+	meta::describe<PackedPoint>()
+		.name("PackedPoint")
+		.member<&PackedPoint::position>("position")
+		.member<&PackedPoint::velocity>("velocity")
+		.member<&PackedPoint::life>("life")
+		.member<&PackedPoint::id>("id");
+
+	meta::describe<PaddedPoint>()
+		.name("PaddedPoint")
+		.member<&PaddedPoint::tag>("tag")
+		.member<&PaddedPoint::value>("value");
+
+	meta::describe<PartialPoint>()
+		.name("PartialPoint")
+		.member<&PartialPoint::first>("first")
+		.member<&PartialPoint::last>("last");
+}
+
+static std::vector<PackedPoint> make_points(int count)
+{
+	std::vector<PackedPoint> points(count);
+	for (int i = 0; i < count; i++)
+		points[i] = { vec2(random_float(-1.f, 1.f), random_float(-1.f, 1.f)), vec2(random_float(-1.f, 1.f)), random_float(0.f, 5.f), i };
+
+	return points;
+}
+
+template<typename _writer, typename _t>
+static std::string write_bytes(const _t& value)
+{
+	std::stringstream out;
+	_writer(out).write(value);
+	return out.str();
+}
+
+static void test_same_bytes()
+{
+	CHECK(meta::get_class<PackedPoint>()->is_packed());
+	CHECK(meta::get_class<vec2>()->is_packed());
+
+	std::vector<PackedPoint> points = make_points(1000);
+
+	std::string packed = write_bytes<bin_writer>(points);
+	std::string walked = write_bytes<walk_writer>(points);
+
+	CHECK(packed == walked);
+	CHECK(packed.size() == sizeof(size_t) + points.size() * sizeof(PackedPoint));
+
+	// a single instance too
+	CHECK(write_bytes<bin_writer>(points[3]) == write_bytes<walk_writer>(points[3]));
+
+	// either reader reads either file
+	std::vector<PackedPoint> read;
+	std::stringstream packedIn(packed);
+	bin_reader(packedIn).read(read);
+	CHECK(read == points);
+
+	read.clear();
+	std::stringstream walkedIn(packed);
+	walk_reader(walkedIn).read(read);
+	CHECK(read == points);
+}
+
+static void test_fallback()
+{
+	CHECK(!meta::get_class<PaddedPoint>()->is_packed());
+	CHECK(!meta::get_class<PartialPoint>()->is_packed());
+
+	// the padding isn't written
+	std::vector<PaddedPoint> padded = { { 1, 2.f }, { 3, 4.f } };
+
+	std::string bytes = write_bytes<bin_writer>(padded);
+	CHECK(bytes == write_bytes<walk_writer>(padded));
+	CHECK(bytes.size() == sizeof(size_t) + padded.size() * (sizeof(u8) + sizeof(float)));
+
+	std::vector<PaddedPoint> paddedRead;
+	std::stringstream paddedIn(bytes);
+	bin_reader(paddedIn).read(paddedRead);
+	CHECK(paddedRead.size() == 2 && paddedRead[1].tag == 3 && paddedRead[1].value == 4.f);
+
+	// the member which isn't described isn't written, and is constructed again when read
+	std::vector<PartialPoint> partial = { { 1.f, 2.f, 3.f } };
+
+	bytes = write_bytes<bin_writer>(partial);
+	CHECK(bytes == write_bytes<walk_writer>(partial));
+	CHECK(bytes.size() == sizeof(size_t) + 2 * sizeof(float));
+
+	PartialPoint partialRead = { 0.f, 9.f, 0.f };
+	std::stringstream partialIn(write_bytes<bin_writer>(partial[0]));
+	bin_reader(partialIn).read(partialRead);
+	CHECK(partialRead.first == 1.f && partialRead.middle == 0.f && partialRead.last == 3.f);
+}
+
+template<typename _writer, typename _reader>
+static void bench_points(const char* name, const std::vector<PackedPoint>& points)
+{
+	std::stringstream file;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	_writer(file).write(points);
+	float writeMs = test_ms(start);
+
+	std::vector<PackedPoint> read;
+	read.reserve(points.size());
+
+	start = std::chrono::high_resolution_clock::now();
+	_reader(file).read(read);
+	float readMs = test_ms(start);
+
+	CHECK(read == points);
+
+	float mb = points.size() * sizeof(PackedPoint) / (1024.f * 1024.f);
+	printf("bench: %s %d points, write %.0f MB/s, read %.0f MB/s\n", name, (int)points.size(), mb / writeMs * 1000.f, mb / readMs * 1000.f);
+}
+
+static void bench()
+{
+	std::vector<PackedPoint> points = make_points(500000);
+
+	bench_points<walk_writer, walk_reader>("member walk", points);
+	bench_points<bin_writer, bin_reader>("packed", points);
+}
+
+int main()
+{
+	meta::CreateContext();
+	register_common_types();
+	describe_points();
+
+	test_same_bytes();
+	test_fallback();
+	bench();
+
+	return TEST_RESULT();
+}
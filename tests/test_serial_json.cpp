@@ -0,0 +1,286 @@
+// The JSON pull parser reads escapes and surrogate pairs, skips members it isn't asked for, reads
+// nested arrays, finishes on malformed and truncated documents, and its MB/s against the old
+// reader which built a tree of the document with json.h
+
+#include "test.h"
+#include "ext/serial/serial_json.h"
+#include "ext/serial/serial_common.h"
+#include "json/json.h"
+#include <random>
+#include <sstream>
+#include <string.h>
+
+static std::mt19937 rng(1);
+
+static int random_int(int min, int max)
+{
+	return std::uniform_int_distribution<int>(min, max)(rng);
+}
+
+struct JsonItem
+{
+	std::string name;
+	int count = 0;
+	float weight = 0.f;
+	bool active = false;
+	std::vector<std::vector<int>> grid;
+
+	bool operator==(const JsonItem& other) const
+	{
+		return name == other.name && count == other.count && weight == other.weight && active == other.active && grid == other.grid;
+	}
+};
+
+static void describe_items()
+{
+	meta::describe<JsonItem>()
+		.name("JsonItem")
+		.member<&JsonItem::name>("name")
+		.member<&JsonItem::count>("count")
+		.member<&JsonItem::weight>("weight")
+		.member<&JsonItem::active>("active")
+		.member<&JsonItem::grid>("grid");
+}
+
+// the reader before the pull parser, kept to compare against. it parsed the whole document into
+// a tree first, and walked it as values were asked for. its logging of each value is left out
+struct json_tree_reader : meta::serial_reader
+{
+	struct frame
+	{
+		meta::type* type;
+		json_value_s* value;
+		json_array_element_s* item;
+		json_object_element_s* member;
+
+		json_value_s* get_value() const
+		{
+			return item ? item->value : member ? member->value : value;
+		}
+	};
+
+	json_value_s* m_root;
+	std::stack<frame> m_frames;
+
+	json_tree_reader(std::istream& in)
+		: meta::serial_reader (in, true)
+	{
+		std::stringstream ss; ss << m_in.rdbuf();
+		std::string str = ss.str();
+
+		m_root = json_parse(str.c_str(), str.size());
+		m_frames.push({ nullptr, m_root, nullptr, nullptr });
+	}
+
+	~json_tree_reader()
+	{
+		free(m_root);
+	}
+
+	void class_begin(meta::type* type) override { m_frames.push({ type, nullptr, nullptr, json_value_as_object(m_frames.top().get_value())->start }); }
+	void class_delim() override                 { m_frames.top().member = m_frames.top().member->next; }
+	void class_end() override                   { m_frames.pop(); }
+
+	void member_begin(meta::type* type, const char*) override { m_frames.push({ type, m_frames.top().get_value(), nullptr, nullptr }); }
+	void member_end() override                                     { m_frames.pop(); }
+
+	void array_begin(meta::type* type, size_t) override { m_frames.push({ type, nullptr, json_value_as_array(m_frames.top().get_value())->start, nullptr }); }
+	void array_delim() override                                { m_frames.top().item = m_frames.top().item->next; }
+	void array_end() override                                  { m_frames.pop(); }
+
+	void string_begin(size_t) override {}
+	void string_end() override {}
+
+	size_t read_length() override
+	{
+		json_value_s* value = m_frames.top().get_value();
+
+		switch (value->type)
+		{
+			case json_type_string: return json_value_as_string(value)->string_size;
+			case json_type_array:  return json_value_as_array (value)->length;
+			default:               return 0;
+		}
+	}
+
+	void read_bytes(char* bytes, size_t length) override
+	{
+		json_value_s* value = m_frames.top().get_value();
+		meta::type* type = m_frames.top().type;
+
+		switch (value->type)
+		{
+			case json_type_string: memcpy(bytes, json_value_as_string(value)->string, length); break;
+			case json_type_true:   *bytes = (char)true;  break;
+			case json_type_false:  *bytes = (char)false; break;
+
+			case json_type_number:
+			{
+				const char* number = json_value_as_number(value)->number;
+
+				if (meta::is_same<float>(type))
+				{
+					*(float*)bytes = std::stof(number);
+				}
+
+				else
+				{
+					unsigned long long largest = std::stoull(number);
+					memcpy(bytes, &largest, type->info()->m_size);
+				}
+
+				break;
+			}
+
+			default: break;
+		}
+	}
+};
+
+template<typename _reader, typename _t>
+static _t read_json(const std::string& json)
+{
+	std::stringstream in(json);
+	_t value = {};
+	_reader(in).read(value);
+	return value;
+}
+
+static std::string write_json(const std::vector<JsonItem>& items)
+{
+	std::stringstream out;
+	json_writer(out).write(items);
+	return out.str();
+}
+
+static void test_escapes()
+{
+	std::string json = R"({ "name": "a\"b\\c\/d\n\tA\u00e9\u20AC\ud83d\ude00", "count": 1 })";
+	JsonItem item = read_json<json_reader, JsonItem>(json);
+
+	// A, then the utf8 of e acute, the euro sign and a surrogate pair
+	CHECK(item.name == "a\"b\\c/d\n\tA\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80");
+	CHECK(item.count == 1);
+
+	// a lone surrogate or bad hex doesn't stop the string
+	item = read_json<json_reader, JsonItem>(R"({ "name": "\ud83dx\uzzzzy", "count": 2 })");
+	CHECK(item.name.size() > 0 && item.name.back() == 'y');
+	CHECK(item.count == 2);
+}
+
+static void test_unknown_members()
+{
+	// members after the described ones are skipped, even with closers inside strings
+	std::string json = R"([
+		{ "name": "first", "count": 1, "weight": 0.5, "active": true, "grid": [[1]], "extra": { "a": [1, 2, { "b": "}]" }] }, "more": "]" },
+		{ "name": "second", "count": 2, "weight": 1.5, "active": false, "grid": [] }
+	])";
+
+	std::vector<JsonItem> items = read_json<json_reader, std::vector<JsonItem>>(json);
+
+	CHECK(items.size() == 2);
+	CHECK(items[0].name == "first" && items[0].count == 1 && items[0].weight == 0.5f && items[0].active);
+	CHECK((items[0].grid == std::vector<std::vector<int>> { { 1 } }));
+	CHECK(items[1].name == "second" && items[1].count == 2 && items[1].weight == 1.5f && !items[1].active);
+	CHECK(items[1].grid.empty());
+}
+
+static void test_nested_arrays()
+{
+	std::string json = "{\"name\":\"\",\"count\":0,\"weight\":0,\"active\":false,\"grid\":[ [1, 2,3] ,[],\n\t[ 4 ], [5,6] ]}";
+	JsonItem item = read_json<json_reader, JsonItem>(json);
+
+	CHECK((item.grid == std::vector<std::vector<int>> { { 1, 2, 3 }, {}, { 4 }, { 5, 6 } }));
+
+	// written then read again
+	std::vector<JsonItem> items = { item, item };
+	items[1].name = "back\\slash";
+	items[1].grid.push_back({ 7, 8, 9 });
+
+	CHECK((read_json<json_reader, std::vector<JsonItem>>(write_json(items)) == items));
+}
+
+static void test_malformed()
+{
+	// each finishes loading, logging what was wrong
+	std::vector<std::string> documents = {
+		"",
+		"[",
+		"]]]",
+		"[}]",
+		"[5, { \"name\": \"after\", \"count\": 3 }]",
+		"[{ \"name\": \"ab",
+		"[{ \"name\": \"x\", \"count\": 1",
+		"[{ \"name\": \"x\", \"count\": tr",
+		"[{ \"name\": \"x\", \"count\": 1, \"weight\": 1, \"active\": nul }]",
+		"[{ \"name\": \"x\", \"count\": {}, \"weight\": [1, 2], \"active\": true }]",
+		"[{ \"name\": \"x\", \"count\": 1, \"weight\": 1, \"active\": true, \"grid\": {} }]",
+		"[{ \"name\": \"x\", \"count\": 1, \"weight\": 1, \"active\": true, \"grid\": [[1, }] }]",
+		"{ \"name\": \"object where an array goes\" }",
+		"[{ \"name\": , \"count\": , }]",
+		"[{ \"name\": \"\\",
+		"[{ \"name\": \"\\u12"
+	};
+
+	for (const std::string& json : documents)
+	{
+		read_json<json_reader, std::vector<JsonItem>>(json);
+	}
+
+	// the array is still counted when an item isn't an object
+	std::vector<JsonItem> items = read_json<json_reader, std::vector<JsonItem>>(documents[4]);
+	CHECK(items.size() == 2);
+
+	// members after one of the wrong kind are still read
+	items = read_json<json_reader, std::vector<JsonItem>>(documents[9]);
+	CHECK(items.size() == 1 && items[0].name == "x" && items[0].active);
+}
+
+static void bench()
+{
+	std::vector<JsonItem> items(100000);
+	for (int i = 0; i < (int)items.size(); i++)
+	{
+		JsonItem& item = items[i];
+		item.name = "item " + std::to_string(i);
+		item.count = random_int(0, 100000);
+		item.weight = random_int(0, 1000) / 8.f;
+		item.active = random_int(0, 1);
+		item.grid.resize(random_int(0, 3));
+
+		for (std::vector<int>& row : item.grid)
+			row.resize(random_int(0, 4), random_int(0, 9));
+	}
+
+	std::string json = write_json(items);
+	float mb = json.size() / (1024.f * 1024.f);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<JsonItem> tree = read_json<json_tree_reader, std::vector<JsonItem>>(json);
+	float treeMs = test_ms(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<JsonItem> pull = read_json<json_reader, std::vector<JsonItem>>(json);
+	float pullMs = test_ms(start);
+
+	CHECK(tree == items);
+	CHECK(pull == items);
+
+	printf("bench: %.1f MB of json, tree reader %.0f MB/s, pull reader %.0f MB/s\n", mb, mb / treeMs * 1000.f, mb / pullMs * 1000.f);
+}
+
+int main()
+{
+	meta::CreateContext();
+	meta::register_meta_types();
+	register_common_types();
+	describe_items();
+
+	test_escapes();
+	test_unknown_members();
+	test_nested_arrays();
+	test_malformed();
+	bench();
+
+	return TEST_RESULT();
+}
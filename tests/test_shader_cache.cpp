@@ -0,0 +1,86 @@
+// The program binary cache is keyed by the sources and the driver, and only loads files
+// written for the same key
+
+#include "test.h"
+#include "util/shader_cache.h"
+#include <filesystem>
+#include <stdio.h>
+
+static void test_hash()
+{
+	ShaderCacheStage vertex = { 0, "void main() { gl_Position = vec4(0.0); }" };
+	ShaderCacheStage fragment = { 1, "void main() {}" };
+
+	u64 hash = shader_cache_hash({ vertex, fragment }, "driver 1.0");
+
+	// the order the stages were added in doesn't matter
+	CHECK(shader_cache_hash({ fragment, vertex }, "driver 1.0") == hash);
+
+	CHECK(shader_cache_hash({ vertex, fragment }, "driver 1.1") != hash);
+	CHECK(shader_cache_hash({ vertex, { 1, "void main() { }" } }, "driver 1.0") != hash);
+	CHECK(shader_cache_hash({ vertex }, "driver 1.0") != hash);
+
+	// the same text split differently between the stages
+	CHECK(shader_cache_hash({ { 0, "ab" }, { 1, "c" } }, "") != shader_cache_hash({ { 0, "a" }, { 1, "bc" } }, ""));
+
+	// the same source as another stage
+	CHECK(shader_cache_hash({ { 0, "a" } }, "") != shader_cache_hash({ { 1, "a" } }, ""));
+}
+
+static void test_files()
+{
+	std::string folder = (std::filesystem::temp_directory_path() / "winter_test_shader_cache").string();
+	std::filesystem::remove_all(folder);
+
+	u64 hash = shader_cache_hash({ { 0, "void main() {}" } }, "driver");
+	std::string file = shader_cache_file(folder, hash);
+
+	std::vector<char> binary;
+	for (int i = 0; i < 1000; i++) binary.push_back((char)(i * 7));
+
+	u32 format = 0;
+	std::vector<char> loaded;
+
+	CHECK(!shader_cache_load(file, hash, &format, loaded)); // nothing saved yet
+
+	// makes the folder
+	CHECK(shader_cache_save(file, hash, 0x8e21, binary));
+	CHECK(shader_cache_load(file, hash, &format, loaded));
+	CHECK(format == 0x8e21);
+	CHECK(loaded == binary);
+
+	// written for a different key
+	CHECK(!shader_cache_load(file, hash + 1, &format, loaded));
+
+	FILE* f = nullptr;
+
+	// cut off in the binary and in the header
+	for (size_t size : { (size_t)std::filesystem::file_size(file) - 1, (size_t)10, (size_t)0 })
+	{
+		std::filesystem::resize_file(file, size);
+		CHECK(!shader_cache_load(file, hash, &format, loaded));
+	}
+
+	// extra bytes after the binary
+	CHECK(shader_cache_save(file, hash, 0x8e21, binary));
+	f = fopen(file.c_str(), "ab");
+	fwrite("x", 1, 1, f);
+	fclose(f);
+	CHECK(!shader_cache_load(file, hash, &format, loaded));
+
+	// not a cache file
+	f = fopen(file.c_str(), "wb");
+	fwrite("this is not a program binary at all", 1, 35, f);
+	fclose(f);
+	CHECK(!shader_cache_load(file, hash, &format, loaded));
+
+	std::filesystem::remove_all(folder);
+}
+
+int main()
+{
+	test_hash();
+	test_files();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,116 @@
+// Programs look their uniforms up once when they are linked instead of on every Set
+
+#include "test.h"
+#include "gl_recorder.h"
+#include "Rendering.h"
+#include "util/gl_state.h"
+#include "glm/mat4x4.hpp"
+
+static GlStateCounters end_frame()
+{
+	gl_state_end_frame();
+	return gl_state_frame_counters();
+}
+
+static r<ShaderProgram> make_program()
+{
+	r<ShaderProgram> program = mkr<ShaderProgram>();
+	program->Add(ShaderProgram::sVertex, "void main() {}");
+	program->Add(ShaderProgram::sFragment, "void main() {}");
+
+	return program;
+}
+
+static void test_uniforms()
+{
+	gl_recorder().uniforms = {
+		{ "proj",    GL_FLOAT_MAT4 },
+		{ "tint",    GL_FLOAT_VEC4 },
+		{ "sprite",  GL_SAMPLER_2D },
+		{ "lights",  GL_SAMPLER_2D, 2 },
+		{ "offsets[0]", GL_FLOAT, 4 }
+	};
+
+	r<ShaderProgram> program = make_program();
+	program->Use();
+
+	// samplers get their slots when linked, arrays take one for each element
+	CHECK(program->Uniform("sprite").slot == 0);
+	CHECK(program->Uniform("lights").slot == 1);
+	CHECK(program->Uniform("tint").slot == -1);
+	CHECK(program->NumberOfBoundTextures() == 3);
+
+	// arrays can be set by name without the [0]
+	CHECK(program->Uniform("offsets").location == 4);
+	CHECK(program->Uniform("offsets[0]").location == 4);
+	CHECK(program->Uniform("missing").location == -1);
+
+	gl_recorder().Reset();
+
+	program->Set("proj", mat4(1.f));
+	program->Set("tint", vec4(1.f));
+	program->Set("missing", 1.f);
+	program->SetTexture("sprite", 9);
+	program->SetTexture("tint", 9); // not a sampler, not bound
+
+	CHECK(gl_recorder().Count("glGetUniformLocation") == 0);
+	CHECK(gl_recorder().Count("glUniformMatrix4fv") == 1);
+	CHECK(gl_recorder().Count("glUniform4fv") == 1);
+	CHECK(gl_recorder().Count("glUniform1i") == 1);
+}
+
+// gl calls for a frame of draws which each set the uniforms of one of two programs
+static void bench_frame()
+{
+	gl_recorder().uniforms = {
+		{ "proj",   GL_FLOAT_MAT4 },
+		{ "view",   GL_FLOAT_MAT4 },
+		{ "tint",   GL_FLOAT_VEC4 },
+		{ "sprite", GL_SAMPLER_2D }
+	};
+
+	r<ShaderProgram> programs[2] = { make_program(), make_program() };
+	UniformHandle tint[2] = { programs[0]->Uniform("tint"), programs[1]->Uniform("tint") };
+
+	const int draws = 1000;
+
+	gl_state_invalidate();
+	gl_state_end_frame();
+	gl_recorder().Reset();
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < draws; i++)
+	{
+		// sorted by program, so it only changes once
+		ShaderProgram& program = *programs[i * 2 / draws];
+
+		program.Use();
+		program.Set("proj", mat4(1.f));
+		program.Set("view", mat4(1.f));
+		program.Set(tint[i * 2 / draws], vec4(1.f));
+		program.SetTexture("sprite", 1 + i % 4);
+	}
+
+	float ms = test_ms(start);
+	GlStateCounters counters = end_frame();
+
+	printf("bench: %d draws, %d gl calls, %d binds issued, %d skipped, %.3f ms\n", draws, gl_recorder().Total(), counters.issued, counters.skipped, ms);
+
+	CHECK(gl_recorder().Count("glGetUniformLocation") == 0);
+	CHECK(gl_recorder().Count("glUseProgram") == 2);
+	CHECK(gl_recorder().Count("glUniformMatrix4fv") == draws * 2);
+	CHECK(gl_recorder().Count("glActiveTexture") == 1);
+	CHECK(gl_recorder().Count("glBindTexture") == draws);
+}
+
+int main()
+{
+	gl_recorder_install();
+	Render::CreateContext();
+
+	test_uniforms();
+	bench_frame();
+
+	return TEST_RESULT();
+}